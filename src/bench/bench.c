@@ -0,0 +1,611 @@
+/* scc-bench - benchmark the scc implementations on a set of graphs
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <unistd.h>
+#include <ctype.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <graph.h>
+#include <generate.h>
+#include <stats.h>
+#include <scc_serial.h>
+#include <scc_pthreads.h>
+
+#ifndef NUM_THREADS
+#define NUM_THREADS 4
+#endif
+
+// the name of the parallel implementation, used for the names of its tables
+#ifndef BENCH_BACKEND
+#define BENCH_BACKEND "pthread"
+#endif
+
+// the longest dataset name and file name in a manifest
+#define BENCH_NAME_LEN 64
+#define BENCH_PATH_LEN 4096
+
+// the most thread counts in a sweep
+#define BENCH_MAX_SWEEP 64
+
+const char help_string[] = "scc-bench - benchmark the scc implementations on a set of graphs\n\
+Usage:\tscc-bench [OPTIONS] [--] manifest\n\
+\n\
+Description:\n\
+  scc-bench runs the serial and parallel implementations on every\n\
+  graph of the manifest and writes the median times in the tables\n\
+  serial.dat, " BENCH_BACKEND ".dat and " BENCH_BACKEND "-threads.dat, which are\n\
+  plotted by doc/plot.p.\n\
+  \n\
+  every line of the manifest has the name of a dataset and its\n\
+  MatrixMarket file or generator spec (gen:name,key=value,... as in\n\
+  scc -h), optionally followed by the word sweep for the\n\
+  datasets that are also run with every number of threads of -s.\n\
+  lines starting with # are ignored.\n\
+  \n\
+  before the tables are written the new times are compared against\n\
+  the tables in the baseline directory, and the exit status is 1 if\n\
+  any median is slower than its baseline by more than the threshold.\n\
+  the tables are then not written, so the baseline is kept, unless -u is given.\n\
+\n\
+Options:\n\
+  -h:\tprint this help text and exit.\n\
+  -n:\tthe number of threads of the parallel runs. must be a number greater than 0\n\
+  -s:\tthe numbers of threads of the sweep, separated by commas (default 1,2,4,8,16)\n\
+  -a:\tthe algorithm to use, coloring (default) or fwbw\n\
+  -w:\tthe number of warmup runs before the timed ones (default 1)\n\
+  -r:\tthe number of timed runs, the median is reported (default 5)\n\
+  -d:\tthe directory the tables are written to (default .)\n\
+  -b:\tthe directory of the baseline tables (default the output directory)\n\
+  -x:\tthe slowdown over the baseline that is reported, in percent (default 10)\n\
+  -u:\twrite the tables even if there are slowdowns, accepting the new times,\n\
+  \tand exit with status 0\n\
+  --:\tend of options. the argument following must be a filename\n\
+\n";
+
+/* bench_dataset is a graph of the manifest.
+ * sweep is true if it is also run with each number of threads of the sweep.
+ */
+typedef struct bench_dataset {
+	char name[BENCH_NAME_LEN];
+	char fname[BENCH_PATH_LEN];
+	bool sweep;
+
+} bench_dataset;
+
+/* bench_row is a row of a table: the times of the runs of a dataset
+ * with threads threads (0 in the tables of the datasets).
+ * time is the median of the runs, and min and max their spread.
+ */
+typedef struct bench_row {
+	char name[BENCH_NAME_LEN];
+	int threads;
+
+	size_t n_verts;
+	size_t n_edges;
+	ssize_t n_scc;
+
+	double time;
+	double min;
+	double max;
+
+} bench_row;
+
+/* bench_table is a table written to a .dat file
+ *
+ * the tables of the datasets have the columns name, n_verts, n_edges, n_scc and time,
+ * and the tables of the sweeps the columns name, threads and time. min and max are
+ * written in two more columns, the baseline tables may not have them.
+ */
+typedef struct bench_table {
+	const char *fname;
+	bool sweep;
+
+	bench_row *rows;
+	size_t n_rows;
+	size_t capacity;
+
+} bench_table;
+
+// Appends a row to a table, returns the new row or NULL on failure
+static bench_row *append_row(bench_table *table) {
+	if(table->n_rows == table->capacity) {
+		size_t capacity = 2 * table->capacity + 8;
+		bench_row *rows = (bench_row *) realloc(table->rows, capacity * sizeof(bench_row));
+		if(rows == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+			return NULL;
+		}
+
+		table->rows = rows;
+		table->capacity = capacity;
+	}
+
+	bench_row *row = &table->rows[table->n_rows++];
+	memset(row, 0, sizeof(bench_row));
+
+	return row;
+}
+
+/* Reads the datasets of a manifest
+ *
+ * returns the number of datasets and stores them in *datasets, or -1 on failure.
+ */
+static ssize_t read_manifest(const char *fname, bench_dataset **datasets) {
+	FILE *f = fopen(fname, "r");
+	if(f == NULL) {
+		fprintf(stderr, "Error opening manifest %s:\n%s\n", fname, strerror(errno));
+		return -1;
+	}
+
+	size_t n_datasets = 0;
+	size_t capacity = 0;
+	*datasets = NULL;
+
+	char line[2 * BENCH_PATH_LEN];
+	for(int lineno = 1 ; fgets(line, sizeof(line), f) != NULL ; ++lineno) {
+		char *s = line;
+		while(isspace(*s)) ++s;
+		if(*s == '\0' || *s == '#') continue;
+
+		if(n_datasets == capacity) {
+			capacity = 2 * capacity + 8;
+			bench_dataset *grown = (bench_dataset *) realloc(*datasets, capacity * sizeof(bench_dataset));
+			if(grown == NULL) {
+				fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+				free(*datasets);
+				fclose(f);
+				return -1;
+			}
+			*datasets = grown;
+		}
+
+		bench_dataset *ds = &(*datasets)[n_datasets];
+
+		char flag[16] = "";
+		int n_fields = sscanf(s, "%63s %4095s %15s", ds->name, ds->fname, flag);
+		if(n_fields < 2 || (n_fields == 3 && strcmp(flag, "sweep"))) {
+			fprintf(stderr, "Error in manifest %s line %d:\nexpected 'name file [sweep]'\n", fname, lineno);
+
+			free(*datasets);
+			fclose(f);
+			return -1;
+		}
+		ds->sweep = (n_fields == 3);
+
+		n_datasets++;
+	}
+
+	fclose(f);
+	return n_datasets;
+}
+
+/* Reads the rows of a table written by a previous run
+ *
+ * a table that does not exist is empty. the rows without min and max get the
+ * median in their place. returns 0 on success or -1 on failure.
+ */
+static int read_table(const char *fname, bool sweep, bench_table *table) {
+	memset(table, 0, sizeof(bench_table));
+	table->fname = fname;
+	table->sweep = sweep;
+
+	FILE *f = fopen(fname, "r");
+	if(f == NULL) return 0;
+
+	char line[1024];
+	while(fgets(line, sizeof(line), f) != NULL) {
+		char *s = line;
+		while(isspace(*s)) ++s;
+		if(*s == '\0' || *s == '#') continue;
+
+		bench_row *row = append_row(table);
+		if(row == NULL) {
+			fclose(f);
+			return -1;
+		}
+
+		int n_fields;
+		if(sweep) {
+			n_fields = sscanf(s, "%63s %d %lf %lf %lf", row->name, &row->threads, &row->time, &row->min, &row->max) - 2;
+		} else {
+			n_fields = sscanf(s, "%63s %zu %zu %zd %lf %lf %lf",
+					row->name, &row->n_verts, &row->n_edges, &row->n_scc, &row->time, &row->min, &row->max) - 4;
+		}
+
+		// skip the rows that can not be read
+		if(n_fields < 1) {
+			table->n_rows--;
+			continue;
+		}
+
+		if(n_fields < 3) row->min = row->max = row->time;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+// Writes a table, returns 0 on success or -1 on failure
+static int write_table(const bench_table *table) {
+	FILE *f = fopen(table->fname, "w");
+	if(f == NULL) {
+		fprintf(stderr, "Error opening table %s:\n%s\n", table->fname, strerror(errno));
+		return -1;
+	}
+
+	if(table->sweep) fprintf(f, "# %-17s %-3s %-9s %-9s %s\n", "name", "thr", "median", "min", "max");
+	else fprintf(f, "# %-17s %-8s %-9s %-8s %-9s %-9s %s\n", "name", "n_verts", "n_edges", "n_scc", "median", "min", "max");
+
+	for(size_t i = 0 ; i < table->n_rows ; ++i) {
+		const bench_row *row = &table->rows[i];
+
+		if(table->sweep) {
+			fprintf(f, "%-19s %-3d %0.6f  %0.6f  %0.6f\n", row->name, row->threads, row->time, row->min, row->max);
+		} else {
+			fprintf(f, "%-19s %-8zu %-9zu %-8zd %0.6f  %0.6f  %0.6f\n",
+					row->name, row->n_verts, row->n_edges, row->n_scc, row->time, row->min, row->max);
+		}
+	}
+
+	if(fclose(f) == EOF) {
+		fprintf(stderr, "Error writing table %s:\n%s\n", table->fname, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Compares the rows of a table against the rows with the same name (and threads) in its baseline
+ *
+ * prints the rows whose median is slower than the baseline by more than threshold percent.
+ * returns the number of slowdowns.
+ */
+static int compare_table(const bench_table *table, const bench_table *baseline, double threshold) {
+	int n_slowdowns = 0;
+
+	for(size_t i = 0 ; i < table->n_rows ; ++i) {
+		const bench_row *row = &table->rows[i];
+
+		for(size_t j = 0 ; j < baseline->n_rows ; ++j) {
+			const bench_row *base = &baseline->rows[j];
+			if(strcmp(row->name, base->name) || row->threads != base->threads || base->time <= 0) continue;
+
+			double change = 100 * (row->time - base->time) / base->time;
+			if(change > threshold) {
+				printf("slowdown: %s %s", table->fname, row->name);
+				if(table->sweep) printf(" (%d threads)", row->threads);
+				printf(" -- %0.6f sec -> %0.6f sec (%+0.1f%%)\n", base->time, row->time, change);
+
+				n_slowdowns++;
+			}
+			break;
+		}
+	}
+
+	return n_slowdowns;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Times n_trials runs of an scc implementation on G after n_warmup untimed ones
+ *
+ * the parallel implementation is used with num_threads threads if it is not NULL, otherwise
+ * the serial one. the median, min and max times are stored in row. returns the number of
+ * sccs or -1 on failure.
+ */
+static ssize_t time_runs(const graph *G,
+		ssize_t (*serial_scc)(const graph *, vert_t **),
+		ssize_t (*parallel_scc)(const graph *, vert_t **, int), int num_threads,
+		int n_warmup, int n_trials, bench_row *row) {
+
+	double *times = (double *) malloc(n_trials * sizeof(double));
+	if(times == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return -1;
+	}
+
+	ssize_t n_scc = -1;
+	for(int i = 0 ; i < n_warmup + n_trials ; ++i) {
+		vert_t *scc_id;
+
+		double start = stats_clock();
+		if(parallel_scc != NULL) n_scc = (*parallel_scc)(G, &scc_id, num_threads);
+		else n_scc = (*serial_scc)(G, &scc_id);
+		double time = stats_clock() - start;
+
+		if(n_scc == -1) break;
+		free(scc_id);
+
+		if(i >= n_warmup) times[i - n_warmup] = time;
+	}
+
+	if(n_scc != -1) {
+		qsort(times, n_trials, sizeof(double), compare_doubles);
+
+		row->time = (n_trials % 2)? times[n_trials / 2] : (times[n_trials / 2 - 1] + times[n_trials / 2]) / 2;
+		row->min = times[0];
+		row->max = times[n_trials - 1];
+		row->n_scc = n_scc;
+	}
+
+	free(times);
+	return n_scc;
+}
+
+// Prints the times of a row of a table
+static void print_row(const char *table_name, const bench_row *row) {
+	printf("  %-20s", table_name);
+	if(row->threads > 0) printf(" %3d threads", row->threads);
+	else printf(" %11s", "");
+	printf("  n_scc = %-9zd median %0.6f sec  (min %0.6f, max %0.6f)\n", row->n_scc, row->time, row->min, row->max);
+}
+
+// Parses a comma separated list of thread counts, returns their number or -1 on failure
+static int parse_sweep(const char *s, int *threads) {
+	int n = 0;
+	while(*s != '\0') {
+		char *end;
+		long t = strtol(s, &end, 10);
+		if(end == s || t <= 0 || (*end != ',' && *end != '\0') || n == BENCH_MAX_SWEEP) return -1;
+
+		threads[n++] = (int) t;
+		s = (*end == ',')? end + 1 : end;
+	}
+
+	return (n > 0)? n : -1;
+}
+
+int main(int argc, char **argv) {
+
+	int num_threads = NUM_THREADS;
+
+	int sweep_threads[BENCH_MAX_SWEEP] = {1, 2, 4, 8, 16};
+	int n_sweep = 5;
+
+	int n_warmup = 1;
+	int n_trials = 5;
+
+	const char *out_dir = ".";
+	const char *baseline_dir = NULL;
+	double threshold = 10;
+	bool accept_slowdowns = false;
+
+	ssize_t (*serial_scc)(const graph *, vert_t **) = scc_coloring;
+	ssize_t (*parallel_scc)(const graph *, vert_t **, int) = p_scc_coloring;
+
+	int opt;
+	while((opt = getopt(argc, argv, ":hn:s:a:w:r:d:b:x:u")) != -1) {
+		switch(opt) {
+		case 'h':
+			printf(help_string);
+			return 0;
+		case 'n':
+			num_threads = atoi(optarg);
+			if(num_threads <= 0) {
+				fprintf(stderr, "Error: option '-n' -- number of threads must be a number greater than 0\n");
+				exit(EINVAL);
+			}
+			break;
+		case 's':
+			n_sweep = parse_sweep(optarg, sweep_threads);
+			if(n_sweep == -1) {
+				fprintf(stderr, "Error: option '-s' -- expected up to %d numbers greater than 0 separated by commas\n", BENCH_MAX_SWEEP);
+				exit(EINVAL);
+			}
+			break;
+		case 'a':
+			if(!strcmp(optarg, "coloring")) {
+				serial_scc = scc_coloring;
+				parallel_scc = p_scc_coloring;
+			} else if(!strcmp(optarg, "fwbw")) {
+				serial_scc = scc_fwbw;
+				parallel_scc = p_scc_fwbw;
+			} else {
+				fprintf(stderr, "Error: option '-a' -- unknown algorithm '%s'\n", optarg);
+				exit(EINVAL);
+			}
+			break;
+		case 'w':
+			n_warmup = atoi(optarg);
+			if(n_warmup < 0) {
+				fprintf(stderr, "Error: option '-w' -- number of warmup runs must not be negative\n");
+				exit(EINVAL);
+			}
+			break;
+		case 'r':
+			n_trials = atoi(optarg);
+			if(n_trials <= 0) {
+				fprintf(stderr, "Error: option '-r' -- number of runs must be a number greater than 0\n");
+				exit(EINVAL);
+			}
+			break;
+		case 'd':
+			out_dir = optarg;
+			break;
+		case 'b':
+			baseline_dir = optarg;
+			break;
+		case 'x':
+			threshold = atof(optarg);
+			break;
+		case 'u':
+			accept_slowdowns = true;
+			break;
+		case ':':
+			fprintf(stderr, "Error: option '-%c' must be followed by an argument\n", optopt);
+			exit(EINVAL);
+		case '?':
+			if(isprint(optopt))
+				fprintf(stderr, "Error: unknown command-line option '-%c'\n", optopt);
+			else
+				fprintf(stderr, "Error: unknown option character '\\x%x'\n", optopt);
+
+			exit(EINVAL);
+		default:
+			abort();
+		}
+	}
+
+	if(optind >= argc) {
+		fprintf(stderr, "Error reading input arguments: %s\nUsage:\tscc-bench [OPTIONS] [--] manifest\n",
+				strerror(EINVAL));
+		exit(EINVAL);
+	}
+	if(baseline_dir == NULL) baseline_dir = out_dir;
+
+	bench_dataset *datasets;
+	ssize_t n_datasets = read_manifest(argv[optind], &datasets);
+	if(n_datasets == -1) return -1;
+
+	// the tables are serial.dat, <backend>.dat and <backend>-threads.dat
+	const char *table_names[3] = {"serial.dat", BENCH_BACKEND ".dat", BENCH_BACKEND "-threads.dat"};
+	char out_fnames[3][BENCH_PATH_LEN];
+	char baseline_fnames[3][BENCH_PATH_LEN];
+
+	bench_table tables[3];
+	bench_table baselines[3];
+
+	int status = 0;
+	for(int i = 0 ; i < 3 ; ++i) {
+		snprintf(out_fnames[i], BENCH_PATH_LEN, "%s/%s", out_dir, table_names[i]);
+		snprintf(baseline_fnames[i], BENCH_PATH_LEN, "%s/%s", baseline_dir, table_names[i]);
+
+		// the baseline is read first since it may be the table that is written
+		memset(&tables[i], 0, sizeof(bench_table));
+		tables[i].fname = out_fnames[i];
+		tables[i].sweep = (i == 2);
+
+		if(read_table(baseline_fnames[i], i == 2, &baselines[i]) == -1) status = -1;
+		baselines[i].fname = table_names[i];
+	}
+
+	for(size_t d = 0 ; d < n_datasets && status == 0 ; ++d) {
+		bench_dataset *ds = &datasets[d];
+
+		printf("=== %s ===\n", ds->name);
+		ssize_t known_n_scc = -1;
+		graph *G = NULL;
+		if(is_generator_spec(ds->fname)) G = generate_graph(ds->fname + strlen(GENERATOR_PREFIX), num_threads, &known_n_scc);
+		else G = import_graph(ds->fname, num_threads, false, false);
+		if(G == NULL) {
+			status = -1;
+			break;
+		}
+		printf("number of vertices = %zu\n", G->n_verts);
+		printf("number of edges = %zu\n", G->n_edges);
+
+		// a row in the table of the serial runs and of the parallel runs
+		for(int i = 0 ; i < 2 && status == 0 ; ++i) {
+			bench_row *row = append_row(&tables[i]);
+			if(row == NULL) {
+				status = -1;
+				break;
+			}
+
+			snprintf(row->name, BENCH_NAME_LEN, "%s", ds->name);
+			row->n_verts = G->n_verts;
+			row->n_edges = G->n_edges;
+
+			ssize_t n_scc = time_runs(G, serial_scc, (i == 0)? NULL : parallel_scc, num_threads, n_warmup, n_trials, row);
+			if(n_scc == -1) {
+				status = -1;
+				break;
+			}
+
+			// the runs on a generated graph are checked against its known number of SCCs
+			if(known_n_scc != -1 && n_scc != known_n_scc) {
+				fprintf(stderr, "Error: %s -- %zd SCCs found, the graph was generated with %zd\n", ds->name, n_scc, known_n_scc);
+				status = -1;
+				break;
+			}
+
+			print_row(table_names[i], row);
+		}
+
+		// and a row in the table of the sweeps for each number of threads
+		for(int s = 0 ; s < n_sweep && ds->sweep && status == 0 ; ++s) {
+			bench_row *row = append_row(&tables[2]);
+			if(row == NULL) {
+				status = -1;
+				break;
+			}
+
+			snprintf(row->name, BENCH_NAME_LEN, "%s", ds->name);
+			row->threads = sweep_threads[s];
+
+			ssize_t n_scc = time_runs(G, serial_scc, parallel_scc, sweep_threads[s], n_warmup, n_trials, row);
+			if(n_scc == -1) {
+				status = -1;
+				break;
+			}
+
+			if(known_n_scc != -1 && n_scc != known_n_scc) {
+				fprintf(stderr, "Error: %s -- %zd SCCs found, the graph was generated with %zd\n", ds->name, n_scc, known_n_scc);
+				status = -1;
+				break;
+			}
+
+			print_row(table_names[2], row);
+		}
+
+		free_graph(G);
+		printf("\n");
+	}
+
+	if(status == 0) {
+		printf("=== comparison with the baseline (%s) ===\n", baseline_dir);
+
+		int n_slowdowns = 0;
+		for(int i = 0 ; i < 3 ; ++i) n_slowdowns += compare_table(&tables[i], &baselines[i], threshold);
+		printf("slowdowns over %0.1f%%: %d\n", threshold, n_slowdowns);
+
+		// the tables are kept when there are slowdowns, since they are usually the
+		// baseline of the next run, unless the new times are accepted
+		if(n_slowdowns > 0 && !accept_slowdowns) {
+			printf("the tables were not written, run with -u to accept the new times\n");
+		} else {
+			// the tables of the sweeps are only written when a dataset was swept
+			for(int i = 0 ; i < 3 && status == 0 ; ++i) {
+				if(tables[i].n_rows > 0) status = write_table(&tables[i]);
+			}
+		}
+
+		if(status == 0 && n_slowdowns > 0 && !accept_slowdowns) status = 1;
+	}
+
+	for(int i = 0 ; i < 3 ; ++i) {
+		free(tables[i].rows);
+		free(baselines[i].rows);
+	}
+	free(datasets);
+
+	return status;
+}
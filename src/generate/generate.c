@@ -0,0 +1,498 @@
+/* synthetic graph generators for scc
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "generate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <time.h>
+
+#include <pthread.h>
+
+typedef enum {
+	GEN_RMAT,
+	GEN_KRONECKER,
+	GEN_DAG,
+	GEN_CYCLE,
+	GEN_PLANTED,
+	N_GENERATORS
+} generator_kind;
+
+static const char *generator_names[N_GENERATORS] = {
+	"rmat", "kronecker", "dag", "cycle", "planted"
+};
+
+// the parameters each generator accepts in its spec
+static const char *generator_keys[N_GENERATORS] = {
+	" scale degree a b c seed ",
+	" scale degree a b c seed ",
+	" verts degree seed ",
+	" verts cycles ",
+	" verts sccs degree cross seed "
+};
+
+/* gen_params holds the parameters of a generator and the values derived from them.
+ *
+ * the vertices are split in n_parts parts of equal size (the cycles or the planted SCCs),
+ * and the planted edges are the n_verts edges of the cycles, then n_intra edges inside
+ * the parts and then the edges between them. when shuffle is true every vertex v is
+ * relabeled to a bijection of v on shuffle_bits bits keyed by shuffle_keys.
+ */
+typedef struct gen_params {
+	generator_kind kind;
+
+	size_t n_verts;
+	size_t n_edges;
+
+	int scale;
+	double degree;
+	double a, b, c;
+	size_t n_parts;
+	double cross;
+	uint64_t seed;
+
+	size_t n_intra;
+
+	bool shuffle;
+	int shuffle_bits;
+	uint64_t shuffle_keys[6];
+
+	// generates edge i in *u -> *v, before the shuffle
+	void (*edge)(const struct gen_params *, size_t, vert_t *, vert_t *);
+
+} gen_params;
+
+
+/* random numbers */
+
+// Returns the next number of the splitmix64 sequence of state
+static inline uint64_t next_random(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+
+	return z ^ (z >> 31);
+}
+
+// Returns the state of the random numbers of edge i, so that every edge is the same for any number of threads
+static inline uint64_t edge_random_state(uint64_t seed, size_t i) {
+	uint64_t state = seed ^ (i * 0xd1342543de82ef95);
+	next_random(&state);
+
+	return state;
+}
+
+// Returns a random number in [0, n)
+static inline uint64_t random_below(uint64_t *state, uint64_t n) {
+	return (uint64_t) (((unsigned __int128) next_random(state) * n) >> 64);
+}
+
+// Returns a random number in [0, 1)
+static inline double random_double(uint64_t *state) {
+	return (next_random(state) >> 11) * 0x1.0p-53;
+}
+
+
+/* parts and shuffling */
+
+// Returns the first vertex of part c
+static inline size_t part_start(const gen_params *p, size_t c) {
+	return c * p->n_verts / p->n_parts;
+}
+
+// Returns the part of vertex v
+static inline size_t part_of(const gen_params *p, size_t v) {
+	size_t c = v * p->n_parts / p->n_verts;
+	while(c + 1 < p->n_parts && part_start(p, c + 1) <= v) c++;
+	while(part_start(p, c) > v) c--;
+
+	return c;
+}
+
+/* Returns the label of vertex v in the shuffled graph
+ *
+ * a few rounds of multiplying by an odd number and xor-shifting form a bijection on
+ * shuffle_bits bits. it is applied again while the result is not a vertex, which
+ * keeps it a bijection on the vertices.
+ */
+static inline vert_t shuffle_vertex(const gen_params *p, vert_t v) {
+	uint64_t mask = ((uint64_t) 1 << p->shuffle_bits) - 1;
+	int shift = p->shuffle_bits / 2 + 1;
+
+	uint64_t x = v;
+	do {
+		for(int r = 0 ; r < 3 ; ++r) {
+			x = (x * p->shuffle_keys[2 * r] + p->shuffle_keys[2 * r + 1]) & mask;
+			x ^= x >> shift;
+		}
+	} while(x >= p->n_verts);
+
+	return (vert_t) x;
+}
+
+
+/* the edges of the generators */
+
+// each edge picks one of the quadrants of the adjacency matrix at each level of the recursion
+static void rmat_edge(const gen_params *p, size_t i, vert_t *u, vert_t *v) {
+	uint64_t state = edge_random_state(p->seed, i);
+
+	vert_t row = 0;
+	vert_t col = 0;
+	for(int l = 0 ; l < p->scale ; ++l) {
+		double r = random_double(&state);
+
+		row <<= 1;
+		col <<= 1;
+		if(r < p->a) continue;
+		else if(r < p->a + p->b) col |= 1;
+		else if(r < p->a + p->b + p->c) row |= 1;
+		else {
+			row |= 1;
+			col |= 1;
+		}
+	}
+
+	*u = row;
+	*v = col;
+}
+
+// the edges go from the smaller to the larger vertex before the shuffle
+static void dag_edge(const gen_params *p, size_t i, vert_t *u, vert_t *v) {
+	uint64_t state = edge_random_state(p->seed, i);
+
+	vert_t x = random_below(&state, p->n_verts);
+	vert_t y = random_below(&state, p->n_verts - 1);
+	if(y >= x) y++;
+
+	*u = (x < y)? x : y;
+	*v = (x < y)? y : x;
+}
+
+// edge i leaves vertex i for the previous vertex of its part, the first one for the last
+static void cycle_edge(const gen_params *p, size_t i, vert_t *u, vert_t *v) {
+	size_t c = part_of(p, i);
+
+	*u = i;
+	*v = (i == part_start(p, c))? part_start(p, c + 1) - 1 : i - 1;
+}
+
+// the cycles make every part strongly connected, the edges between parts only go to later parts
+static void planted_edge(const gen_params *p, size_t i, vert_t *u, vert_t *v) {
+	if(i < p->n_verts) {
+		cycle_edge(p, i, u, v);
+		return;
+	}
+
+	uint64_t state = edge_random_state(p->seed, i);
+
+	vert_t x = random_below(&state, p->n_verts);
+	vert_t y;
+	if(i < p->n_verts + p->n_intra) {
+		size_t c = part_of(p, x);
+		y = part_start(p, c) + random_below(&state, part_start(p, c + 1) - part_start(p, c));
+	} else {
+		y = random_below(&state, p->n_verts);
+		if(part_of(p, x) > part_of(p, y)) {
+			vert_t temp = x;
+			x = y;
+			y = temp;
+		}
+	}
+
+	*u = x;
+	*v = y;
+}
+
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it generates the edges between start and end in rows and cols.
+ */
+struct generate_args {
+	size_t start;
+	size_t end;
+
+	const gen_params *p;
+
+	vert_t *rows;
+	vert_t *cols;
+
+}; static void *p_generate_edges(void *args) {
+	struct generate_args *gargs = (struct generate_args *) args;
+	const gen_params *p = gargs->p;
+
+	for(size_t i = gargs->start ; i < gargs->end ; ++i) {
+		vert_t u, v;
+		(*p->edge)(p, i, &u, &v);
+
+		if(p->shuffle) {
+			u = shuffle_vertex(p, u);
+			v = shuffle_vertex(p, v);
+		}
+
+		gargs->rows[i] = u;
+		gargs->cols[i] = v;
+	}
+
+	return NULL;
+}
+
+
+/* parsing the spec */
+
+// Returns true if key is a parameter of the generator
+static bool is_generator_key(generator_kind kind, const char *key) {
+	size_t len = strlen(key);
+	if(len == 0 || strchr(key, ' ') != NULL) return false;
+
+	for(const char *s = strstr(generator_keys[kind], key) ; s != NULL ; s = strstr(s + 1, key)) {
+		if(s[-1] == ' ' && s[len] == ' ') return true;
+	}
+
+	return false;
+}
+
+// Parses the number in value, returns false if it is not a number
+static bool parse_number(const char *value, double *number) {
+	char *end;
+	errno = 0;
+	*number = strtod(value, &end);
+
+	return end != value && *end == '\0' && errno == 0;
+}
+
+/* Parses a spec of the form name,key=value,... in p
+ *
+ * the parameters that are not given keep their default values.
+ * returns 0 on success or -1 on failure.
+ */
+static int parse_spec(const char *spec, gen_params *p) {
+	char buf[strlen(spec) + 1];
+	strcpy(buf, spec);
+
+	char *save;
+	char *name = strtok_r(buf, ",", &save);
+	if(name == NULL) name = "";
+
+	int kind = 0;
+	while(kind < N_GENERATORS && strcmp(name, generator_names[kind])) ++kind;
+	if(kind == N_GENERATORS) {
+		fprintf(stderr, "Error: unknown generator '%s'\nmust be one of: rmat, kronecker, dag, cycle, planted\n", name);
+		return -1;
+	}
+
+	// the default parameters
+	memset(p, 0, sizeof(gen_params));
+	p->kind = kind;
+	p->scale = 16;
+	p->n_verts = 1 << 16;
+	p->degree = (kind == GEN_RMAT || kind == GEN_KRONECKER)? 16 : (kind == GEN_DAG)? 8 : 4;
+	p->a = 0.57;
+	p->b = 0.19;
+	p->c = 0.19;
+	p->n_parts = (kind == GEN_PLANTED)? 1024 : 1;
+	p->cross = 1;
+	p->seed = 1;
+
+	for(char *param = strtok_r(NULL, ",", &save) ; param != NULL ; param = strtok_r(NULL, ",", &save)) {
+		char *value = strchr(param, '=');
+		if(value == NULL) {
+			fprintf(stderr, "Error: generator parameter '%s' must be of the form key=value\n", param);
+			return -1;
+		}
+		*value++ = '\0';
+
+		double number;
+		if(!is_generator_key(kind, param)) {
+			fprintf(stderr, "Error: generator '%s' has no parameter '%s'\nits parameters are:%s\n",
+					name, param, generator_keys[kind]);
+			return -1;
+		} else if(!parse_number(value, &number) || number < 0 || number >= 0x1p63) {
+			fprintf(stderr, "Error: generator parameter '%s' must be a non negative number below 2^63\n", param);
+			return -1;
+		}
+
+		if(!strcmp(param, "scale")) p->scale = (int) number;
+		else if(!strcmp(param, "verts")) p->n_verts = (size_t) number;
+		else if(!strcmp(param, "degree")) p->degree = number;
+		else if(!strcmp(param, "a")) p->a = number;
+		else if(!strcmp(param, "b")) p->b = number;
+		else if(!strcmp(param, "c")) p->c = number;
+		else if(!strcmp(param, "cycles") || !strcmp(param, "sccs")) p->n_parts = (size_t) number;
+		else if(!strcmp(param, "cross")) p->cross = number;
+		else if(!strcmp(param, "seed")) p->seed = (uint64_t) number;
+	}
+
+	if(kind == GEN_RMAT || kind == GEN_KRONECKER) {
+		// 2^32 vertices would not leave the id -1 unused
+		if(p->scale < 1 || p->scale > 31) {
+			fprintf(stderr, "Error: generator parameter 'scale' must be between 1 and 31\n");
+			return -1;
+		} else if(p->a + p->b + p->c > 1) {
+			fprintf(stderr, "Error: generator parameters 'a', 'b' and 'c' must add up to at most 1\n");
+			return -1;
+		}
+
+		p->n_verts = (size_t) 1 << p->scale;
+	}
+
+	if(p->n_verts < 1 || p->n_verts > MAX_VERTS) {
+		fprintf(stderr, "Error: generator parameter 'verts' must be between 1 and %zu\n", MAX_VERTS);
+		return -1;
+	} else if(p->n_parts < 1 || p->n_parts > p->n_verts) {
+		fprintf(stderr, "Error: generator parameter '%s' must be between 1 and the number of vertices\n",
+				(kind == GEN_CYCLE)? "cycles" : "sccs");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Sets the number of edges of a generator and the values derived from its parameters
+ *
+ * returns 0 on success or -1 if the graph has too many edges.
+ */
+static int derive_params(gen_params *p) {
+	double n_edges = 0;
+	switch(p->kind) {
+	case GEN_RMAT:
+	case GEN_KRONECKER:
+		n_edges = p->degree * p->n_verts;
+		p->edge = rmat_edge;
+		p->shuffle = (p->kind == GEN_KRONECKER);
+		break;
+	case GEN_DAG:
+		n_edges = (p->n_verts > 1)? p->degree * p->n_verts : 0;
+		p->edge = dag_edge;
+		p->shuffle = true;
+		break;
+	case GEN_CYCLE:
+		n_edges = p->n_verts;
+		p->edge = cycle_edge;
+		break;
+	case GEN_PLANTED:
+		p->n_intra = (size_t) (p->degree * p->n_verts);
+		n_edges = p->n_verts + (double) p->n_intra + ((p->n_parts > 1)? p->cross * p->n_verts : 0);
+		p->edge = planted_edge;
+		p->shuffle = true;
+		break;
+	default:
+		abort();
+	}
+
+	if(n_edges > MAX_EDGES) {
+		fprintf(stderr, "Error: too many edges\n%0.0f edges, at most %zu are supported\n"
+				"rebuild with EDGE64=1 to use 64-bit edge offsets\n", n_edges, MAX_EDGES);
+		return -1;
+	}
+	p->n_edges = (size_t) n_edges;
+
+	// the keys of the shuffle are derived from the seed, the multipliers must be odd
+	p->shuffle_bits = 1;
+	while(((size_t) 1 << p->shuffle_bits) < p->n_verts) p->shuffle_bits++;
+
+	uint64_t state = p->seed;
+	for(int k = 0 ; k < 6 ; ++k) p->shuffle_keys[k] = next_random(&state) | ((k % 2 == 0)? 1 : 0);
+
+	return 0;
+}
+
+bool is_generator_spec(const char *fname) {
+	return !strncmp(fname, GENERATOR_PREFIX, strlen(GENERATOR_PREFIX));
+}
+
+/* the edges are generated in parallel in the COO format and the graph is built from
+ * them like an imported one. every edge is generated from its own random numbers,
+ * so the graph does not depend on the number of threads.
+ */
+graph *generate_graph(const char *spec, int num_threads, ssize_t *n_scc) {
+	gen_params p;
+	if(parse_spec(spec, &p) == -1 || derive_params(&p) == -1) return NULL;
+
+	switch(p.kind) {
+	case GEN_DAG:
+		*n_scc = p.n_verts;
+		break;
+	case GEN_CYCLE:
+	case GEN_PLANTED:
+		*n_scc = p.n_parts;
+		break;
+	default:
+		*n_scc = -1;
+		break;
+	}
+
+	struct timespec t1, t2;
+	double elapsedtime;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	vert_t *rows = (vert_t *) malloc((p.n_edges + 1) * sizeof(vert_t));
+	vert_t *cols = (vert_t *) malloc((p.n_edges + 1) * sizeof(vert_t));
+	if(rows == NULL || cols == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(rows);
+		free(cols);
+		return NULL;
+	}
+
+	pthread_t threads[num_threads];
+	struct generate_args gargs[num_threads];
+
+	size_t p_edge_block_size = p.n_edges / num_threads;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		gargs[i].start = i * p_edge_block_size;
+		gargs[i].end = (i == num_threads - 1)? p.n_edges : (i + 1) * p_edge_block_size;
+		gargs[i].p = &p;
+		gargs[i].rows = rows;
+		gargs[i].cols = cols;
+
+		pthread_create(&threads[i], NULL, p_generate_edges, &gargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	elapsedtime = (t2.tv_sec - t1.tv_sec);
+	elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+	printf("generate time: %0.6f sec\n", elapsedtime);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	graph *G = graph_from_edges(p.n_verts, p.n_edges, rows, cols, num_threads);
+
+	free(rows);
+	free(cols);
+
+	if(G == NULL) return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	elapsedtime = (t2.tv_sec - t1.tv_sec);
+	elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+	printf("build time: %0.6f sec\n", elapsedtime);
+
+	return G;
+}
@@ -0,0 +1,55 @@
+/* synthetic graph generators for scc
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <graph.h>
+
+/* the generators build a graph directly, without an .mtx file. a generator is selected
+ * with a spec of the form name,key=value,... and the graphs it builds only depend on the
+ * spec, not on the number of threads that build them. the generators are:
+ *
+ *   rmat      the R-MAT graph of scale 2^scale vertices and degree * 2^scale edges,
+ *             where each edge falls in the quadrants of the adjacency matrix with
+ *             probabilities a, b, c and 1 - a - b - c
+ *   kronecker the R-MAT graph with the vertices shuffled, as in the Graph500 generator
+ *   dag       a random DAG of verts vertices and degree * verts edges with shuffled vertices
+ *   cycle     cycles disjoint cycles on verts vertices. the edges go from every vertex to the
+ *             one before it, so the smallest color moves one vertex per coloring sweep
+ *   planted   sccs planted SCCs of equal size on verts vertices, each a cycle with
+ *             degree * verts more random edges inside them, and cross * verts edges between
+ *             them that keep the SCCs acyclic. the vertices are shuffled
+ *
+ * the number of SCCs of dag, cycle and planted is known in advance.
+ */
+
+// the prefix of a file name that is a generator spec
+#define GENERATOR_PREFIX "gen:"
+
+// Builds the graph of a generator spec, stores the number of its SCCs in *n_scc, or -1 if it is not known
+graph *generate_graph(const char *spec, int num_threads, ssize_t *n_scc);
+
+// Returns true if fname is a generator spec prefixed with GENERATOR_PREFIX
+bool is_generator_spec(const char *fname);
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "graph.h"
+#include <stats.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,6 +27,20 @@
 #include <errno.h>
 #include <string.h>
 
+#include <time.h>
+
+#include <pthread.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef SIMD_KERNELS
+#include <immintrin.h>
+#endif
+
 #include <mmio.h>
 
 /* Initialize a graph struct in the CSC and CSR format.
@@ -43,6 +58,22 @@ graph *initialize_graph(size_t n_verts, size_t n_edges) {
 	G->n_verts = n_verts;
 	G->n_edges = n_edges;
 
+	G->cache_map = NULL;
+	G->cache_map_size = 0;
+
+#ifdef COMPRESSED_ADJ
+	// the size of the compressed lists is only known once they are encoded,
+	// so csr_col_id and csc_row_id are allocated then
+	G->csr_col_id = NULL;
+	G->csr_row_id = (edge_t *) malloc((n_verts + 1) * sizeof(edge_t));
+
+	G->csc_row_id = NULL;
+	G->csc_col_id = (edge_t *) malloc((n_verts + 1) * sizeof(edge_t));
+
+	if (G->csr_row_id == NULL || G->csc_col_id == NULL)  {
+		return NULL;
+	}
+#else
 	// in CSR format, col_id is of size n_edges and row_id of size n_verts + 1
 	G->csr_col_id = (vert_t *) malloc(n_edges * sizeof(vert_t));
 	G->csr_row_id = (edge_t *) malloc((n_verts + 1) * sizeof(edge_t));
@@ -54,6 +85,7 @@ graph *initialize_graph(size_t n_verts, size_t n_edges) {
 	if (G->csr_col_id == NULL || G->csr_row_id == NULL || G->csc_col_id == NULL || G->csc_row_id == NULL)  {
 		return NULL;
 	}
+#endif
 
 	return G;
 }
@@ -61,8 +93,15 @@ graph *initialize_graph(size_t n_verts, size_t n_edges) {
 /* Free the memory allocated to a graph struct
  *
  * takes as input a pointer to the struct and frees the memory allocated to row_id and col_id.
+ * if the graph was loaded from a cache file the mapping is removed instead.
  */
 void free_graph(graph *G) {
+	if(G->cache_map != NULL) {
+		munmap(G->cache_map, G->cache_map_size);
+		free(G);
+		return;
+	}
+
 	free(G->csr_col_id);
 	free(G->csr_row_id);
 
@@ -73,287 +112,1885 @@ void free_graph(graph *G) {
 }
 
 
-/* Gets the neighbours of vertex in graph G.
+/* Creates a vertex set with all the n_verts vertices active
+ *
+ * returns a pointer to the set or NULL on failure.
+ */
+vertex_set *new_vertex_set(size_t n_verts) {
+	vertex_set *set = (vertex_set *) malloc(sizeof(vertex_set));
+	if(set == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
+
+	set->n_verts = n_verts;
+	set->n_words = (n_verts + 63) / 64;
+
+	set->words = (uint64_t *) malloc(set->n_words * sizeof(uint64_t));
+	if(set->words == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(set);
+		return NULL;
+	}
+
+	// set the bits of all the vertices, but not the ones after n_verts in the last word
+	memset(set->words, 0xff, set->n_words * sizeof(uint64_t));
+	if(n_verts % 64 != 0) set->words[set->n_words - 1] = ((uint64_t) 1 << (n_verts % 64)) - 1;
+
+	return set;
+}
+
+// Frees the memory allocated to a vertex set
+void free_vertex_set(vertex_set *set) {
+	free(set->words);
+	free(set);
+}
+
+/* Stores the active vertices of set in list in increasing order
+ *
+ * list must have space for all the active vertices. the words are scanned one at a time,
+ * and each set bit is found with a count of trailing zeros.
+ * returns the number of active vertices.
+ */
+size_t compact_vertex_set(const vertex_set *set, vert_t *list) {
+	size_t n_list = 0;
+
+	for(size_t word = 0 ; word < set->n_words ; ++word) {
+		uint64_t bits = set->words[word];
+		while(bits != 0) {
+			list[n_list++] = (word << 6) + __builtin_ctzll(bits);
+
+			// clear the lowest set bit
+			bits &= bits - 1;
+		}
+	}
+
+	return n_list;
+}
+
+
+#ifdef SIMD_KERNELS
+/* Computes min_active_color using AVX2, 8 vertices at a time
+ *
+ * the bitset is read as 32-bit words, so bit u is bit u % 32 of word u / 32. the colors
+ * of the inactive vertices are not gathered, their lanes keep the minimum found so far.
+ */
+__attribute__((target("avx2")))
+static vert_t min_active_color_avx2(
+		const vert_t *verts, size_t len, const vertex_set *is_vertex, const vert_t *colors, vert_t color) {
+	const int *words = (const int *) is_vertex->words;
+	const __m256i low_bits = _mm256_set1_epi32(31);
+	const __m256i one = _mm256_set1_epi32(1);
+
+	__m256i min = _mm256_set1_epi32((int) color);
+
+	size_t i = 0;
+	for(; i + 8 <= len ; i += 8) {
+		__m256i u = _mm256_loadu_si256((const __m256i *) (verts + i));
+
+		__m256i word = _mm256_i32gather_epi32(words, _mm256_srli_epi32(u, 5), 4);
+		__m256i bit = _mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(u, low_bits)), one);
+		__m256i active = _mm256_cmpeq_epi32(bit, one);
+
+		__m256i c = _mm256_mask_i32gather_epi32(min, (const int *) colors, u, active, 4);
+		min = _mm256_min_epu32(min, c);
+	}
+
+	// reduce the 8 lanes to one
+	__m128i min4 = _mm_min_epu32(_mm256_castsi256_si128(min), _mm256_extracti128_si256(min, 1));
+	min4 = _mm_min_epu32(min4, _mm_shuffle_epi32(min4, _MM_SHUFFLE(1, 0, 3, 2)));
+	min4 = _mm_min_epu32(min4, _mm_shuffle_epi32(min4, _MM_SHUFFLE(2, 3, 0, 1)));
+	color = (vert_t) _mm_cvtsi128_si32(min4);
+
+	for(; i < len ; ++i) {
+		vert_t u = verts[i];
+		if(!is_active_vertex(u, is_vertex)) continue;
+
+		vert_t c = __atomic_load_n(&colors[u], __ATOMIC_RELAXED);
+		if(color > c) color = c;
+	}
+
+	return color;
+}
+
+/* Computes min_active_color using AVX-512, 16 vertices at a time
+ *
+ * same as min_active_color_avx2, but the active bits become a mask register directly
+ * and the last vertices are handled with masked loads.
+ */
+__attribute__((target("avx512f")))
+static vert_t min_active_color_avx512(
+		const vert_t *verts, size_t len, const vertex_set *is_vertex, const vert_t *colors, vert_t color) {
+	const int *words = (const int *) is_vertex->words;
+	const __m512i low_bits = _mm512_set1_epi32(31);
+	const __m512i one = _mm512_set1_epi32(1);
+
+	__m512i min = _mm512_set1_epi32((int) color);
+
+	for(size_t i = 0 ; i < len ; i += 16) {
+		// the last vertices are loaded with a mask, instead of a scalar loop
+		__mmask16 valid = (len - i >= 16)? 0xffff : (__mmask16) ((1u << (len - i)) - 1);
+		__m512i u = _mm512_maskz_loadu_epi32(valid, verts + i);
+
+		__m512i word = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), valid, _mm512_srli_epi32(u, 5), words, 4);
+		__mmask16 active = _mm512_test_epi32_mask(_mm512_srlv_epi32(word, _mm512_and_si512(u, low_bits)), one);
+
+		__m512i c = _mm512_mask_i32gather_epi32(min, active, u, (const int *) colors, 4);
+		min = _mm512_min_epu32(min, c);
+	}
+
+	return (vert_t) _mm512_reduce_min_epu32(min);
+}
+
+vert_t (*min_active_color_kernel)(
+		const vert_t *verts, size_t len, const vertex_set *is_vertex, const vert_t *colors, vert_t color) = NULL;
+
+// Chooses the widest kernel the cpu supports, before main runs
+__attribute__((constructor))
+static void select_min_active_color_kernel(void) {
+	__builtin_cpu_init();
+
+	if(__builtin_cpu_supports("avx512f")) min_active_color_kernel = min_active_color_avx512;
+	else if(__builtin_cpu_supports("avx2")) min_active_color_kernel = min_active_color_avx2;
+}
+#endif
+
+
+/* Creates a BFS workspace for searches on a graph with n_verts vertices
+ *
+ * returns a pointer to the workspace or NULL on failure.
+ */
+bfs_workspace *new_bfs_workspace(size_t n_verts) {
+	bfs_workspace *ws = (bfs_workspace *) malloc(sizeof(bfs_workspace));
+	if(ws == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
+
+	ws->n_verts = n_verts;
+	ws->n_edges = 0;
+	ws->shared = false;
+	ws->epoch = 0;
+
+	ws->visited = (uint16_t *) calloc(n_verts, sizeof(uint16_t));
+	ws->queue = (vert_t *) malloc(n_verts * sizeof(vert_t));
+	ws->frontier = NULL;
+	if(ws->visited == NULL || ws->queue == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_bfs_workspace(ws);
+		return NULL;
+	}
+
+	return ws;
+}
+
+// Frees the memory allocated to a BFS workspace
+void free_bfs_workspace(bfs_workspace *ws) {
+	free(ws->visited);
+	free(ws->queue);
+	free(ws->frontier);
+
+	free(ws);
+}
+
+
+// Returns true if vertex is active, reading the bitset atomically if shared is true
+static inline bool read_active_vertex(vert_t vertex, const vertex_set *set, bool shared) {
+	return shared ? is_active_vertex_atomic(vertex, set) : is_active_vertex(vertex, set);
+}
+
+
+/* parameters of the direction-optimizing BFS
+ *
+ * the BFS switches to bottom-up steps when the edges leaving the frontier are more than
+ * 1/BFS_ALPHA of the unexplored edges, and back to top-down steps when the frontier has
+ * less than 1/BFS_BETA of the vertices of the graph. the values are the ones suggested
+ * by Beamer et al. in "Direction-Optimizing Breadth-First Search".
+ */
+#define BFS_ALPHA 14
+#define BFS_BETA 24
+
+/* Performs BFS on graph G starting from start_vertex on nodes that 
+ * have search_property and saves the result in search_result
+ *
+ * properties must be of size n_verts and contains the property value for all the vertices.
+ * the method will result in all verts that can be reached from
+ * start_vertex using bfs via transfer and are homogeneous in search_property,
+ * meaning it will only search the subgraph G' with the nodes that have search_property.
+ *
+ * reverse_transfer must be the opposite of transfer, meaning u is in transfer(v) if and only
+ * if v is in reverse_transfer(u). the BFS is level synchronous and when the frontier is large
+ * it performs bottom-up steps: instead of expanding the frontier, every unvisited vertex
+ * looks for a parent in the frontier through reverse_transfer, which can stop as soon as one
+ * is found. the frontier is stored as a bitmap for these steps.
+ *
+ * the memory of the search is taken from the workspace ws, so no memory is allocated
+ * or cleared, except for the frontier bitmap on the first bottom-up step that uses ws.
+ * search_result points inside ws and is only valid until the next search using ws.
+ * returns the size of search_result or -1 on failure.
+ */
+ssize_t bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		adj_span (*reverse_transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		bfs_workspace *ws, const vert_t **search_result) {
+
+	bool shared = ws->shared;
+	if(!read_active_vertex(start_vertex, is_vertex, shared) || properties[start_vertex] != search_property) return 0;
+
+	// a new epoch unmarks the vertices visited by the previous searches. the
+	// array only has to be cleared when the epoch wraps around.
+	if(++ws->epoch == 0) {
+		memset(ws->visited, 0, ws->n_verts * sizeof(uint16_t));
+		ws->epoch = 1;
+	}
+
+	uint16_t epoch = ws->epoch;
+	uint16_t *visited = ws->visited;
+	visited[start_vertex] = epoch;
+
+	// the vertex queue will contain all the vertices that have to be explored
+	// it will contain at most n_active_verts. head and tail index the head and
+	// tail position of the queue. the vertices of the current level of the bfs
+	// are the ones between head and level_end.
+	vert_t *vertex_queue = ws->queue;
+	vert_t head = 0;
+	vert_t tail = 0;
+
+	// the frontier bitmap is only allocated if a bottom-up step is performed
+	uint64_t *frontier = ws->frontier;
+
+	// enqueue start_vertex
+	vertex_queue[tail++] = start_vertex;
+
+	// the number of edges leaving the frontier and leaving all visited vertices
+	size_t frontier_edges = (*transfer)(start_vertex, G).len;
+	size_t explored_edges = frontier_edges;
+
+	bool bottom_up = false;
+
+	// the number of edges scanned by the search
+	size_t n_edges = 0;
+
+	// while the queue is not empty
+	while(tail > head) {
+		vert_t level_end = tail;
+		size_t next_frontier_edges = 0;
+
+		// choose the direction of the next step
+		if(!bottom_up) {
+			bottom_up = frontier_edges > (G->n_edges - explored_edges) / BFS_ALPHA;
+		} else {
+			bottom_up = (level_end - head) >= G->n_verts / BFS_BETA;
+		}
+
+		if(!bottom_up) {
+			// top-down step, expand all the vertices of the current level
+			for(; head < level_end ; ++head) {
+				// dequeue v
+				vert_t v = vertex_queue[head];
+
+				// get all the vertices that are reachable from v through transfer
+				adj_span front = (*transfer)(v, G);
+				adj_iter front_it = adj_begin(front);
+				n_edges += front.len;
+
+				// for each active w reachable from v
+				for(size_t i = 0 ; i < front.len ; ++i) {
+					vert_t w = adj_next(&front_it);
+
+					// if w not visited and w has search_property
+					if(read_active_vertex(w, is_vertex, shared) && visited[w] != epoch && properties[w] == search_property) {
+						// mark w as visited
+						visited[w] = epoch;
+
+						// enqueue w
+						vertex_queue[tail++] = w;
+						next_frontier_edges += (*transfer)(w, G).len;
+					}
+				}
+			}
+
+		} else {
+			// bottom-up step, mark the current level in the frontier bitmap
+			// the bitmap is kept in ws, it is all zeros again when the search ends
+			if(frontier == NULL) {
+				frontier = (uint64_t *) calloc((G->n_verts + 63) / 64, sizeof(uint64_t));
+				if(frontier == NULL) {
+					fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+					return -1;
+				}
+				ws->frontier = frontier;
+			}
+
+			for(vert_t i = head ; i < level_end ; ++i) {
+				vert_t v = vertex_queue[i];
+				frontier[v / 64] |= (uint64_t) 1 << (v % 64);
+			}
+
+			// then every unvisited w with search_property looks for a parent in the frontier
+			for(vert_t w = 0 ; w < G->n_verts ; ++w) {
+				if(!read_active_vertex(w, is_vertex, shared) || visited[w] == epoch || properties[w] != search_property) {
+					continue;
+				}
+
+				adj_span back = (*reverse_transfer)(w, G);
+				adj_iter back_it = adj_begin(back);
+				for(size_t i = 0 ; i < back.len ; ++i) {
+					vert_t u = adj_next(&back_it);
+					n_edges += 1;
+
+					if(frontier[u / 64] & ((uint64_t) 1 << (u % 64))) {
+						// mark w as visited
+						visited[w] = epoch;
+
+						// enqueue w
+						vertex_queue[tail++] = w;
+						next_frontier_edges += (*transfer)(w, G).len;
+						break;
+					}
+				}
+			}
+
+			// finally clear the current level from the bitmap and dequeue it
+			for(; head < level_end ; ++head) {
+				vert_t v = vertex_queue[head];
+				frontier[v / 64] &= ~((uint64_t) 1 << (v % 64));
+			}
+		}
+
+		frontier_edges = next_frontier_edges;
+		explored_edges += next_frontier_edges;
+	}
+
+	ws->n_edges += n_edges;
+	*search_result = vertex_queue;
+
+	return tail;
+}
+
+/* Performs BFS on graph G starting from start_vertex on nodes that
+ * have search_property and saves the result in search_result
  *
- * neighbours refers to the vertices u such that there exists an edge (v, u) in graph G
- * takes as input the vertex, a pointer to the graph and a pointer to the array of vertices, 
- * as well as an array of vertices that will be considered as active vertices on the graph.
- * allocates and initializes the array of neighbours and returns the number of neighbours.
+ * same as bfs_ws, but it uses a workspace of its own. search_result is allocated
+ * and should be freed by the caller. prefer bfs_ws when performing many searches.
+ * returns the size of search_result or -1 on failure.
  */
-ssize_t get_neighbours(vert_t vertex, const graph *G, const bool *is_vertex, vert_t **neighbours) {
-	// checks if the vertex is contained in the graph
-	if(!is_vertex[vertex]) {
-		return 0;
+ssize_t bfs(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		adj_span (*reverse_transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result) {
+
+	if(!is_active_vertex(start_vertex, is_vertex) || properties[start_vertex] != search_property) return 0;
+
+	bfs_workspace *ws = new_bfs_workspace(G->n_verts);
+	if(ws == NULL) return -1;
+
+	const vert_t *found;
+	ssize_t n_visited = bfs_ws(start_vertex, G, transfer, reverse_transfer,
+			search_property, properties, is_vertex, ws, &found);
+	stats_count(STAT_EDGES, ws->n_edges);
+
+	// the result is at the start of the queue, so the queue is kept as the result
+	if(n_visited > 0) {
+		*search_result = (vert_t *) realloc(ws->queue, n_visited * sizeof(vert_t));
+		ws->queue = NULL;
 	}
 
-	// in the CSR format the vertices u that a given vertex v point to are given
-	// in the col_id array at indices row_id[v]..row_id[v+1]
-	edge_t col_index_start = G->csr_row_id[vertex];
-	edge_t col_index_end = G->csr_row_id[vertex + 1];
-	size_t neighbour_count = col_index_end - col_index_start;
+	free_bfs_workspace(ws);
+
+	return n_visited;
+}
+
+// Performs BFS on graph G with transfer=neighbours_span, using the workspace ws
+ssize_t forward_bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		bfs_workspace *ws, const vert_t **search_result) {
+	return bfs_ws(start_vertex, G, neighbours_span, predecessors_span, search_property, properties, is_vertex, ws, search_result);
+}
+
+// Performs BFS on graph G with transfer=predecessors_span, using the workspace ws
+ssize_t backward_bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		bfs_workspace *ws, const vert_t **search_result) {
+	return bfs_ws(start_vertex, G, predecessors_span, neighbours_span, search_property, properties, is_vertex, ws, search_result);
+}
+
+// Performs BFS on graph G with transfer=neighbours_span
+ssize_t forward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		vert_t **search_result) {
+	return bfs(start_vertex, G, neighbours_span, predecessors_span, search_property, properties, is_vertex, search_result);
+}
+
+// Performs BFS on graph G with transfer=predecessors_span
+ssize_t backward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		vert_t **search_result) {
+	return bfs(start_vertex, G, predecessors_span, neighbours_span, search_property, properties, is_vertex, search_result);
+}
+
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it performs the levels of a parallel BFS together with the other threads of the search.
+ * at each level the thread expands its block of the current level, collecting the newly
+ * visited vertices in its local frontier, then the local frontiers are appended to the
+ * shared vertex queue which becomes the next level. threads claim vertices by atomically
+ * setting visited, so each vertex is added by exactly one thread.
+ */
+struct p_bfs_shared {
+	const graph *G;
+	adj_span (*transfer)(vert_t, const graph *);
+
+	vert_t search_property;
+	const vert_t *properties;
+	const vertex_set *is_vertex;
+
+	uint8_t *visited;
+	vert_t *vertex_queue;
+
+	// the current level is vertex_queue[head..level_end)
+	size_t head;
+	size_t level_end;
+
+	int num_threads;
+	pthread_barrier_t barrier;
+
+	// the local frontiers of the threads and their position in the vertex queue
+	size_t *local_size;
+	size_t *local_offset;
+
+	bool failed;
+
+};
+
+struct p_bfs_args {
+	int thread_id;
+	struct p_bfs_shared *shared;
+
+	vert_t *local_frontier;
+	size_t local_capacity;
+
+}; static void *p_bfs_level(void *args) {
+	struct p_bfs_args *bargs = (struct p_bfs_args *) args;
+	struct p_bfs_shared *sh = bargs->shared;
+
+	int t = bargs->thread_id;
+
+	// the edges scanned by the thread are added to the statistics once the search ends
+	size_t n_edges = 0;
 
-	// checks if there are any neighbours
-	if(neighbour_count > 0) {
-		// allocates the required memory and handles for errors
-		*neighbours = (vert_t *) malloc(neighbour_count * sizeof(vert_t));
-		if(*neighbours == NULL) {
-			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-			return -1;
+	// the threads of the search are traced in place of the threads of the same id
+	trace_thread(t);
+
+	while(true) {
+		trace_begin("p_bfs_level");
+
+		// each thread is responsible for an equal block of the current level
+		size_t level_size = sh->level_end - sh->head;
+		size_t block_size = level_size / sh->num_threads;
+		size_t start = sh->head + t * block_size;
+		size_t end = (t == sh->num_threads - 1)? sh->level_end : start + block_size;
+
+		size_t local_size = 0;
+		for(size_t i = start ; i < end ; ++i) {
+			adj_span front = (*sh->transfer)(sh->vertex_queue[i], sh->G);
+			adj_iter front_it = adj_begin(front);
+			n_edges += front.len;
+
+			for(size_t j = 0 ; j < front.len ; ++j) {
+				vert_t w = adj_next(&front_it);
+
+				if(!is_active_vertex(w, sh->is_vertex) || sh->properties[w] != sh->search_property) continue;
+
+				// check before the atomic operation, most neighbours are already visited
+				if(__atomic_load_n(&sh->visited[w], __ATOMIC_RELAXED)) continue;
+				if(__atomic_exchange_n(&sh->visited[w], 1, __ATOMIC_RELAXED)) continue;
+
+				// grow the local frontier if needed
+				if(local_size == bargs->local_capacity) {
+					size_t capacity = 2 * bargs->local_capacity + 1024;
+					vert_t *local_frontier = (vert_t *) realloc(bargs->local_frontier, capacity * sizeof(vert_t));
+					if(local_frontier == NULL) {
+						// the vertex is lost, but the whole search will fail anyway
+						__atomic_store_n(&sh->failed, true, __ATOMIC_RELAXED);
+						break;
+					}
+
+					bargs->local_frontier = local_frontier;
+					bargs->local_capacity = capacity;
+				}
+
+				bargs->local_frontier[local_size++] = w;
+			}
 		}
+		sh->local_size[t] = local_size;
+
+		trace_end("p_bfs_level");
 
-		// then fills the array with the correct data
-		size_t j = 0;
-		for(size_t i = 0; i < neighbour_count ; ++i) {
-			vert_t vertex_to_add = G->csr_col_id[col_index_start + i];
-			if(is_vertex[vertex_to_add]) {
-				(*neighbours)[j++] = vertex_to_add;
+		// one thread places the local frontiers one after the other after the current level
+		if(pthread_barrier_wait(&sh->barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+			size_t offset = sh->level_end;
+			for(int i = 0 ; i < sh->num_threads ; ++i) {
+				sh->local_offset[i] = offset;
+				offset += sh->local_size[i];
 			}
+
+			sh->head = sh->level_end;
+			sh->level_end = offset;
+		}
+		pthread_barrier_wait(&sh->barrier);
+
+		// then each thread copies its local frontier in the vertex queue.
+		// a thread that found nothing may not have allocated its local frontier yet
+		if(local_size > 0) {
+			memcpy(sh->vertex_queue + sh->local_offset[t], bargs->local_frontier, local_size * sizeof(vert_t));
 		}
+		pthread_barrier_wait(&sh->barrier);
+
+		// the search ends when the next level is empty
+		if(sh->head == sh->level_end || __atomic_load_n(&sh->failed, __ATOMIC_RELAXED)) break;
+	}
+
+	stats_count(STAT_EDGES, n_edges);
+
+	return NULL;
+}
+
+// Runs task on num_threads new threads, creating them for this search only
+static void p_bfs_spawn_threads(void *(*task)(void *), void *args, size_t args_size, int num_threads, void *run_ctx) {
+	pthread_t threads[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pthread_create(&threads[i], NULL, task, (char *) args + i * args_size);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+}
+
+/* Performs BFS on graph G in parallel using num_threads threads
+ *
+ * the arguments and the result are the same as in bfs, but the order of the vertices
+ * in search_result may be different. the threads of the search are created for it,
+ * so this should only be used when the region searched is large.
+ */
+ssize_t p_bfs(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads) {
+	return p_bfs_run(start_vertex, G, transfer, search_property, properties, is_vertex,
+			search_result, num_threads, p_bfs_spawn_threads, NULL);
+}
+
+/* Performs BFS on graph G in parallel using the num_threads threads of run
+ *
+ * same as p_bfs, but the threads are provided by the caller: run(task, args, args_size,
+ * num_threads, run_ctx) must execute task(&args[i]) on num_threads threads at the same
+ * time, one for each i, and return once all of them are done. the threads of a task wait
+ * for each other after every level, so they must not share a processor with other work.
+ */
+ssize_t p_bfs_run(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads, p_bfs_runner run, void *run_ctx) {
+
+	if(!is_active_vertex(start_vertex, is_vertex) || properties[start_vertex] != search_property) return 0;
+
+	struct p_bfs_shared sh;
+
+	sh.G = G;
+	sh.transfer = transfer;
+
+	sh.search_property = search_property;
+	sh.properties = properties;
+	sh.is_vertex = is_vertex;
+
+	sh.num_threads = num_threads;
+	sh.failed = false;
+
+	// visited is accessed atomically so it is stored as bytes
+	sh.visited = (uint8_t *) calloc(G->n_verts, sizeof(uint8_t));
+	sh.vertex_queue = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	sh.local_size = (size_t *) malloc(num_threads * sizeof(size_t));
+	sh.local_offset = (size_t *) malloc(num_threads * sizeof(size_t));
+	if(sh.visited == NULL || sh.vertex_queue == NULL || sh.local_size == NULL || sh.local_offset == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(sh.visited);
+		free(sh.vertex_queue);
+		free(sh.local_size);
+		free(sh.local_offset);
+		return -1;
+	}
+
+	// enqueue start_vertex, it is the first level of the search
+	sh.visited[start_vertex] = 1;
+	sh.vertex_queue[0] = start_vertex;
+	sh.head = 0;
+	sh.level_end = 1;
+
+	pthread_barrier_init(&sh.barrier, NULL, num_threads);
+
+	struct p_bfs_args bargs[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bargs[i].thread_id = i;
+		bargs[i].shared = &sh;
+
+		bargs[i].local_frontier = NULL;
+		bargs[i].local_capacity = 0;
+	}
+
+	(*run)(p_bfs_level, bargs, sizeof(bargs[0]), num_threads, run_ctx);
+
+	for(int i = 0 ; i < num_threads ; ++i) free(bargs[i].local_frontier);
+
+	pthread_barrier_destroy(&sh.barrier);
+
+	free(sh.visited);
+	free(sh.local_size);
+	free(sh.local_offset);
+
+	if(sh.failed) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(sh.vertex_queue);
+		return -1;
+	}
+
+	// the vertices visited are all the levels in the queue
+	size_t n_visited = sh.level_end;
+
+	*search_result = (vert_t *) realloc(sh.vertex_queue, n_visited * sizeof(vert_t));
+
+	return n_visited;
+}
+
+// Performs parallel BFS on graph G with transfer=neighbours_span
+ssize_t p_forward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		vert_t **search_result, int num_threads) {
+	return p_bfs(start_vertex, G, neighbours_span, search_property, properties, is_vertex, search_result, num_threads);
+}
+
+// Performs parallel BFS on graph G with transfer=predecessors_span
+ssize_t p_backward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex,
+		vert_t **search_result, int num_threads) {
+	return p_bfs(start_vertex, G, predecessors_span, search_property, properties, is_vertex, search_result, num_threads);
+}
+
+
+/* Returns true if v is a trivial SCC
+ *
+ * this is the case if v has no neighbours or no predecessors
+ * or if its only neighbour/predecessor is itself
+ */
+int is_trivial_scc(vert_t v, const graph *G, const vertex_set *is_vertex) {
+	bool has_neighbour = false;
+	adj_span N = neighbours_span(v, G);
+	adj_iter N_it = adj_begin(N);
+	for(size_t i = 0 ; i < N.len && !has_neighbour ; ++i) {
+		vert_t u = adj_next(&N_it);
+		has_neighbour = (u != v && is_active_vertex(u, is_vertex));
+	}
+
+	if(!has_neighbour) return 1;
+
+	bool has_predecessor = false;
+	adj_span P = predecessors_span(v, G);
+	adj_iter P_it = adj_begin(P);
+	for(size_t i = 0 ; i < P.len && !has_predecessor ; ++i) {
+		vert_t u = adj_next(&P_it);
+		has_predecessor = (u != v && is_active_vertex(u, is_vertex));
+	}
+
+	if(!has_predecessor) return 1;
+
+	return false;
+}
+
+// Returns the first active vertex in the span other than vertex, or vertex if there is none
+static vert_t first_active_vertex(vert_t vertex, adj_span adj, const vertex_set *is_vertex, bool shared) {
+	adj_iter it = adj_begin(adj);
+	for(size_t i = 0 ; i < adj.len ; ++i) {
+		vert_t u = adj_next(&it);
+		if(u != vertex && read_active_vertex(u, is_vertex, shared)) return u;
+	}
+
+	return vertex;
+}
+
+/* Returns true if v and pair form an SCC of two vertices, with v < pair
+ *
+ * in_degree and out_degree hold the number of active predecessors and successors
+ * of the active vertices, not counting self loops. if the only predecessor of v is u
+ * and the only predecessor of u is v, every cycle through v also goes through u,
+ * so {u, v} is an SCC. the same holds for successors.
+ * only the smaller vertex of the pair returns true, so each pair is found once.
+ * shared is true when other threads may remove vertices of is_vertex meanwhile,
+ * so the bitset is read atomically.
+ */
+bool is_trivial_pair(vert_t v, const graph *G, const vertex_set *is_vertex,
+		const vert_t *in_degree, const vert_t *out_degree, vert_t *pair, bool shared) {
+
+	if(in_degree[v] == 1) {
+		vert_t u = first_active_vertex(v, predecessors_span(v, G), is_vertex, shared);
+		if(u > v && in_degree[u] == 1 && first_active_vertex(u, predecessors_span(u, G), is_vertex, shared) == v) {
+			*pair = u;
+			return true;
+		}
+	}
+
+	if(out_degree[v] == 1) {
+		vert_t u = first_active_vertex(v, neighbours_span(v, G), is_vertex, shared);
+		if(u > v && out_degree[u] == 1 && first_active_vertex(u, neighbours_span(u, G), is_vertex, shared) == v) {
+			*pair = u;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+#ifdef COMPRESSED_ADJ
+// Returns the number of bytes value takes as a varint
+static inline size_t varint_size(uint64_t value) {
+	size_t size = 1;
+	while(value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+// Writes value as a varint at out and returns the number of bytes written
+static inline size_t write_varint(uint8_t *out, uint64_t value) {
+	size_t size = 0;
+	while(value >= 0x80) {
+		out[size++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	out[size++] = (uint8_t) value;
+
+	return size;
+}
+
+// Returns the zigzag encoding of the gap from prev to w, so small gaps of either sign stay small
+static inline uint32_t zigzag_gap(vert_t prev, vert_t w) {
+	int32_t gap = (int32_t) (w - prev);
+	return ((uint32_t) gap << 1) ^ (uint32_t) (gap >> 31);
+}
+#endif
+
+// Returns the number of adj_t elements the list verts of vertex takes in the adjacency arrays
+static size_t adj_list_size(vert_t vertex, const vert_t *verts, size_t len) {
+#ifdef COMPRESSED_ADJ
+	size_t size = varint_size(len);
+
+	vert_t prev = vertex;
+	for(size_t i = 0 ; i < len ; ++i) {
+		size += varint_size(zigzag_gap(prev, verts[i]));
+		prev = verts[i];
+	}
+
+	return size;
+#else
+	(void) vertex;
+	(void) verts;
+	return len;
+#endif
+}
+
+// Writes the list verts of vertex at out and returns the number of adj_t elements written
+static size_t write_adj_list(adj_t *out, vert_t vertex, const vert_t *verts, size_t len) {
+#ifdef COMPRESSED_ADJ
+	size_t size = write_varint(out, len);
+
+	vert_t prev = vertex;
+	for(size_t i = 0 ; i < len ; ++i) {
+		size += write_varint(out + size, zigzag_gap(prev, verts[i]));
+		prev = verts[i];
+	}
+
+	return size;
+#else
+	(void) vertex;
+	memcpy(out, verts, len * sizeof(vert_t));
+	return len;
+#endif
+}
+
+/* Writes the active vertices of the list adj in list, relabeled with new_id
+ *
+ * returns the number of vertices written.
+ */
+static size_t active_list(adj_span adj, const vertex_set *is_vertex, const vert_t *new_id, vert_t *list) {
+	size_t len = 0;
+
+	adj_iter adj_it = adj_begin(adj);
+	for(size_t i = 0 ; i < adj.len ; ++i) {
+		vert_t u = adj_next(&adj_it);
+		if(is_active_vertex(u, is_vertex)) list[len++] = new_id[u];
+	}
+
+	return len;
+}
+
+/* Builds the subgraph of G induced by the active vertices of is_vertex
+ *
+ * the active vertices are relabeled 0..n_active - 1 in increasing order, so the order
+ * of the vertices (and the sorted adjacency lists) are the same as in G. only the edges
+ * between active vertices are kept. old_id[v] is set to the vertex of G that is vertex v
+ * of the subgraph.
+ * returns the subgraph or NULL on failure.
+ */
+graph *induced_subgraph(const graph *G, const vertex_set *is_vertex, vert_t **old_id) {
+	// the new labels of the active vertices, only set for the active vertices
+	vert_t *new_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	*old_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(new_id == NULL || *old_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(new_id);
+		free(*old_id);
+		return NULL;
+	}
+
+	size_t n_verts = compact_vertex_set(is_vertex, *old_id);
+	for(vert_t v = 0 ; v < n_verts ; ++v) new_id[(*old_id)[v]] = v;
+
+	// the filtered lists are gathered in list before they are written, so it
+	// has to fit the longest list of an active vertex
+	size_t max_len = 0;
+	for(vert_t v = 0 ; v < n_verts ; ++v) {
+		size_t out_len = neighbours_span((*old_id)[v], G).len;
+		size_t in_len = predecessors_span((*old_id)[v], G).len;
+		if(out_len > max_len) max_len = out_len;
+		if(in_len > max_len) max_len = in_len;
+	}
+
+	vert_t *list = (vert_t *) malloc((max_len + 1) * sizeof(vert_t));
+	if(list == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(new_id);
+		free(*old_id);
+		return NULL;
+	}
+
+	// count the edges between active vertices and the size of their lists
+	size_t n_edges = 0;
+	size_t csr_len = 0;
+	size_t csc_len = 0;
+	for(vert_t v = 0 ; v < n_verts ; ++v) {
+		size_t len = active_list(neighbours_span((*old_id)[v], G), is_vertex, new_id, list);
+		n_edges += len;
+		csr_len += adj_list_size(v, list, len);
+
+		len = active_list(predecessors_span((*old_id)[v], G), is_vertex, new_id, list);
+		csc_len += adj_list_size(v, list, len);
+	}
+
+	graph *H = initialize_graph(n_verts, n_edges);
+#ifdef COMPRESSED_ADJ
+	if(H != NULL) {
+		H->csr_col_id = (adj_t *) malloc(csr_len * sizeof(adj_t));
+		H->csc_row_id = (adj_t *) malloc(csc_len * sizeof(adj_t));
+		if(H->csr_col_id == NULL || H->csc_row_id == NULL) {
+			free_graph(H);
+			H = NULL;
+		}
+	}
+#endif
+	if(H == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(list);
+		free(new_id);
+		free(*old_id);
+		return NULL;
+	}
+
+	// copy the CSR and CSC arrays, keeping only the active vertices
+	H->csr_row_id[0] = 0;
+	H->csc_col_id[0] = 0;
+	for(vert_t v = 0 ; v < n_verts ; ++v) {
+		size_t len = active_list(neighbours_span((*old_id)[v], G), is_vertex, new_id, list);
+		H->csr_row_id[v + 1] = H->csr_row_id[v] + write_adj_list(H->csr_col_id + H->csr_row_id[v], v, list, len);
+
+		len = active_list(predecessors_span((*old_id)[v], G), is_vertex, new_id, list);
+		H->csc_col_id[v + 1] = H->csc_col_id[v] + write_adj_list(H->csc_row_id + H->csc_col_id[v], v, list, len);
+	}
+
+	free(list);
+	free(new_id);
+
+	return H;
+}
+
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it counts the lines of the .mtx body between start and end. this is an upper bound
+ * on the number of entries in the chunk, used to find where each chunk writes its entries.
+ */
+struct parse_chunk_args {
+	const char *start;
+	const char *end;
+
+	size_t n_verts;
+
+	// the entries of integer and real matrices are followed by one value, of that type
+	bool has_value;
+	bool real_value;
+
+	size_t n_lines;
+	size_t n_entries;
+	bool invalid;
+	size_t invalid_line;
+
+	vert_t *rows;
+	vert_t *cols;
+
+}; static void *p_count_lines(void *args) {
+	struct parse_chunk_args *pcargs = (struct parse_chunk_args *) args;
+
+	size_t n_lines = 0;
+
+	const char *c = pcargs->start;
+	while(c < pcargs->end) {
+		const char *eol = memchr(c, '\n', pcargs->end - c);
+		if(eol == NULL) break;
+
+		n_lines += 1;
+		c = eol + 1;
+	}
+
+	// the last line of the file might not be terminated by a newline
+	if(c < pcargs->end) n_lines += 1;
+
+	pcargs->n_lines = n_lines;
+
+	return NULL;
+}
+
+// Returns true for the whitespace characters that may separate entries in a line
+static inline bool is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Scans an unsigned decimal integer starting at c
+ *
+ * stores the integer in value and returns a pointer to the first character after it,
+ * or NULL if c does not point to a digit or the integer does not fit in 64 bits.
+ */
+static inline const char *scan_uint(const char *c, const char *end, uint64_t *value) {
+	if(c >= end || *c < '0' || *c > '9') return NULL;
+
+	uint64_t v = 0;
+	while(c < end && *c >= '0' && *c <= '9') {
+		uint64_t d = (uint64_t) (*c - '0');
+		if(v > (UINT64_MAX - d) / 10) return NULL;
+
+		v = 10 * v + d;
+		c++;
+	}
+
+	*value = v;
+	return c;
+}
+
+// Skips the decimal digits starting at c and returns a pointer to the first character after them
+static inline const char *skip_digits(const char *c, const char *end) {
+	while(c < end && *c >= '0' && *c <= '9') c++;
+	return c;
+}
+
+/* Scans the value of an entry starting at c
+ *
+ * the value is an optionally signed integer, or if real is true a decimal number
+ * with an optional fraction and exponent. it is only checked, not stored.
+ * returns a pointer to the first character after it, or NULL if c does not point to one.
+ */
+static inline const char *scan_value(const char *c, const char *end, bool real) {
+	if(c < end && (*c == '+' || *c == '-')) c++;
+
+	const char *digits = c;
+	c = skip_digits(c, end);
+	bool has_digits = (c > digits);
+
+	if(real && c < end && *c == '.') {
+		const char *fraction = ++c;
+		c = skip_digits(c, end);
+		has_digits = has_digits || (c > fraction);
+	}
+	if(!has_digits) return NULL;
+
+	if(real && c < end && (*c == 'e' || *c == 'E')) {
+		c++;
+		if(c < end && (*c == '+' || *c == '-')) c++;
+
+		const char *exponent = c;
+		c = skip_digits(c, end);
+		if(c == exponent) return NULL;
+	}
+
+	return c;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it parses the lines of the .mtx body between start and end, storing the (0-based)
+ * row and column of each entry in rows and cols. the value following the column index
+ * of integer and real matrices is checked and discarded. blank lines are skipped, and
+ * any malformed line or index out of bounds sets the invalid flag and stores the
+ * (0-based) line of the chunk it is on in invalid_line.
+ */
+static void *p_parse_chunk(void *args) {
+	struct parse_chunk_args *pcargs = (struct parse_chunk_args *) args;
+
+	const char *c = pcargs->start;
+	const char *end = pcargs->end;
+
+	size_t n_entries = 0;
+	size_t line = 0;
+	pcargs->invalid = false;
+
+	while(c < end) {
+		// skip any whitespace, including empty lines
+		while(c < end && is_blank(*c)) c++;
+		if(c < end && *c == '\n') {
+			c++;
+			line += 1;
+			continue;
+		}
+		if(c >= end) break;
+
+		// any check below that fails stops the loop with the invalid flag set
+		pcargs->invalid = true;
+		pcargs->invalid_line = line;
+
+		uint64_t row, col;
+
+		c = scan_uint(c, end, &row);
+		if(c == NULL || c >= end || !is_blank(*c)) break;
+		while(c < end && is_blank(*c)) c++;
+
+		c = scan_uint(c, end, &col);
+		if(c == NULL || (c < end && !is_blank(*c) && *c != '\n')) break;
+		while(c < end && is_blank(*c)) c++;
+
+		// then exactly one value for integer and real matrices, and none for pattern ones
+		if(pcargs->has_value) {
+			c = scan_value(c, end, pcargs->real_value);
+			if(c == NULL || (c < end && !is_blank(*c) && *c != '\n')) break;
+			while(c < end && is_blank(*c)) c++;
+		}
+		if(c < end && *c != '\n') break;
+
+		if(row == 0 || col == 0 || row > pcargs->n_verts || col > pcargs->n_verts) break;
+		pcargs->invalid = false;
+
+		pcargs->rows[n_entries] = row - 1;
+		pcargs->cols[n_entries] = col - 1;
+		n_entries += 1;
+
+		// move to the next line
+		if(c < end) c++;
+		line += 1;
+	}
+
+	pcargs->n_entries = n_entries;
+
+	return NULL;
+}
+
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it counts the out-degree and in-degree of the vertices, for the entries between start
+ * and end, in csr_row_id[row + 1] and csc_col_id[col + 1] respectively.
+ */
+struct build_graph_args {
+	size_t start;
+	size_t end;
+
+	const vert_t *rows;
+	const vert_t *cols;
+
+	graph *G;
+	vert_t *csr_col_id;
+	vert_t *csc_row_id;
+
+	edge_t *csr_pos;
+	edge_t *csc_pos;
+
+	edge_t csr_block_sum;
+	edge_t csc_block_sum;
+
+}; static void *p_count_degrees(void *args) {
+	struct build_graph_args *bgargs = (struct build_graph_args *) args;
+
+	for(size_t i = bgargs->start ; i < bgargs->end ; ++i) {
+		__atomic_fetch_add(&bgargs->G->csr_row_id[bgargs->rows[i] + 1], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&bgargs->G->csc_col_id[bgargs->cols[i] + 1], 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it performs the cumulative sum of csr_row_id and csc_col_id locally,
+ * for the indices between start and end, and stores the sum of the block.
+ */
+static void *p_block_prefix_sum(void *args) {
+	struct build_graph_args *bgargs = (struct build_graph_args *) args;
+
+	edge_t *csr_row_id = bgargs->G->csr_row_id;
+	edge_t *csc_col_id = bgargs->G->csc_col_id;
+
+	for(size_t i = bgargs->start + 1 ; i < bgargs->end ; ++i) {
+		csr_row_id[i] += csr_row_id[i - 1];
+		csc_col_id[i] += csc_col_id[i - 1];
+	}
+
+	bgargs->csr_block_sum = (bgargs->end > bgargs->start)? csr_row_id[bgargs->end - 1] : 0;
+	bgargs->csc_block_sum = (bgargs->end > bgargs->start)? csc_col_id[bgargs->end - 1] : 0;
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it adds the sum of all the previous blocks to the indices between start and end
+ * completing the cumulative sum. the block sum fields hold the offset to add.
+ */
+static void *p_block_add_offset(void *args) {
+	struct build_graph_args *bgargs = (struct build_graph_args *) args;
+
+	for(size_t i = bgargs->start ; i < bgargs->end ; ++i) {
+		bgargs->G->csr_row_id[i] += bgargs->csr_block_sum;
+		bgargs->G->csc_col_id[i] += bgargs->csc_block_sum;
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it places each entry between start and end in the CSR and CSC arrays.
+ * csr_pos[row] and csc_pos[col] hold the next free position of each row and column.
+ */
+static void *p_scatter_entries(void *args) {
+	struct build_graph_args *bgargs = (struct build_graph_args *) args;
+
+	for(size_t i = bgargs->start ; i < bgargs->end ; ++i) {
+		vert_t row = bgargs->rows[i];
+		vert_t col = bgargs->cols[i];
+
+		edge_t csr_i = __atomic_fetch_add(&bgargs->csr_pos[row], 1, __ATOMIC_RELAXED);
+		edge_t csc_i = __atomic_fetch_add(&bgargs->csc_pos[col], 1, __ATOMIC_RELAXED);
+
+		bgargs->csr_col_id[csr_i] = col;
+		bgargs->csc_row_id[csc_i] = row;
+	}
+
+	return NULL;
+}
+
+// Compare two vertices, helper function to be used inside qsort.
+static int comp_vert(const void *a, const void *b) {
+	vert_t vert_a = *((const vert_t *) a);
+	vert_t vert_b = *((const vert_t *) b);
+
+	return (vert_a > vert_b) - (vert_a < vert_b);
+}
+
+// Sorts the vertices in verts[0..len), using insertion sort for short lists.
+static void sort_verts(vert_t *verts, size_t len) {
+	if(len > 32) {
+		qsort(verts, len, sizeof(vert_t), comp_vert);
+		return;
+	}
+
+	for(size_t i = 1 ; i < len ; ++i) {
+		vert_t v = verts[i];
+
+		size_t j = i;
+		for(; j > 0 && verts[j - 1] > v ; --j) verts[j] = verts[j - 1];
+		verts[j] = v;
+	}
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * the entries are scattered in an arbitrary order inside each row and column,
+ * so it sorts the adjacency lists of the vertices between start and end.
+ */
+static void *p_sort_adjacency(void *args) {
+	struct build_graph_args *bgargs = (struct build_graph_args *) args;
+	graph *G = bgargs->G;
+
+	for(size_t v = bgargs->start ; v < bgargs->end ; ++v) {
+		sort_verts(bgargs->csr_col_id + G->csr_row_id[v], G->csr_row_id[v + 1] - G->csr_row_id[v]);
+		sort_verts(bgargs->csc_row_id + G->csc_col_id[v], G->csc_col_id[v + 1] - G->csc_col_id[v]);
+	}
+
+	return NULL;
+}
+
+/* Builds the CSR and CSC arrays of G from the COO entries in rows and cols
+ *
+ * uses a parallel counting sort: the degrees of all vertices are counted, a cumulative sum
+ * gives the start of each adjacency list and then every entry is placed directly in its list.
+ * the lists are stored uncompressed in csr_col_id and csc_row_id, which have n_edges entries.
+ * returns 0 on success and -1 on failure.
+ */
+static int build_graph(graph *G, vert_t *csr_col_id, vert_t *csc_row_id,
+		const vert_t *rows, const vert_t *cols, int num_threads) {
+	pthread_t threads[num_threads];
+	struct build_graph_args bgargs[num_threads];
+
+	size_t n_verts = G->n_verts;
+	size_t n_edges = G->n_edges;
+
+	// the block sizes refer to the number of edges and vertices each thread is responsible for
+	size_t p_edge_block_size = n_edges / num_threads;
+	size_t p_vert_block_size = (n_verts + 1) / num_threads;
+
+	memset(G->csr_row_id, 0, (n_verts + 1) * sizeof(edge_t));
+	memset(G->csc_col_id, 0, (n_verts + 1) * sizeof(edge_t));
+
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bgargs[i].rows = rows;
+		bgargs[i].cols = cols;
+		bgargs[i].G = G;
+		bgargs[i].csr_col_id = csr_col_id;
+		bgargs[i].csc_row_id = csc_row_id;
+	}
+
+	// count the degrees of the vertices in parallel
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bgargs[i].start = i * p_edge_block_size;
+		bgargs[i].end = (i == num_threads - 1)? n_edges : (i + 1) * p_edge_block_size;
+
+		pthread_create(&threads[i], NULL, p_count_degrees, &bgargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	// then perform the cumulative sum in parallel, first inside each block
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bgargs[i].start = i * p_vert_block_size;
+		bgargs[i].end = (i == num_threads - 1)? n_verts + 1 : (i + 1) * p_vert_block_size;
+
+		pthread_create(&threads[i], NULL, p_block_prefix_sum, &bgargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	// then turn the block sums into the offset of each block
+	edge_t csr_offset = 0;
+	edge_t csc_offset = 0;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		edge_t csr_block_sum = bgargs[i].csr_block_sum;
+		edge_t csc_block_sum = bgargs[i].csc_block_sum;
+
+		bgargs[i].csr_block_sum = csr_offset;
+		bgargs[i].csc_block_sum = csc_offset;
+
+		csr_offset += csr_block_sum;
+		csc_offset += csc_block_sum;
+	}
+
+	// and add the offset to each block
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pthread_create(&threads[i], NULL, p_block_add_offset, &bgargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	// csr_pos and csc_pos hold the next free position in each adjacency list
+	edge_t *csr_pos = (edge_t *) malloc(n_verts * sizeof(edge_t));
+	edge_t *csc_pos = (edge_t *) malloc(n_verts * sizeof(edge_t));
+	if(csr_pos == NULL || csc_pos == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(csr_pos);
+		free(csc_pos);
+		return -1;
+	}
+	memcpy(csr_pos, G->csr_row_id, n_verts * sizeof(edge_t));
+	memcpy(csc_pos, G->csc_col_id, n_verts * sizeof(edge_t));
+
+	// place the entries in the CSR and CSC arrays in parallel
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bgargs[i].start = i * p_edge_block_size;
+		bgargs[i].end = (i == num_threads - 1)? n_edges : (i + 1) * p_edge_block_size;
+
+		bgargs[i].csr_pos = csr_pos;
+		bgargs[i].csc_pos = csc_pos;
+
+		pthread_create(&threads[i], NULL, p_scatter_entries, &bgargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	free(csr_pos);
+	free(csc_pos);
+
+	// finally sort each adjacency list in parallel
+	p_vert_block_size = n_verts / num_threads;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		bgargs[i].start = i * p_vert_block_size;
+		bgargs[i].end = (i == num_threads - 1)? n_verts : (i + 1) * p_vert_block_size;
+
+		pthread_create(&threads[i], NULL, p_sort_adjacency, &bgargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	return 0;
+}
+
+
+/* Turns the sizes of the adjacency lists in offsets[1..n_verts] into their start positions
+ *
+ * the cumulative sum is done in 64 bits so that an overflow of edge_t is caught.
+ * returns 0 on success and -1 if the lists do not fit in edge_t.
+ */
+static int sum_adj_offsets(edge_t *offsets, size_t n_verts) {
+	uint64_t adj_len = 0;
+	offsets[0] = 0;
+	for(size_t v = 0 ; v < n_verts ; ++v) {
+		adj_len += offsets[v + 1];
+		offsets[v + 1] = adj_len;
+	}
+
+	if(adj_len > MAX_EDGES) {
+		fprintf(stderr, "Error: the adjacency lists are too large\n"
+				"%llu elements, at most %zu are supported\n"
+				"rebuild with EDGE64=1 to use 64-bit edge offsets\n",
+				(unsigned long long) adj_len, MAX_EDGES);
+		return -1;
+	}
+
+	return 0;
+}
+
+#ifdef COMPRESSED_ADJ
+/* This function is meant to be executed inside a thread.
+ *
+ * it computes the size of the compressed lists of the vertices between start and end,
+ * the size of the list of v is stored in adj_offsets[v + 1].
+ */
+struct encode_args {
+	size_t start;
+	size_t end;
+
+	const edge_t *offsets;
+	const vert_t *verts;
+
+	edge_t *adj_offsets;
+	adj_t *adj;
+
+}; static void *p_encode_sizes(void *args) {
+	struct encode_args *eargs = (struct encode_args *) args;
+
+	for(size_t v = eargs->start ; v < eargs->end ; ++v) {
+		const vert_t *list = eargs->verts + eargs->offsets[v];
+		eargs->adj_offsets[v + 1] = adj_list_size(v, list, eargs->offsets[v + 1] - eargs->offsets[v]);
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it writes the compressed lists of the vertices between start and end at adj_offsets.
+ */
+static void *p_encode_lists(void *args) {
+	struct encode_args *eargs = (struct encode_args *) args;
+
+	for(size_t v = eargs->start ; v < eargs->end ; ++v) {
+		const vert_t *list = eargs->verts + eargs->offsets[v];
+		write_adj_list(eargs->adj + eargs->adj_offsets[v], v, list, eargs->offsets[v + 1] - eargs->offsets[v]);
+	}
+
+	return NULL;
+}
+
+/* Compresses the adjacency lists of a graph with n_verts vertices
+ *
+ * the list of v is verts[offsets[v]..offsets[v + 1]). on success offsets is replaced
+ * by the byte offsets of the compressed lists and the compressed lists are returned,
+ * verts is left untouched and should be freed by the caller.
+ * returns NULL on failure.
+ */
+static adj_t *encode_adjacency(size_t n_verts, edge_t *offsets, const vert_t *verts, int num_threads) {
+	edge_t *adj_offsets = (edge_t *) malloc((n_verts + 1) * sizeof(edge_t));
+	if(adj_offsets == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
+
+	pthread_t threads[num_threads];
+	struct encode_args eargs[num_threads];
+
+	size_t p_vert_block_size = n_verts / num_threads;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		eargs[i].start = i * p_vert_block_size;
+		eargs[i].end = (i == num_threads - 1)? n_verts : (i + 1) * p_vert_block_size;
+		eargs[i].offsets = offsets;
+		eargs[i].verts = verts;
+		eargs[i].adj_offsets = adj_offsets;
+		eargs[i].adj = NULL;
+
+		pthread_create(&threads[i], NULL, p_encode_sizes, &eargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	if(sum_adj_offsets(adj_offsets, n_verts) == -1) {
+		free(adj_offsets);
+		return NULL;
+	}
+	size_t adj_len = adj_offsets[n_verts];
+
+	adj_t *adj = (adj_t *) malloc(adj_len * sizeof(adj_t));
+	if(adj == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(adj_offsets);
+		return NULL;
+	}
+
+	for(int i = 0 ; i < num_threads ; ++i) {
+		eargs[i].adj = adj;
+
+		pthread_create(&threads[i], NULL, p_encode_lists, &eargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	memcpy(offsets, adj_offsets, (n_verts + 1) * sizeof(edge_t));
+	free(adj_offsets);
+
+	return adj;
+}
+#endif
+
+
+/* the binary cache file starts with this header, followed by the arrays csr_row_id,
+ * csr_col_id, csc_row_id and csc_col_id in that order. each array starts at an offset
+ * that is a multiple of 8 bytes, the gaps are filled with zeros.
+ *
+ * vert_size, edge_size and adj_size are the sizes of vert_t, edge_t and adj_t when the
+ * file was written, csr_adj_len and csc_adj_len the number of adj_t elements in csr_col_id
+ * and csc_row_id, and checksum is computed over everything that follows the header.
+ */
+#define GRAPH_CACHE_MAGIC "SCCGRAPH"
+#define GRAPH_CACHE_VERSION 3
+
+struct graph_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint16_t vert_size;
+	uint16_t edge_size;
+
+	uint64_t n_verts;
+	uint64_t n_edges;
+
+	uint64_t checksum;
+
+	uint64_t csr_adj_len;
+	uint64_t csc_adj_len;
+	uint16_t adj_size;
+
+	uint8_t reserved[6];
+
+};
+_Static_assert(sizeof(struct graph_cache_header) == 64, "graph cache header must be 64 bytes");
+
+// Rounds size up to the next multiple of 8 bytes
+static inline size_t align8(size_t size) {
+	return (size + 7) & ~((size_t) 7);
+}
+
+/* Computes the offsets of the arrays inside a cache file for a graph with n_verts,
+ * whose csr_col_id and csc_row_id have csr_adj_len and csc_adj_len elements
+ *
+ * offsets[0..3] is the offset of csr_row_id, csr_col_id, csc_row_id and csc_col_id
+ * respectively, offsets[4] is the total size of the file. the sizes must already be
+ * checked to be small enough for the offsets not to overflow.
+ */
+static void graph_cache_layout(size_t n_verts, size_t csr_adj_len, size_t csc_adj_len, size_t offsets[5]) {
+	size_t sizes[4] = {
+		(n_verts + 1) * sizeof(edge_t),
+		csr_adj_len * sizeof(adj_t),
+		csc_adj_len * sizeof(adj_t),
+		(n_verts + 1) * sizeof(edge_t)
+	};
+
+	offsets[0] = sizeof(struct graph_cache_header);
+	for(int i = 0 ; i < 4 ; ++i) offsets[i + 1] = offsets[i] + align8(sizes[i]);
+}
+
+/* graph_cache_checksum is the state of the checksum of a cache file, which is computed
+ * incrementally while the arrays are written and at once over the mapping when loaded.
+ *
+ * the file is hashed as 64-bit words, word i in lane i % 4, so the multiplications of
+ * the lanes can overlap. n_words is the number of words hashed so far.
+ */
+#define GRAPH_CACHE_PRIME 0x100000001b3ULL
+
+struct graph_cache_checksum {
+	uint64_t lanes[4];
+	size_t n_words;
+
+};
+
+// Starts a new checksum
+static void graph_cache_checksum_init(struct graph_cache_checksum *cs) {
+	cs->lanes[0] = 0xcbf29ce484222325ULL;
+	cs->lanes[1] = 0x84222325cbf29ce4ULL;
+	cs->lanes[2] = 0x9e3779b97f4a7c15ULL;
+	cs->lanes[3] = 0xc2b2ae3d27d4eb4fULL;
+	cs->n_words = 0;
+}
+
+// Hashes the next word of the file in its lane
+static inline void graph_cache_checksum_word(struct graph_cache_checksum *cs, uint64_t word) {
+	uint64_t *lane = &cs->lanes[cs->n_words % 4];
+	*lane = (*lane ^ word) * GRAPH_CACHE_PRIME;
+	cs->n_words += 1;
+}
+
+/* Adds the size bytes at data to the checksum
+ *
+ * if size is not a multiple of 8 the last word is padded with zeros, as the arrays are
+ * in the file, so size must be a multiple of 8 unless data is a whole array.
+ */
+static void graph_cache_checksum_update(struct graph_cache_checksum *cs, const void *data, size_t size) {
+	const char *bytes = (const char *) data;
+	size_t n_words = size / sizeof(uint64_t);
+	uint64_t word;
+
+	// continue from the lane after the last word, then hash four words at a time
+	size_t i = 0;
+	for(; i < n_words && cs->n_words % 4 != 0 ; ++i) {
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		graph_cache_checksum_word(cs, word);
+	}
+
+	for(; i + 4 <= n_words ; i += 4) {
+		for(int l = 0 ; l < 4 ; ++l) {
+			memcpy(&word, bytes + (i + l) * sizeof(uint64_t), sizeof(uint64_t));
+			cs->lanes[l] = (cs->lanes[l] ^ word) * GRAPH_CACHE_PRIME;
+		}
+		cs->n_words += 4;
+	}
+
+	for(; i < n_words ; ++i) {
+		memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		graph_cache_checksum_word(cs, word);
+	}
+
+	size_t left = size - n_words * sizeof(uint64_t);
+	if(left > 0) {
+		word = 0;
+		memcpy(&word, bytes + n_words * sizeof(uint64_t), left);
+		graph_cache_checksum_word(cs, word);
+	}
+}
+
+// Combines the lanes into the final checksum
+static uint64_t graph_cache_checksum_final(const struct graph_cache_checksum *cs) {
+	uint64_t checksum = 0;
+	for(int l = 0 ; l < 4 ; ++l) checksum = (checksum ^ cs->lanes[l]) * GRAPH_CACHE_PRIME;
+
+	return checksum;
+}
+
+/* Writes the CSR and CSC arrays of G in a binary cache file
+ *
+ * the arrays are written directly from G followed by their padding, and the checksum is
+ * computed while they are written, so no copy of the file is made in memory. the header
+ * is written last, once the checksum is known. the file is written to cache_fname.tmp,
+ * which is then renamed to cache_fname, so a partially written cache file is never used.
+ * returns 0 on success and -1 on failure.
+ */
+int write_graph_cache(const graph *G, const char *cache_fname) {
+	// the adjacency arrays end where the list of the last vertex ends
+	size_t csr_adj_len = G->csr_row_id[G->n_verts];
+	size_t csc_adj_len = G->csc_col_id[G->n_verts];
+
+	size_t offsets[5];
+	graph_cache_layout(G->n_verts, csr_adj_len, csc_adj_len, offsets);
+
+	const void *arrays[4] = { G->csr_row_id, G->csr_col_id, G->csc_row_id, G->csc_col_id };
+	size_t sizes[4] = {
+		(G->n_verts + 1) * sizeof(edge_t),
+		csr_adj_len * sizeof(adj_t),
+		csc_adj_len * sizeof(adj_t),
+		(G->n_verts + 1) * sizeof(edge_t)
+	};
+
+	// zero filled so that the padding and the reserved bytes are deterministic
+	struct graph_cache_header header;
+	memset(&header, 0, sizeof(header));
+
+	size_t tmp_fname_len = strlen(cache_fname) + sizeof(".tmp");
+	char tmp_fname[tmp_fname_len];
+	snprintf(tmp_fname, tmp_fname_len, "%s.tmp", cache_fname);
+
+	FILE *cache_file = fopen(tmp_fname, "wb");
+	if(cache_file == NULL) {
+		fprintf(stderr, "Error opening file: %s\n%s\n", tmp_fname, strerror(errno));
+		return -1;
+	}
+
+	// the space of the header is filled with zeros until the checksum is known
+	const char padding[8] = { 0 };
+	bool written = (fwrite(&header, sizeof(header), 1, cache_file) == 1);
+
+	struct graph_cache_checksum cs;
+	graph_cache_checksum_init(&cs);
+	for(int i = 0 ; i < 4 && written ; ++i) {
+		size_t n_padding = (offsets[i + 1] - offsets[i]) - sizes[i];
+
+		written = fwrite(arrays[i], 1, sizes[i], cache_file) == sizes[i] &&
+				fwrite(padding, 1, n_padding, cache_file) == n_padding;
+		graph_cache_checksum_update(&cs, arrays[i], sizes[i]);
+	}
+
+	memcpy(header.magic, GRAPH_CACHE_MAGIC, sizeof(header.magic));
+	header.version = GRAPH_CACHE_VERSION;
+	header.vert_size = sizeof(vert_t);
+	header.edge_size = sizeof(edge_t);
+	header.adj_size = sizeof(adj_t);
+	header.n_verts = G->n_verts;
+	header.n_edges = G->n_edges;
+	header.csr_adj_len = csr_adj_len;
+	header.csc_adj_len = csc_adj_len;
+	header.checksum = graph_cache_checksum_final(&cs);
+
+	written = written && fseek(cache_file, 0, SEEK_SET) == 0 &&
+			fwrite(&header, sizeof(header), 1, cache_file) == 1;
+
+	if(fclose(cache_file) != 0 || !written) {
+		fprintf(stderr, "Error writing to file: %s\n", tmp_fname);
+
+		remove(tmp_fname);
+		return -1;
+	}
 
-		neighbour_count = j;
-		*neighbours = (vert_t *) realloc(*neighbours, neighbour_count * sizeof(vert_t));
+	if(rename(tmp_fname, cache_fname) == -1) {
+		fprintf(stderr, "Error renaming file: %s\n%s\n", tmp_fname, strerror(errno));
+
+		remove(tmp_fname);
+		return -1;
 	}
 
-	return neighbour_count;
+	return 0;
 }
 
-/* Gets the predecessors of vertex in graph G.
+/* Maps a binary cache file written by write_graph_cache and uses it as a read-only graph
  *
- * predecessor refers to the vertices u such that there exists an edge (u, v) in graph G
- * takes as input the vertex, a pointer to the graph and a pointer to the array of vertices,
- * as well as an array of vertices that will be considered as active vertices on the graph.
- * allocates and initializes the array of predecessors and returns the number of predecessors.
+ * the arrays of the graph point directly inside the mapping, so nothing is copied.
+ * the header is validated against the size of the file and the ends of the offset
+ * arrays before it is used, which only touches the pages of the header and of the ends.
+ * if verify is true the checksum of the file is checked as well, which reads the
+ * whole file once, so it is only done when asked for.
+ *
+ * the graph should still be freed using free_graph. returns NULL on failure.
  */
-ssize_t get_predecessors(vert_t vertex, const graph *G, const bool *is_vertex, vert_t **predecessors) {
-	// checks if the vertex is contained in the graph
-	if(!is_vertex[vertex]) {
-		return 0;
+graph *load_graph_cache(const char *cache_fname, bool verify) {
+	int fd = open(cache_fname, O_RDONLY);
+	if(fd == -1) {
+		fprintf(stderr, "Error opening file: %s\n%s\n", cache_fname, strerror(errno));
+		return NULL;
 	}
 
-	edge_t row_index_start = G->csc_col_id[vertex];
-	edge_t row_index_end = G->csc_col_id[vertex + 1];
-	size_t predecessor_count = row_index_end - row_index_start;
-
-	// checks if there are any predecessors
-	if(predecessor_count > 0) {
-		// allocates the required memory and handles for errors
-		*predecessors = (vert_t *) malloc(predecessor_count * sizeof(vert_t));
-		if(*predecessors == NULL) {
-			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-			return -1;
-		}
-
-		// then fills the array with the correct data
-		size_t j = 0;
-		for(size_t i = 0 ; i < predecessor_count ; ++i) {
-			vert_t vertex_to_add = G->csc_row_id[row_index_start + i];
-			if(is_vertex[vertex_to_add]) {
-				(*predecessors)[j++] = vertex_to_add;
-			}
-		}
+	struct stat cache_stat;
+	if(fstat(fd, &cache_stat) == -1) {
+		fprintf(stderr, "Error reading file: %s\n%s\n", cache_fname, strerror(errno));
 
-		predecessor_count = j;
-		*predecessors = (vert_t *) realloc(*predecessors, predecessor_count * sizeof(vert_t));
+		close(fd);
+		return NULL;
 	}
+	size_t file_size = cache_stat.st_size;
 
-	return predecessor_count;
-}
-
+	if(file_size < sizeof(struct graph_cache_header)) {
+		fprintf(stderr, "Invalid graph cache file: %s\n", cache_fname);
 
-/* Performs BFS on graph G starting from start_vertex on nodes that 
- * have search_property and saves the result in search_result
- *
- * properties must be of size n_verts and contains the property value for all the vertices.
- * the method will result in all verts that can be reached from
- * start_vertex using bfs via transfer and are homogeneous in search_property,
- * meaning it will only search the subgraph G' with the nodes that have search_property.
- *
- * saves the result in search_result returns the size of search_result
- */
-ssize_t bfs(
-		vert_t start_vertex, const graph *G, 
-		ssize_t (*transfer)(vert_t, const graph *, const bool *, vert_t **), 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex, 
-		vert_t **search_result) {
+		close(fd);
+		return NULL;
+	}
 
-	if(!is_vertex[start_vertex] || properties[start_vertex] != search_property) return 0;
+	char *data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) {
+		fprintf(stderr, "Error mapping file: %s\n%s\n", cache_fname, strerror(errno));
+		return NULL;
+	}
 
-	// initialize visited array. this will contain all vertices visited
-	bool *visited = (bool *) malloc(G->n_verts * sizeof(bool));
-	if(visited == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-		return -1;
+	// check that the file was written by the same version with the same index types
+	// and that its size matches the size of the graph it claims to contain. the sizes
+	// are bounded first, so that the layout computed from them can not overflow
+	const struct graph_cache_header *header = (const struct graph_cache_header *) data;
+
+	bool valid = memcmp(header->magic, GRAPH_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+			header->version == GRAPH_CACHE_VERSION &&
+			header->vert_size == sizeof(vert_t) && header->edge_size == sizeof(edge_t) &&
+			header->adj_size == sizeof(adj_t) &&
+			header->n_verts <= MAX_VERTS && header->n_edges <= MAX_EDGES &&
+			header->csr_adj_len <= file_size / sizeof(adj_t) &&
+			header->csc_adj_len <= file_size / sizeof(adj_t);
+
+	size_t offsets[5];
+	if(valid) {
+		graph_cache_layout(header->n_verts, header->csr_adj_len, header->csc_adj_len, offsets);
+		valid = (offsets[4] == file_size);
 	}
 
-	for(vert_t i = 0 ; i < G->n_verts ; ++i) visited[i] = false;
-	visited[start_vertex] = true;
+	// the adjacency arrays end where the list of the last vertex ends
+	if(valid) {
+		const edge_t *csr_row_id = (const edge_t *) (data + offsets[0]);
+		const edge_t *csc_col_id = (const edge_t *) (data + offsets[3]);
+		valid = csr_row_id[header->n_verts] == header->csr_adj_len &&
+				csc_col_id[header->n_verts] == header->csc_adj_len;
+	}
 
-	// the vertex queue will contain all the vertices that have to be explored
-	// it will contain at most n_active_verts. head and tail index the head and
-	// tail position of the queue
-	vert_t *vertex_queue = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
-	if(vertex_queue == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+	if(!valid) {
+		fprintf(stderr, "Invalid or incompatible graph cache file: %s\n", cache_fname);
 
-		free(visited);
-		return -1;
+		munmap(data, file_size);
+		return NULL;
 	}
-	vert_t head = 0;
-	vert_t tail = 0;
 
-	// enqueue start_vertex
-	vertex_queue[tail++] = start_vertex;
+	if(verify) {
+		struct graph_cache_checksum cs;
+		graph_cache_checksum_init(&cs);
+		graph_cache_checksum_update(&cs, data + offsets[0], offsets[4] - offsets[0]);
 
-	// while the queue is not empty
-	while(tail > head) {
-		// dequeue v
-		vert_t v = vertex_queue[head++];
-
-		// get all the vertices that are reachable from v through transfer
-		vert_t *front;
-		ssize_t front_size = (*transfer)(v, G, is_vertex, &front);
-		if(front_size == -1) {
-			free(visited);
-			free(vertex_queue);
-			return -1;
-		} else if(front_size > 0) {
-			// for each w reachable from v
-			for(size_t i = 0 ; i < front_size ; ++i) {
-				vert_t w = front[i];
-				
-				// if w not visited and w has search_property
-				if (!visited[w] && properties[w] == search_property) {
-					// mark w as visited
-					visited[w] = true;
-					
-					// enqueue w
-					vertex_queue[tail++] = w;
-				}
-			}
+		if(graph_cache_checksum_final(&cs) != header->checksum) {
+			fprintf(stderr, "Checksum mismatch in graph cache file: %s\n", cache_fname);
 
-			free(front);
+			munmap(data, file_size);
+			return NULL;
 		}
 	}
 
-	free(visited);
+	graph *G = (graph *) malloc(sizeof(graph));
+	if(G == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-	size_t n_visited = tail;
+		munmap(data, file_size);
+		return NULL;
+	}
 
-	vertex_queue = (vert_t *) realloc(vertex_queue, n_visited * sizeof(vert_t));
-	*search_result = vertex_queue;
+	G->n_verts = header->n_verts;
+	G->n_edges = header->n_edges;
 
-	return n_visited;
-}
+	G->csr_row_id = (edge_t *) (data + offsets[0]);
+	G->csr_col_id = (adj_t *) (data + offsets[1]);
+	G->csc_row_id = (adj_t *) (data + offsets[2]);
+	G->csc_col_id = (edge_t *) (data + offsets[3]);
 
-// Performs BFS on graph G with transfer=get_neighbours
-ssize_t forward_bfs(
-		vert_t start_vertex, const graph *G, 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex,
-		vert_t **search_result) {
-	return bfs(start_vertex, G, get_neighbours, search_property, properties, is_vertex, search_result);
-}
+	G->cache_map = data;
+	G->cache_map_size = file_size;
 
-// Performs BFS on graph G with transfer=get_predecessors
-ssize_t backward_bfs(
-		vert_t start_vertex, const graph *G, 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex,
-		vert_t **search_result) {
-	return bfs(start_vertex, G, get_predecessors, search_property, properties, is_vertex, search_result);
+	return G;
 }
 
 
-/* Returns true if v is a trivial SCC
+/* Reads the size line of a MatrixMarket coordinate file, after the banner
  *
- * this is the case if v has no neighbours or no predecessors
- * or if its only neighbour/predecessor is itself
+ * mm_read_mtx_crd_size reads the sizes as int, which overflows for matrices with
+ * 2^31 or more entries, so the sizes are read here as 64-bit integers instead.
+ * the comment lines before the size line are skipped.
+ * returns 0 on success or an MM error code on failure.
  */
-int is_trivial_scc(vert_t v, const graph *G, const bool *is_vertex) {
-	vert_t *N;
-	ssize_t n_N = get_neighbours(v, G, is_vertex, &N);
-
-	if(n_N == -1) return -1;
-	else if(n_N == 0) return 1;
-	else if(n_N == 1 && N[0] == v) {
-		free(N);
-		return 1;
-	}
-
-	free(N);
+static int read_mtx_size(FILE *mtx_file, size_t *n_rows, size_t *n_cols, size_t *n_nz) {
+	char line[MM_MAX_LINE_LENGTH];
 
-	vert_t *P;
-	ssize_t n_P = get_predecessors(v, G, is_vertex, &P);
+	do {
+		if(fgets(line, MM_MAX_LINE_LENGTH, mtx_file) == NULL) return MM_PREMATURE_EOF;
+	} while(line[0] == '%');
 
-	if(n_P == -1) return -1;
-	else if(n_P == 0) return 1;
-	else if(n_P == 1 && P[0] == v) {
-		free(P);
-		return 1;
-	}
+	unsigned long long rows, cols, nz;
+	if(sscanf(line, "%llu %llu %llu", &rows, &cols, &nz) != 3) return MM_PREMATURE_EOF;
 
-	free(P);
+	*n_rows = rows;
+	*n_cols = cols;
+	*n_nz = nz;
 
-	return false;
+	return 0;
 }
 
-
-/* Compare the first index given 2 pairs of integer points
- *
- * helper function to be used inside qsort.
- * takes as input a pair a,b of void* that point to pairs of numbers,
- * used for row and column indexes, and compares them based on their first element
- * effectively comparing between their row indices. if they have the same row index,
- * it compares them based on their second element (column index)
+/* Builds a graph with n_verts vertices from the n_edges COO entries in rows and cols
  *
- * returns -1 if row_a < row_b or if row_a = row_b and col_a < col_b
- * 			1 if row_a > row_b or if row_a = row_b and col_a > col_b
- * 			0 if row_a = row_b and col_a = col_b
+ * entry i is the edge rows[i] -> cols[i]. rows and cols are not modified or freed.
+ * returns NULL on failure.
  */
-static int comp_row(const void *a, const void *b) {
-	vert_t row_a = (*((vert_t **)a))[0];
-	vert_t row_b = (*((vert_t **)b))[0];
+graph *graph_from_edges(size_t n_verts, size_t n_edges, const vert_t *rows, const vert_t *cols, int num_threads) {
+
+	// initialize the graph struct and handle errors
+	graph *G = NULL;
+	if((G = initialize_graph(n_verts, n_edges)) == NULL) {
+		fprintf(stderr, "Error initializing CSC matrix:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
 
-	vert_t col_a = (*((vert_t **)a))[1];
-	vert_t col_b = (*((vert_t **)b))[1];
+#ifdef COMPRESSED_ADJ
+	// the lists are built uncompressed and encoded afterwards
+	vert_t *csr_col_id = (vert_t *) malloc(n_edges * sizeof(vert_t));
+	vert_t *csc_row_id = (vert_t *) malloc(n_edges * sizeof(vert_t));
+	if(csr_col_id == NULL || csc_row_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-	if(row_a < row_b) return -1;
-	else if(row_a > row_b) return 1;
-	else {
-		if(col_a < col_b) return -1;
-		else if(col_a > col_b) return 1;
-		else return 0;
+		free_graph(G);
+		free(csr_col_id);
+		free(csc_row_id);
+		return NULL;
+	}
+#else
+	vert_t *csr_col_id = G->csr_col_id;
+	vert_t *csc_row_id = G->csc_row_id;
+#endif
+
+	// then build the CSR and CSC formats from the COO entries
+	if(build_graph(G, csr_col_id, csc_row_id, rows, cols, num_threads) == -1) {
+		free_graph(G);
+#ifdef COMPRESSED_ADJ
+		free(csr_col_id);
+		free(csc_row_id);
+#endif
+		return NULL;
 	}
-}
 
-/* Compare the second index given 2 pairs of integer points
- *
- * helper function to be used inside qsort.
- * takes as input a pair a,b of void* that point to pairs of numbers,
- * used for row and column indexes, and compares them based on their second element
- * effectively comparing between their column indices.
- *
- * returns -1 if col_a < col_b or if col_a = col_b and row_a < row_b
- * 			1 if col_a > col_b or if col_a = col_b and row_a > row_b
- * 			0 if col_a = col_b and row_a = row_b
- */
-static int comp_col(const void *a, const void *b) {
-	vert_t row_a = (*((vert_t **)a))[0];
-	vert_t row_b = (*((vert_t **)b))[0];
+#ifdef COMPRESSED_ADJ
+	// encode the lists one at a time, so that at most one more copy is in memory
+	G->csr_col_id = encode_adjacency(n_verts, G->csr_row_id, csr_col_id, num_threads);
+	free(csr_col_id);
 
-	vert_t col_a = (*((vert_t **)a))[1];
-	vert_t col_b = (*((vert_t **)b))[1];
-	
-	if(col_a < col_b) return -1;
-	else if(col_a > col_b) return 1;
-	else {
-		if(row_a < row_b) return -1;
-		else if(row_a > row_b) return 1;
-		else return 0;
+	G->csc_row_id = (G->csr_col_id == NULL)? NULL :
+		encode_adjacency(n_verts, G->csc_col_id, csc_row_id, num_threads);
+	free(csc_row_id);
+
+	if(G->csr_col_id == NULL || G->csc_row_id == NULL) {
+		free_graph(G);
+		return NULL;
 	}
+#endif
+
+	return G;
 }
 
 /* Imports a graph's adj. matrix from a MatrixMarket .mtx file and stores it in a graph struct
  *
- * Takes as input the path to the .mtx file to be imported and a pointer to the graph struct.
+ * Takes as input the path to the .mtx file to be imported and the number of threads to use.
  *
  * It initializes the struct based on the size of the matrix and fills its
  * arrays with the correct values.
@@ -363,8 +2000,44 @@ static int comp_col(const void *a, const void *b) {
  *
  * we are concerned mostly with the shape of the graph the matrix represents so the
  * values are discarded, and only the location of the nonzero elements is saved.
+ *
+ * the header is read using mmio, then the file is memory mapped and its body is split
+ * in num_threads chunks of whole lines that are parsed in parallel.
+ *
+ * if the binary cache file mtx_fname.bin exists and is newer than the .mtx file the graph
+ * is loaded from it instead, and its checksum is checked if verify_cache is true.
+ * if write_cache is true the cache file is (re)written after the .mtx file is imported.
  */
-graph *import_graph(char *mtx_fname) {
+graph *import_graph(char *mtx_fname, int num_threads, bool write_cache, bool verify_cache) {
+
+	// the cache file is stored next to the .mtx file
+	size_t cache_fname_len = strlen(mtx_fname) + sizeof(".bin");
+	char cache_fname[cache_fname_len];
+	snprintf(cache_fname, cache_fname_len, "%s.bin", mtx_fname);
+
+	// use the cache file only if it was modified after the .mtx file
+	struct stat mtx_fstat, cache_fstat;
+	if(stat(mtx_fname, &mtx_fstat) == 0 && stat(cache_fname, &cache_fstat) == 0 && (
+				cache_fstat.st_mtim.tv_sec > mtx_fstat.st_mtim.tv_sec || (
+				cache_fstat.st_mtim.tv_sec == mtx_fstat.st_mtim.tv_sec &&
+				cache_fstat.st_mtim.tv_nsec > mtx_fstat.st_mtim.tv_nsec))) {
+
+		struct timespec t1, t2;
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		graph *G = load_graph_cache(cache_fname, verify_cache);
+
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+
+		// if the cache is invalid fall back to the .mtx file
+		if(G != NULL) {
+			double elapsedtime = (t2.tv_sec - t1.tv_sec);
+			elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+			printf("loaded from cache: %s (%0.6f sec)\n", cache_fname, elapsedtime);
+
+			return G;
+		}
+	}
 
 	// Attempt to open the file mtx_fname and checking for errors.
 	FILE *mtx_file = NULL;
@@ -408,7 +2081,7 @@ graph *import_graph(char *mtx_fname) {
 
 	// Attempt to read size information, only if matrix is of type coordinate and general
 	if(mm_is_coordinate(mtx_type) && mm_is_general(mtx_type)) {
-		mm_read_err_code = mm_read_mtx_crd_size(mtx_file, (int *) &n_rows, (int *) &n_cols, (int *) &n_nz);
+		mm_read_err_code = read_mtx_size(mtx_file, &n_rows, &n_cols, &n_nz);
 	} else {
 		char* type = mm_typecode_to_str(mtx_type);
 		fprintf(stderr, "Invalid matrix type: %s\nmatrix must be of type coordinate and general\n", type);
@@ -445,171 +2118,566 @@ graph *import_graph(char *mtx_fname) {
 		return NULL;
 	}
 
-	// indices will store the pairs of row, column indices of nonzero elements
-	// in the .mtx file, later to be stored in the appropriate structs
-	vert_t **indices;
+	// the vertices must fit in vert_t and the edges in edge_t
+	if(n_rows > MAX_VERTS) {
+		fprintf(stderr, "Error: too many vertices: %s\n%zu vertices, at most %zu are supported\n",
+				mtx_fname, n_rows, MAX_VERTS);
 
-	// there are n_nz such pairs of indices
-	indices = (vert_t **) malloc(n_nz * sizeof(vert_t *)); if(indices == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		fclose(mtx_file);
+		return NULL;
+	}
+
+	if(n_nz > MAX_EDGES) {
+		fprintf(stderr, "Error: too many edges: %s\n%zu edges, at most %zu are supported\n"
+				"rebuild with EDGE64=1 to use 64-bit edge offsets\n",
+				mtx_fname, n_nz, MAX_EDGES);
 
 		fclose(mtx_file);
 		return NULL;
 	}
 
-	for(edge_t i = 0 ; i < n_nz ; ++i) {
-		indices[i] = (vert_t *) malloc(2 * sizeof(vert_t));
+	// the values of the entries are discarded, but they must be of a supported type
+	if(!(mm_is_pattern(mtx_type) || mm_is_integer(mtx_type) || mm_is_real(mtx_type))) {
+		fprintf(stderr, "MatrixMarket file is of unsupported format: %s\n", mtx_fname);
 
-		vert_t row, col;
+		fclose(mtx_file);
+		return NULL;
+	}
 
-		int fscanf_match_needed = 0;
-		int fscanf_match_count = 0;
-		// get the indices from the file, depending on the type of Matrix in the file,
-		// discarding the value of the matrix if needed.
-		if(mm_is_pattern(mtx_type)) {
-			fscanf_match_needed = 2;
-			fscanf_match_count = fscanf(mtx_file, "%u %u\n", &row, &col);
-		} else if(mm_is_integer(mtx_type)) {
-			int val;
-			fscanf_match_needed = 3;
-			fscanf_match_count = fscanf(mtx_file, "%u %u %d\n", &row, &col, &val);
-		} else if(mm_is_real(mtx_type)) {
-			double val;
-			fscanf_match_needed = 3;
-			fscanf_match_count = fscanf(mtx_file, "%u %u %lf\n", &row, &col, &val);
-		} else {
-			fprintf(stderr, "MatrixMarket file is of unsupported format: %s\n", mtx_fname);
+	struct timespec t1, t2;
+	double elapsedtime;
 
-			for(edge_t j = 0 ; j <= i ; ++j) free(indices[j]);
-			free(indices);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
 
-			fclose(mtx_file);
-			return NULL;
-		}
+	// the body of the file, containing the entries, begins right after the size line
+	long body_offset = ftell(mtx_file);
+	struct stat mtx_stat;
+	if(body_offset == -1 || fstat(fileno(mtx_file), &mtx_stat) == -1) {
+		fprintf(stderr, "Error reading file: %s\n%s\n", mtx_fname, strerror(errno));
 
-		if(fscanf_match_count == EOF) {
-			if(ferror(mtx_file)) {
-				fprintf(stderr, "Error: reading from %s\n", mtx_fname);
-			} else {
-				fprintf(stderr, "Error: fscanf matching failure for %s\n", mtx_fname);
-			}
-			
-			for(edge_t j = 0 ; j <= i ; ++j) free(indices[j]);
-			free(indices);
+		fclose(mtx_file);
+		return NULL;
+	}
+	size_t file_size = mtx_stat.st_size;
 
-			fclose(mtx_file);
-			return NULL;
-		} else if(fscanf_match_count < fscanf_match_needed) {
-			fprintf(stderr, "Error reading from %s:\nfscanf early matching failure\n", mtx_fname);
+	// map the whole file in memory, it will only be read sequentially
+	char *mtx_data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fileno(mtx_file), 0);
+	if(mtx_data == MAP_FAILED) {
+		fprintf(stderr, "Error mapping file: %s\n%s\n", mtx_fname, strerror(errno));
 
-			for(edge_t j = 0 ; j <= i ; ++j) free(indices[j]);
-			free(indices);
+		fclose(mtx_file);
+		return NULL;
+	}
+	madvise(mtx_data, file_size, MADV_SEQUENTIAL);
 
-			fclose(mtx_file);
-			return NULL;
-		}
+	// the mapping stays valid after the file is closed
+	fclose(mtx_file);
 
-		if(row > n_rows || col > n_cols) {
-			fprintf(stderr, "Invalid index in .mtx file %s\n", mtx_fname);
+	const char *body = mtx_data + body_offset;
+	size_t body_size = file_size - body_offset;
 
-			for(edge_t j = 0 ; j <= i ; ++j) free(indices[j]);
-			free(indices);
+	pthread_t threads[num_threads];
+	struct parse_chunk_args pcargs[num_threads];
 
-			fclose(mtx_file);
-			return NULL;
+	// split the body in chunks of approximately equal size, each ending at the end of a line
+	size_t p_chunk_size = body_size / num_threads;
+	const char *chunk_start = body;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		const char *chunk_end = body + body_size;
+		if(i < num_threads - 1) {
+			chunk_end = body + (i + 1) * p_chunk_size;
+			if(chunk_end < chunk_start) chunk_end = chunk_start;
+
+			if(chunk_end > body && chunk_end[-1] != '\n') {
+				const char *eol = memchr(chunk_end, '\n', body + body_size - chunk_end);
+				chunk_end = (eol == NULL)? body + body_size : eol + 1;
+			}
 		}
 
-		indices[i][0] = row - 1;
-		indices[i][1] = col - 1;
+		pcargs[i].start = chunk_start;
+		pcargs[i].end = chunk_end;
+		pcargs[i].n_verts = n_rows;
+		pcargs[i].has_value = !mm_is_pattern(mtx_type);
+		pcargs[i].real_value = mm_is_real(mtx_type);
+
+		chunk_start = chunk_end;
 	}
-	// since we have read all the data from the .mtx file we can close it.
-	fclose(mtx_file);
 
+	// count the lines of each chunk in parallel
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pthread_create(&threads[i], NULL, p_count_lines, &pcargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	size_t n_lines = 0;
+	for(int i = 0 ; i < num_threads ; ++i) n_lines += pcargs[i].n_lines;
+
+	// rows and cols are effectively a COO representation of the matrix.
+	// there is at most one entry per line.
+	vert_t *rows = (vert_t *) malloc((n_lines + 1) * sizeof(vert_t));
+	vert_t *cols = (vert_t *) malloc((n_lines + 1) * sizeof(vert_t));
+	if(rows == NULL || cols == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(rows);
+		free(cols);
+		munmap(mtx_data, file_size);
+		return NULL;
+	}
+
+	// then parse the chunks in parallel, each chunk writes its entries after the
+	// lines of all the previous chunks
+	size_t line_offset = 0;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pcargs[i].rows = rows + line_offset;
+		pcargs[i].cols = cols + line_offset;
+		line_offset += pcargs[i].n_lines;
+
+		pthread_create(&threads[i], NULL, p_parse_chunk, &pcargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	// the lines of the header, which the line of an invalid entry is counted after
+	size_t header_lines = 0;
+	for(const char *c = mtx_data ; c < body ; ++c) header_lines += (*c == '\n');
+
+	// the whole file has been read so it can be unmapped
+	munmap(mtx_data, file_size);
+
+	// move the entries of each chunk next to the previous ones, since
+	// blank lines leave gaps, and check for errors. the first invalid line
+	// is counted from the start of the file, after the lines of the header
+	bool invalid = false;
+	size_t invalid_line = header_lines + 1;
+
+	size_t n_entries = 0;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		if(!invalid && pcargs[i].invalid) invalid_line += pcargs[i].invalid_line;
+		else if(!invalid) invalid_line += pcargs[i].n_lines;
+		invalid = invalid || pcargs[i].invalid;
+
+		memmove(rows + n_entries, pcargs[i].rows, pcargs[i].n_entries * sizeof(vert_t));
+		memmove(cols + n_entries, pcargs[i].cols, pcargs[i].n_entries * sizeof(vert_t));
+		n_entries += pcargs[i].n_entries;
+	}
+
+	if(invalid) {
+		fprintf(stderr, "Invalid entry in .mtx file %s\nline %zu\n", mtx_fname, invalid_line);
+
+		free(rows);
+		free(cols);
+		return NULL;
+	} else if(n_entries < n_nz) {
+		fprintf(stderr, "Error reading from %s:\nEOF encountered after %zu of %zu entries\n", 
+				mtx_fname, n_entries, n_nz);
+
+		free(rows);
+		free(cols);
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	elapsedtime = (t2.tv_sec - t1.tv_sec);
+	elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+	printf("parse time: %0.6f sec (%0.2f MB/s)\n", elapsedtime, body_size / elapsedtime / 1e6);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
 
 	// the number of vertices equals the rows of the matrix
 	// the number of edges is the number of non zero elements
-	size_t n_verts = n_rows;
-	size_t n_edges = n_nz;
+	graph *G = graph_from_edges(n_rows, n_nz, rows, cols, num_threads);
 
-	// initialize the graph struct and handle errors
-	graph *G = NULL;
-	if((G = initialize_graph(n_verts, n_edges)) == NULL) {
-		fprintf(stderr, "Error initializing CSC matrix: %s\n%s\n", mtx_fname, strerror(ENOMEM));
+	// finally free the COO entries, since they are no longer needed.
+	free(rows);
+	free(cols);
 
-		for(edge_t j = 0 ; j < n_nz ; ++j) free(indices[j]);
-		free(indices);
+	if(G == NULL) return NULL;
 
-		return NULL;
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	elapsedtime = (t2.tv_sec - t1.tv_sec);
+	elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+	printf("build time: %0.6f sec\n", elapsedtime);
+
+	// failing to write the cache is not fatal, the graph will be imported again next time
+	if(write_cache) {
+		if(write_graph_cache(G, cache_fname) == 0) printf("wrote cache: %s\n", cache_fname);
 	}
 
+	return G;
+}
 
-	/* the indices array is effectively a COO representation of the matrix.
-	 *
-	 * the code for converting from COO to CSC/CSR was adapted from the link below:
-	 * https://stackoverflow.com/questions/23583975/convert-coo-to-csr-format-in-c
-	 */
 
-	// sort the indices based on the column index in order to create the CSC format
-	qsort(indices, n_nz, sizeof(vert_t *), comp_col);
+// Returns the total degree of v, counting both its neighbours and its predecessors
+static inline edge_t total_degree(vert_t v, const graph *G) {
+	return neighbours_span(v, G).len + predecessors_span(v, G).len;
+}
 
-	// csc_col_id[col + 1] will initialy hold the number of nz elements in col, 
-	// then we perform a cumulative sum which will be in the form we need.
-	
-	// initialize csc_col_id to 0. 
-	for(vert_t i = 0 ; i <= n_verts ; ++i) {
-		G->csc_col_id[i] = 0;
+/* Sorts the vertices of G by total degree using a counting sort
+ *
+ * the sort is stable, so vertices of equal degree stay in increasing order.
+ * sorted[i] is set to the vertex at position i. returns 0 on success and -1 on failure.
+ */
+static int degree_sort(const graph *G, bool decreasing, vert_t *sorted) {
+	edge_t max_degree = 0;
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		edge_t degree = total_degree(v, G);
+		if(degree > max_degree) max_degree = degree;
 	}
 
-	// then we loop over the COO array
-	for(edge_t i = 0 ; i < n_edges ; ++i) {
-		vert_t row = indices[i][0];
-		vert_t col = indices[i][1];
+	size_t *count = (size_t *) calloc((size_t) max_degree + 2, sizeof(size_t));
+	if(count == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return -1;
+	}
 
-		// store the row in row_id as is
-		G->csc_row_id[i] = row;
+	// count[k + 1] is the number of vertices with key k, where the key is the
+	// degree, or the distance from max_degree when sorting in decreasing order
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		edge_t degree = total_degree(v, G);
+		count[(decreasing? max_degree - degree : degree) + 1]++;
+	}
+	for(size_t k = 1 ; k <= max_degree ; ++k) count[k] += count[k - 1];
 
-		// increase col_id for index: col+1 since 1 more nz element is present in col
-		G->csc_col_id[col + 1] += 1;
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		edge_t degree = total_degree(v, G);
+		sorted[count[decreasing? max_degree - degree : degree]++] = v;
 	}
 
-	// then perform the cumulative sum
-	for(vert_t i = 0 ; i < n_verts ; ++i) {
-		G->csc_col_id[i + 1] += G->csc_col_id[i];
+	free(count);
+
+	return 0;
+}
+
+// Compares the sort keys of two vertices
+static int comp_key(const void *a, const void *b) {
+	uint64_t key_a = *((const uint64_t *) a);
+	uint64_t key_b = *((const uint64_t *) b);
+
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Visits every vertex of G with a BFS on the undirected graph, ignoring edge directions
+ *
+ * a new search is started from each unvisited vertex of starts, in order, or of all the
+ * vertices in increasing order if starts is NULL. when by_degree is true the vertices
+ * discovered from the same vertex are visited by increasing total degree, as in the
+ * Cuthill-McKee ordering. order[i] is set to the i-th vertex visited.
+ * returns 0 on success and -1 on failure.
+ */
+static int undirected_bfs_order(const graph *G, const vert_t *starts, bool by_degree, vert_t *order) {
+	// the unvisited vertices are the active vertices of the set
+	vertex_set *unvisited = new_vertex_set(G->n_verts);
+	uint64_t *keys = by_degree? (uint64_t *) malloc(G->n_verts * sizeof(uint64_t)) : NULL;
+	if(unvisited == NULL || (by_degree && keys == NULL)) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		if(unvisited != NULL) free_vertex_set(unvisited);
+		free(keys);
+		return -1;
 	}
 
+	// order is also used as the BFS queue, the vertices in order[head..tail) are
+	// the ones discovered but not yet visited
+	size_t head = 0, tail = 0;
+	for(size_t i = 0 ; i < G->n_verts ; ++i) {
+		vert_t start = (starts != NULL)? starts[i] : i;
+		if(!is_active_vertex(start, unvisited)) continue;
+
+		remove_vertex(start, unvisited);
+		order[tail++] = start;
+
+		while(head < tail) {
+			vert_t v = order[head++];
+			size_t first = tail;
+
+			adj_span spans[2] = { neighbours_span(v, G), predecessors_span(v, G) };
+			for(int s = 0 ; s < 2 ; ++s) {
+				adj_iter it = adj_begin(spans[s]);
+				for(size_t j = 0 ; j < spans[s].len ; ++j) {
+					vert_t u = adj_next(&it);
+					if(!is_active_vertex(u, unvisited)) continue;
+
+					remove_vertex(u, unvisited);
+					order[tail++] = u;
+				}
+			}
 
-	// then sort the indices based on row index, for the CSR format
-	qsort(indices, n_nz, sizeof(vert_t *), comp_row);
+			if(!by_degree || tail - first < 2) continue;
 
-	// then initialize the CSR struct in the same way as above, 
-	// with col_id and row_id switched.
-	
-	// initialize csc_row_id to 0.
-	for(vert_t i = 0 ; i <= n_verts ; ++i) {
-		G->csr_row_id[i] = 0;
+			// sort the discovered vertices by degree, the key holds the degree in the
+			// high bits and the vertex in the low bits so ties keep increasing order
+			for(size_t j = first ; j < tail ; ++j) {
+				uint64_t degree = total_degree(order[j], G);
+				if(degree > UINT32_MAX) degree = UINT32_MAX;
+				keys[j - first] = (degree << 32) | order[j];
+			}
+			qsort(keys, tail - first, sizeof(uint64_t), comp_key);
+			for(size_t j = first ; j < tail ; ++j) order[j] = (vert_t) keys[j - first];
+		}
 	}
 
-	// then we loop over the COO array
-	for(edge_t i = 0 ; i < n_edges ; ++i) {
-		vert_t row = indices[i][0];
-		vert_t col = indices[i][1];
+	free_vertex_set(unvisited);
+	free(keys);
+
+	return 0;
+}
+
+/* Computes a new label for every vertex of G, so that adjacent vertices get close labels
+ *
+ * ORDER_DEGREE sorts the vertices by decreasing total degree, so the hubs that most edges
+ * point to share cache lines. ORDER_BFS labels the vertices in the order a BFS on the
+ * undirected graph visits them. ORDER_RCM is the reverse Cuthill-McKee ordering: each BFS
+ * starts from an unvisited vertex of minimum degree and visits the vertices it discovers
+ * by increasing degree, and the final order is reversed.
+ * returns new_id, where new_id[v] is the new label of vertex v, or NULL on failure.
+ */
+vert_t *vertex_ordering(const graph *G, vertex_order order) {
+	vert_t *new_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *sorted = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(new_id == NULL || sorted == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(new_id);
+		free(sorted);
+		return NULL;
+	}
 
-		// store the col in col_id as is
-		G->csr_col_id[i] = col;
+	int status = 0;
+	switch(order) {
+	case ORDER_DEGREE:
+		status = degree_sort(G, true, sorted);
+		break;
+	case ORDER_BFS:
+		status = undirected_bfs_order(G, NULL, false, sorted);
+		break;
+	case ORDER_RCM:
+		// new_id holds the vertices by increasing degree, used as the starting vertices
+		status = degree_sort(G, false, new_id);
+		if(status == 0) status = undirected_bfs_order(G, new_id, true, sorted);
+		break;
+	}
 
-		// increase row_id for index: row+1 since 1 more nz element is present in row
-		G->csr_row_id[row + 1] += 1;
+	if(status == -1) {
+		free(new_id);
+		free(sorted);
+		return NULL;
 	}
 
-	// then perform the cumulative sum
-	for(vert_t i = 0 ; i < n_verts ; ++i) {
-		G->csr_row_id[i + 1] += G->csr_row_id[i];
+	for(vert_t i = 0 ; i < G->n_verts ; ++i) {
+		vert_t v = sorted[i];
+		new_id[v] = (order == ORDER_RCM)? G->n_verts - 1 - i : i;
 	}
 
-	// finally free the memory in the indices array, since it is no longer needed.
-	for(edge_t j = 0 ; j < n_nz ; ++j) free(indices[j]);
-	free(indices);
+	free(sorted);
 
-	return G;
+	return new_id;
+}
+
+/* Writes the vertices of the list adj in list, relabeled with new_id and sorted
+ *
+ * returns the number of vertices written.
+ */
+static size_t permuted_list(adj_span adj, const vert_t *new_id, vert_t *list) {
+	adj_iter adj_it = adj_begin(adj);
+	for(size_t i = 0 ; i < adj.len ; ++i) list[i] = new_id[adj_next(&adj_it)];
+
+	sort_verts(list, adj.len);
+
+	return adj.len;
 }
 
+/* This function is meant to be executed inside a thread.
+ *
+ * it computes the size of the relabeled lists of the vertices of H between start and end.
+ * the sizes of the lists of v are stored in csr_row_id[v + 1] and csc_col_id[v + 1].
+ */
+struct permute_args {
+	size_t start;
+	size_t end;
+
+	const graph *G;
+	const vert_t *new_id;
+	const vert_t *old_id;
+
+	graph *H;
+	vert_t *list;
+
+}; static void *p_permute_sizes(void *args) {
+	struct permute_args *pargs = (struct permute_args *) args;
+	const graph *G = pargs->G;
+	graph *H = pargs->H;
+
+	for(size_t v = pargs->start ; v < pargs->end ; ++v) {
+		vert_t old = pargs->old_id[v];
+
+		size_t len = permuted_list(neighbours_span(old, G), pargs->new_id, pargs->list);
+		H->csr_row_id[v + 1] = adj_list_size(v, pargs->list, len);
+
+		len = permuted_list(predecessors_span(old, G), pargs->new_id, pargs->list);
+		H->csc_col_id[v + 1] = adj_list_size(v, pargs->list, len);
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it writes the relabeled lists of the vertices of H between start and end.
+ */
+static void *p_permute_lists(void *args) {
+	struct permute_args *pargs = (struct permute_args *) args;
+	const graph *G = pargs->G;
+	graph *H = pargs->H;
+
+	for(size_t v = pargs->start ; v < pargs->end ; ++v) {
+		vert_t old = pargs->old_id[v];
+
+		size_t len = permuted_list(neighbours_span(old, G), pargs->new_id, pargs->list);
+		write_adj_list(H->csr_col_id + H->csr_row_id[v], v, pargs->list, len);
+
+		len = permuted_list(predecessors_span(old, G), pargs->new_id, pargs->list);
+		write_adj_list(H->csc_row_id + H->csc_col_id[v], v, pargs->list, len);
+	}
+
+	return NULL;
+}
+
+/* Builds a copy of G where every vertex v is relabeled to new_id[v]
+ *
+ * new_id must be a permutation of the vertices. the adjacency lists of the copy are
+ * sorted again, since the relabeling changes the order of the vertices in them.
+ * returns the permuted graph or NULL on failure.
+ */
+graph *permute_graph(const graph *G, const vert_t *new_id, int num_threads) {
+	// old_id is the inverse permutation, the vertex of G that is vertex v of the copy
+	vert_t *old_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(old_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) old_id[new_id[v]] = v;
+
+	// every thread gathers the lists in its own part of lists, which has to fit the longest list
+	size_t max_len = 0;
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		size_t out_len = neighbours_span(v, G).len;
+		size_t in_len = predecessors_span(v, G).len;
+		if(out_len > max_len) max_len = out_len;
+		if(in_len > max_len) max_len = in_len;
+	}
+
+	vert_t *lists = (vert_t *) malloc(num_threads * (max_len + 1) * sizeof(vert_t));
+	graph *H = initialize_graph(G->n_verts, G->n_edges);
+	if(lists == NULL || H == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		if(H != NULL) free_graph(H);
+		free(lists);
+		free(old_id);
+		return NULL;
+	}
+
+	pthread_t threads[num_threads];
+	struct permute_args pargs[num_threads];
+
+	size_t p_vert_block_size = G->n_verts / num_threads;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pargs[i].start = i * p_vert_block_size;
+		pargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_vert_block_size;
+		pargs[i].G = G;
+		pargs[i].new_id = new_id;
+		pargs[i].old_id = old_id;
+		pargs[i].H = H;
+		pargs[i].list = lists + i * (max_len + 1);
+
+		pthread_create(&threads[i], NULL, p_permute_sizes, &pargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	// the compressed lists may grow, since the gaps between the relabeled vertices change
+	if(sum_adj_offsets(H->csr_row_id, H->n_verts) == -1 || sum_adj_offsets(H->csc_col_id, H->n_verts) == -1) {
+		free_graph(H);
+		free(lists);
+		free(old_id);
+		return NULL;
+	}
+
+#ifdef COMPRESSED_ADJ
+	H->csr_col_id = (adj_t *) malloc(H->csr_row_id[H->n_verts] * sizeof(adj_t));
+	H->csc_row_id = (adj_t *) malloc(H->csc_col_id[H->n_verts] * sizeof(adj_t));
+	if(H->csr_col_id == NULL || H->csc_row_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_graph(H);
+		free(lists);
+		free(old_id);
+		return NULL;
+	}
+#endif
+
+	for(int i = 0 ; i < num_threads ; ++i) {
+		pthread_create(&threads[i], NULL, p_permute_lists, &pargs[i]);
+	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+
+	free(lists);
+	free(old_id);
+
+	return H;
+}
+
+/* Returns the average number of bits of the gap |u - v| over the edges (u, v) of G
+ *
+ * this measures the locality of the labels: the lower it is, the closer the vertices
+ * of an edge are in memory. it is also about the size of a gap in the compressed lists.
+ */
+double edge_gap_bits(const graph *G) {
+	if(G->n_edges == 0) return 0.0;
+
+	uint64_t total_bits = 0;
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		adj_span neighbours = neighbours_span(v, G);
+		adj_iter neighbours_it = adj_begin(neighbours);
+		for(size_t i = 0 ; i < neighbours.len ; ++i) {
+			vert_t u = adj_next(&neighbours_it);
+			uint64_t gap = (u > v)? u - v : v - u;
+			if(gap != 0) total_bits += 64 - __builtin_clzll(gap);
+		}
+	}
+
+	return (double) total_bits / G->n_edges;
+}
+
+/* Relabels the scc ids found on a graph permuted with new_id back to the vertices of the original
+ *
+ * scc_id[v'] is the scc id of vertex v' of the permuted graph. it is replaced by an array
+ * where the scc id of vertex v of the original graph is the smallest vertex of its SCC,
+ * the same scc id the algorithms give when they run on the original graph.
+ * returns 0 on success and -1 on failure.
+ */
+int unpermute_scc_id(size_t n_verts, const vert_t *new_id, vert_t **scc_id) {
+	vert_t *orig_scc_id = (vert_t *) malloc(n_verts * sizeof(vert_t));
+	// the smallest original vertex of each SCC, indexed by its permuted scc id
+	vert_t *min_vertex = (vert_t *) malloc(n_verts * sizeof(vert_t));
+	if(orig_scc_id == NULL || min_vertex == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(orig_scc_id);
+		free(min_vertex);
+		return -1;
+	}
+
+	// the vertices are visited in increasing order, so the first one seen
+	// in each SCC is the smallest
+	memset(min_vertex, 0xff, n_verts * sizeof(vert_t));
+	for(vert_t v = 0 ; v < n_verts ; ++v) {
+		vert_t id = (*scc_id)[new_id[v]];
+		if(min_vertex[id] == (vert_t) -1) min_vertex[id] = v;
+
+		orig_scc_id[v] = min_vertex[id];
+	}
+
+	free(min_vertex);
+	free(*scc_id);
+	*scc_id = orig_scc_id;
+
+	return 0;
+}
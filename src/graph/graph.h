@@ -25,8 +25,27 @@
 #include <stdbool.h>
 
 // these types will be used for indexing vertices and edges respectively.
+// edge_t is 64 bits wide when EDGE64 is defined, for graphs with 2^32 or more edges,
+// while the vertices always take 32 bits.
 typedef uint32_t vert_t;
+#ifdef EDGE64
+typedef uint64_t edge_t;
+#else
 typedef uint32_t edge_t;
+#endif
+
+// the elements of the adjacency arrays. when COMPRESSED_ADJ is defined the adjacency
+// lists are stored compressed as a stream of bytes, otherwise they are arrays of vertices.
+#ifdef COMPRESSED_ADJ
+typedef uint8_t adj_t;
+#else
+typedef vert_t adj_t;
+#endif
+
+// the largest number of vertices and edges a graph can have. the vertex id (vert_t) -1
+// is never used, so that it can mark a missing vertex
+#define MAX_VERTS ((size_t) UINT32_MAX - 1)
+#define MAX_EDGES ((size_t) (edge_t) -1)
 
 /* graph is a struct used to represent graphs, by storing their adjacency matrices as
  * sparse pattern matrices, in the CSR and CSC formats.
@@ -39,17 +58,28 @@ typedef uint32_t edge_t;
  * since this is a pattern matrix, we dont store the value of nonzero elements,
  * but only their position in the matrix. this means that the graph
  * will only encode directionality, not edge weights.
+ *
+ * with COMPRESSED_ADJ, csr_col_id and csc_row_id are byte streams and csr_row_id and
+ * csc_col_id hold the position in bytes where each list begins. a list starts with the
+ * number of vertices in it, followed by the difference of each vertex from the previous
+ * one (from the vertex that owns the list for the first), as zigzag encoded varints.
+ * the lists are sorted so most differences take a single byte.
  */
 typedef struct graph{
 	size_t n_verts;
  	size_t n_edges;
 
 	edge_t *csr_row_id;
-	vert_t *csr_col_id;
+	adj_t *csr_col_id;
 
-	vert_t *csc_row_id;
+	adj_t *csc_row_id;
 	edge_t *csc_col_id;
 
+	// when the graph is loaded from a binary cache file the arrays above point
+	// inside this read-only memory mapping instead of being allocated.
+	void *cache_map;
+	size_t cache_map_size;
+
 } graph;
 
 /* initialization and free functions */
@@ -61,47 +91,426 @@ graph *initialize_graph(size_t n_verts, size_t n_edges);
 void free_graph(graph *G);
 
 
+/* active vertex set */
+
+/* vertex_set holds the vertices that are still part of the graph as a bitset.
+ *
+ * vertex v is active when bit v % 64 of words[v / 64] is set. this takes one bit
+ * per vertex instead of one byte, and the removed vertices can be skipped a word
+ * at a time using next_active_vertex. the bits after n_verts are always zero.
+ */
+typedef struct vertex_set {
+	size_t n_verts;
+	size_t n_words;
+
+	uint64_t *words;
+
+} vertex_set;
+
+// the active vertices are compacted in a list when less than 1/VERTEX_SET_SPARSE of them are left
+#ifndef VERTEX_SET_SPARSE
+#define VERTEX_SET_SPARSE 8
+#endif
+
+// Creates a vertex set with all the n_verts vertices active
+vertex_set *new_vertex_set(size_t n_verts);
+
+// Frees the memory allocated to a vertex set
+void free_vertex_set(vertex_set *set);
+
+// Stores the active vertices of set in list in increasing order and returns their number
+size_t compact_vertex_set(const vertex_set *set, vert_t *list);
+
+// Returns true if vertex is still part of the graph
+static inline bool is_active_vertex(vert_t vertex, const vertex_set *set) {
+	return (set->words[vertex >> 6] >> (vertex & 63)) & 1;
+}
+
+// Returns true if vertex is still part of the graph while other threads may remove vertices of the same word
+static inline bool is_active_vertex_atomic(vert_t vertex, const vertex_set *set) {
+	return (__atomic_load_n(&set->words[vertex >> 6], __ATOMIC_RELAXED) >> (vertex & 63)) & 1;
+}
+
+// Removes vertex from the graph
+static inline void remove_vertex(vert_t vertex, vertex_set *set) {
+	set->words[vertex >> 6] &= ~((uint64_t) 1 << (vertex & 63));
+}
+
+// Removes vertex from the graph while other threads may remove vertices of the same word.
+// returns true if this call removed it, false if it was already removed
+static inline bool atomic_remove_vertex(vert_t vertex, vertex_set *set) {
+	uint64_t mask = (uint64_t) 1 << (vertex & 63);
+	return __atomic_fetch_and(&set->words[vertex >> 6], ~mask, __ATOMIC_RELAXED) & mask;
+}
+
+// Returns the first active vertex between vertex and end - 1, or end if there is none
+static inline vert_t next_active_vertex(vert_t vertex, vert_t end, const vertex_set *set) {
+	if(vertex >= end) return end;
+
+	// ignore the bits of the vertices before vertex in its word
+	size_t word = vertex >> 6;
+	uint64_t bits = set->words[word] & (~(uint64_t) 0 << (vertex & 63));
+
+	// then skip the words without active vertices
+	size_t last_word = (end - 1) >> 6;
+	while(bits == 0) {
+		if(++word > last_word) return end;
+		bits = set->words[word];
+	}
+
+	vert_t next = (word << 6) + __builtin_ctzll(bits);
+	return (next < end)? next : end;
+}
+
+// Returns the first active vertex like next_active_vertex, while other threads may remove vertices of the same word
+static inline vert_t next_active_vertex_atomic(vert_t vertex, vert_t end, const vertex_set *set) {
+	if(vertex >= end) return end;
+
+	size_t word = vertex >> 6;
+	uint64_t bits = __atomic_load_n(&set->words[word], __ATOMIC_RELAXED) & (~(uint64_t) 0 << (vertex & 63));
+
+	size_t last_word = (end - 1) >> 6;
+	while(bits == 0) {
+		if(++word > last_word) return end;
+		bits = __atomic_load_n(&set->words[word], __ATOMIC_RELAXED);
+	}
+
+	vert_t next = (word << 6) + __builtin_ctzll(bits);
+	return (next < end)? next : end;
+}
+
+
 /* transfer functions */
 
-// Gets the neighbours of vertex in graph G.
-ssize_t get_neighbours(vert_t vertex, const graph *G, const bool *is_vertex, vert_t **neighbours);
+/* adj_span is a read-only view of the adjacency list of a vertex.
+ *
+ * data points directly inside csr_col_id (for neighbours) or csc_row_id
+ * (for predecessors) so no memory is allocated. the span contains every
+ * vertex adjacent to the given vertex, including removed ones, so the caller
+ * should filter them using is_active_vertex.
+ *
+ * the len vertices of the span are read in order using an adj_iter, which
+ * decodes the compressed lists on the fly:
+ *
+ *	adj_iter it = adj_begin(span);
+ *	for(size_t i = 0 ; i < span.len ; ++i) {
+ *		vert_t w = adj_next(&it);
+ *		...
+ */
+typedef struct adj_span {
+	const adj_t *data;
+	size_t len;
+
+	vert_t vertex;
+
+} adj_span;
+
+// adj_iter is the position of a reader inside an adj_span, with left vertices still to read
+typedef struct adj_iter {
+	const adj_t *pos;
+	size_t left;
+
+	vert_t prev;
+
+} adj_iter;
+
+#ifdef COMPRESSED_ADJ
+// Reads the unsigned LEB128 varint at *pos and moves *pos after it
+static inline uint64_t read_varint(const uint8_t **pos) {
+	// most values fit in one byte, so that case is checked first
+	uint8_t byte = *(*pos)++;
+	if(!(byte & 0x80)) return byte;
+
+	uint64_t value = byte & 0x7f;
+	int shift = 7;
+
+	do {
+		byte = *(*pos)++;
+		value |= (uint64_t) (byte & 0x7f) << shift;
+		shift += 7;
+	} while(byte & 0x80);
+
+	return value;
+}
+#endif
+
+// Returns the span of the list of vertex between positions start and end of adj
+static inline adj_span adj_list_span(vert_t vertex, const adj_t *adj, edge_t start, edge_t end) {
+#ifdef COMPRESSED_ADJ
+	// the list starts with its length
+	const uint8_t *data = adj + start;
+	size_t len = read_varint(&data);
+
+	return (adj_span) { .data = data, .len = len, .vertex = vertex };
+#else
+	return (adj_span) { .data = adj + start, .len = end - start, .vertex = vertex };
+#endif
+}
+
+// Returns the span of the neighbours of vertex in graph G.
+static inline adj_span neighbours_span(vert_t vertex, const graph *G) {
+	// in the CSR format the vertices u that a given vertex v point to are given
+	// in the col_id array at indices row_id[v]..row_id[v+1]
+	return adj_list_span(vertex, G->csr_col_id, G->csr_row_id[vertex], G->csr_row_id[vertex + 1]);
+}
+
+// Returns the span of the predecessors of vertex in graph G.
+static inline adj_span predecessors_span(vert_t vertex, const graph *G) {
+	// in the CSC format the vertices u that point to a given vertex v are given
+	// in the row_id array at indices col_id[v]..col_id[v+1]
+	return adj_list_span(vertex, G->csc_row_id, G->csc_col_id[vertex], G->csc_col_id[vertex + 1]);
+}
+
+// Returns an iterator at the first vertex of the span
+static inline adj_iter adj_begin(adj_span adj) {
+	return (adj_iter) { .pos = adj.data, .left = adj.len, .prev = adj.vertex };
+}
+
+// Returns the next vertex of the span, the iterator must have vertices left
+static inline vert_t adj_next(adj_iter *it) {
+	it->left -= 1;
+
+#ifdef COMPRESSED_ADJ
+	// undo the zigzag encoding of the difference from the previous vertex
+	uint32_t delta = (uint32_t) read_varint(&it->pos);
+	it->prev += (delta >> 1) ^ -(delta & 1);
+
+	return it->prev;
+#else
+	return *it->pos++;
+#endif
+}
+
+
+// Returns the number of active vertices in the span, not counting vertex itself
+static inline vert_t active_degree(vert_t vertex, adj_span adj, const vertex_set *is_vertex) {
+	vert_t degree = 0;
+
+	adj_iter it = adj_begin(adj);
+	for(size_t i = 0 ; i < adj.len ; ++i) {
+		vert_t u = adj_next(&it);
+		degree += (u != vertex && is_active_vertex(u, is_vertex));
+	}
+
+	return degree;
+}
 
-// Gets the predecessors of vertex in graph G.
-ssize_t get_predecessors(vert_t vertex, const graph *G, const bool *is_vertex, vert_t **predecesors);
+
+/* color functions */
+
+// spans with at least this many vertices are reduced by a vectorized kernel, if the cpu has one
+#ifndef SIMD_MIN_DEGREE
+#define SIMD_MIN_DEGREE 16
+#endif
+
+// the vectorized kernels read the lists directly, so they are only built for uncompressed lists
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(COMPRESSED_ADJ) && !defined(NO_SIMD)
+#define SIMD_KERNELS
+#endif
+
+#ifdef SIMD_KERNELS
+// the kernel chosen for the cpu at startup, or NULL if it has none of the vector extensions used
+extern vert_t (*min_active_color_kernel)(
+		const vert_t *verts, size_t len, const vertex_set *is_vertex, const vert_t *colors, vert_t color);
+#endif
+
+/* Returns the minimum of color and the colors of the active vertices of the span
+ *
+ * this is the gather-and-min of the coloring sweeps. long spans are reduced by the
+ * vectorized kernel, which gathers the active bits and then the colors of the active
+ * vertices only. the gathers take signed 32-bit indices, which limits the vertices.
+ * the colors are read with relaxed atomic loads, since the parallel sweeps lower the
+ * colors of other vertices at the same time. each lane of a gather is one such load.
+ */
+static inline vert_t min_active_color(adj_span adj, const vertex_set *is_vertex, const vert_t *colors, vert_t color) {
+#ifdef SIMD_KERNELS
+	if(adj.len >= SIMD_MIN_DEGREE && min_active_color_kernel != NULL && is_vertex->n_verts <= INT32_MAX) {
+		return min_active_color_kernel(adj.data, adj.len, is_vertex, colors, color);
+	}
+#endif
+
+	adj_iter it = adj_begin(adj);
+	for(size_t i = 0 ; i < adj.len ; ++i) {
+		vert_t u = adj_next(&it);
+		if(!is_active_vertex(u, is_vertex)) continue;
+
+		vert_t c = __atomic_load_n(&colors[u], __ATOMIC_RELAXED);
+		if(color > c) color = c;
+	}
+
+	return color;
+}
 
 
 /* BFS functions */
 
+/* bfs_workspace holds the memory of a BFS, so that it can be reused by many searches.
+ *
+ * vertex v is visited by the current search when visited[v] == epoch. every search starts
+ * a new epoch, so the cost of a search is proportional to the part of the graph it explores
+ * instead of n_verts. the epochs are 16 bits to keep the workspace small, visited is cleared
+ * once every 65535 searches when they wrap around. queue holds the vertices found by the
+ * search and frontier is the bitmap of the bottom-up steps, allocated by the first one and
+ * all zeros between searches.
+ * n_edges counts the edges scanned by all the searches.
+ * shared is set by the parallel callers, whose other threads remove vertices of is_vertex
+ * during the searches, so that the bitset is read atomically.
+ * a workspace must only be used by one thread at a time.
+ */
+typedef struct bfs_workspace {
+	size_t n_verts;
+	size_t n_edges;
+
+	bool shared;
+
+	uint16_t epoch;
+	uint16_t *visited;
+
+	vert_t *queue;
+	uint64_t *frontier;
+
+} bfs_workspace;
+
+// Creates a BFS workspace for searches on a graph with n_verts vertices
+bfs_workspace *new_bfs_workspace(size_t n_verts);
+
+// Frees the memory allocated to a BFS workspace
+void free_bfs_workspace(bfs_workspace *ws);
+
+// Performs BFS on graph G like bfs, using the workspace ws. search_result points inside ws
+ssize_t bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		adj_span (*reverse_transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		bfs_workspace *ws, const vert_t **search_result);
+
+// Performs BFS on graph G with transfer=neighbours_span, using the workspace ws
+ssize_t forward_bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		bfs_workspace *ws, const vert_t **search_result);
+
+// Performs BFS on graph G with transfer=predecessors_span, using the workspace ws
+ssize_t backward_bfs_ws(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		bfs_workspace *ws, const vert_t **search_result);
+
 // Performs BFS on graph G starting from start_vertex on nodes that 
 // have search_property and saves the result in search_result
 ssize_t bfs(
 		vert_t start_vertex, const graph *G, 
-		ssize_t (*transfer)(vert_t, const graph *, const bool *, vert_t **), 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		adj_span (*reverse_transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
 		vert_t **search_result);
 
-// Performs BFS on graph G with transfer=get_neighbours
+// Performs BFS on graph G with transfer=neighbours_span
 ssize_t forward_bfs(
 		vert_t start_vertex, const graph *G, 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
 		vert_t **search_result);
 
-// Performs BFS on graph G with transfer=get_predecessors
+// Performs BFS on graph G with transfer=predecessors_span
 ssize_t backward_bfs(
 		vert_t start_vertex, const graph *G, 
-		vert_t search_property, const vert_t *properties, const bool *is_vertex, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
 		vert_t **search_result);
 
 
+/* parallel BFS functions */
+
+// colors whose region has at least this many vertices are searched using the parallel BFS
+#ifndef P_BFS_THRESHOLD
+#define P_BFS_THRESHOLD 65536
+#endif
+
+// Executes task(&args[i]) on num_threads threads, one for each i, for p_bfs_run
+typedef void (*p_bfs_runner)(void *(*task)(void *), void *args, size_t args_size, int num_threads, void *run_ctx);
+
+// Performs BFS on graph G in parallel using num_threads threads
+ssize_t p_bfs(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads);
+
+// Performs BFS on graph G in parallel on the num_threads threads provided by run
+ssize_t p_bfs_run(
+		vert_t start_vertex, const graph *G, 
+		adj_span (*transfer)(vert_t, const graph *), 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads, p_bfs_runner run, void *run_ctx);
+
+// Performs parallel BFS on graph G with transfer=neighbours_span
+ssize_t p_forward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads);
+
+// Performs parallel BFS on graph G with transfer=predecessors_span
+ssize_t p_backward_bfs(
+		vert_t start_vertex, const graph *G, 
+		vert_t search_property, const vert_t *properties, const vertex_set *is_vertex, 
+		vert_t **search_result, int num_threads);
+
+
 /* SCC helper functions */
 
 // Returns true if v is a trivial SCC
-int is_trivial_scc(vert_t v, const graph *G, const bool *is_vertex);
+int is_trivial_scc(vert_t v, const graph *G, const vertex_set *is_vertex);
+
+// Returns true if v and pair form an SCC of two vertices, with v < pair
+// shared is true when other threads may remove vertices of is_vertex meanwhile
+bool is_trivial_pair(vert_t v, const graph *G, const vertex_set *is_vertex,
+		const vert_t *in_degree, const vert_t *out_degree, vert_t *pair, bool shared);
+
+
+/* subgraph functions */
+
+// Builds the subgraph of G induced by the active vertices, relabeled in increasing order
+graph *induced_subgraph(const graph *G, const vertex_set *is_vertex, vert_t **old_id);
+
+
+/* reordering functions */
+
+// the vertex orderings computed by vertex_ordering
+typedef enum {
+	ORDER_DEGREE,	// by decreasing total degree
+	ORDER_BFS,	// in the order of a BFS that ignores edge directions
+	ORDER_RCM	// reverse Cuthill-McKee
+} vertex_order;
+
+// Computes a new label for every vertex of G, so that adjacent vertices get close labels
+vert_t *vertex_ordering(const graph *G, vertex_order order);
+
+// Builds a copy of G where every vertex v is relabeled to new_id[v]
+graph *permute_graph(const graph *G, const vert_t *new_id, int num_threads);
+
+// Returns the average number of bits of the gap |u - v| over the edges (u, v) of G
+double edge_gap_bits(const graph *G);
+
+// Relabels the scc ids found on a graph permuted with new_id back to the original vertices
+int unpermute_scc_id(size_t n_verts, const vert_t *new_id, vert_t **scc_id);
 
 
 /* graph import function */
 
 // Imports a graph's adj. matrix from a MatrixMarket .mtx file and stores it in a graph struct
-graph *import_graph(char *mtx_fname);
+graph *import_graph(char *mtx_fname, int num_threads, bool write_cache, bool verify_cache);
+
+// Builds a graph from a list of edges in the COO format, edge i is rows[i] -> cols[i]
+graph *graph_from_edges(size_t n_verts, size_t n_edges, const vert_t *rows, const vert_t *cols, int num_threads);
+
+
+/* graph cache functions */
+
+// Writes the CSR and CSC arrays of G in a binary cache file
+int write_graph_cache(const graph *G, const char *cache_fname);
+
+// Maps a binary cache file written by write_graph_cache and uses it as a read-only graph
+// the checksum of the whole file is only checked if verify is true
+graph *load_graph_cache(const char *cache_fname, bool verify);
 
 #endif
@@ -24,12 +24,12 @@
 #include <unistd.h>
 #include <ctype.h>
 
-#include <time.h>
-
 #include <errno.h>
 #include <string.h>
 
 #include <graph.h>
+#include <generate.h>
+#include <stats.h>
 #include <scc_serial.h>
 #include <scc_pthreads.h>
 
@@ -46,29 +46,173 @@ Description:\n\
   mtx_file.mtx is a file in the MatrixMarket format\n\
   which contains the adjacency matrix of the graph.\n\
   \n\
+  instead of a file the graph can be generated with gen:name,key=value,...\n\
+  where name is one of (and key one of the words after it):\n\
+  \trmat scale degree a b c seed -- R-MAT graph of 2^scale vertices\n\
+  \tkronecker scale degree a b c seed -- R-MAT graph with shuffled vertices\n\
+  \tdag verts degree seed -- random DAG\n\
+  \tcycle verts cycles -- disjoint cycles, slowest for the coloring\n\
+  \tplanted verts sccs degree cross seed -- graph with sccs planted SCCs\n\
+  the number of SCCs of dag, cycle and planted is also checked\n\
+  \n\
   error checking is performed on the number of sccs and\n\
   the scc id of each vertex to see if it is an invalid value\n\
   (i.e. there are more sccs than vertices).\n\
   when using both the serial and parallel implememntations\n\
   this also checks if the values are matching between\n\
   implementations\n\
+  with -v both are also checked against Tarjan's algorithm\n\
 \n\
 Options:\n\
   -h:\tprint this help text and exit.\n\
   -s:\trun the serial implementation of scc.\n\
   -p:\trun the parallel implementation of scc.\n\
   -n:\tspecify the number of threads. must be a number greater than 0\n\
+  -a:\tspecify the algorithm to use. must be one of:\n\
+  \tcoloring (default) -- the graph coloring algorithm\n\
+  \tfwbw -- peel off the scc of a pivot with a forward and backward bfs\n\
+  \t        then find the rest of the sccs with the coloring algorithm\n\
+  \ttarjan -- Tarjan's linear time algorithm (serial only)\n\
+  -v:\tverify the results against the SCCs found by Tarjan's algorithm.\n\
+  -c:\twrite the imported graph to the binary cache file mtx_file.mtx.bin.\n\
+  \tlater runs load the graph from the cache while it is newer than mtx_file.mtx\n\
+  -C:\tverify the checksum of the binary cache file when the graph is loaded from it.\n\
+  \tthis reads the whole file, otherwise only its header and size are checked\n\
+  -r:\trelabel the vertices after import to improve locality. must be one of:\n\
+  \tdegree -- by decreasing degree\n\
+  \tbfs -- in breadth-first order\n\
+  \trcm -- in reverse Cuthill-McKee order\n\
+  \tthe scc ids are still reported for the original vertices\n\
+  -e:\tcount hardware events (cycles, instructions, LLC, dTLB and branch misses)\n\
+  \tin each phase and thread with perf_event_open. the run continues without\n\
+  \tthem if they are not available\n\
+  -o:\twrite a report of the run with the time of each phase and the counters\n\
+  \tof the algorithms to the given file. the report is in CSV if the file name\n\
+  \tends in .csv and in JSON otherwise\n\
+  -t:\twrite the timeline of every thread in each phase to the given file in the\n\
+  \tChrome trace format. only available if scc was built with TRACE=1\n\
   --:\tend of options. the argument following must be a filename\n\
 \n";
 
+/* run_report holds what is written in the report of a run of scc
+ *
+ * each of the implementations that was run has its number of sccs,
+ * its total time and its statistics.
+ */
+typedef struct run_report {
+	const char *mtx_fname;
+	const char *algorithm;
+	const char *order_name;
+	int num_threads;
+
+	size_t n_verts;
+	size_t n_edges;
+
+	double import_time;
+	double reorder_time;
+
+	int n_runs;
+	const char *run_names[2];
+	ssize_t n_scc[2];
+	double total_time[2];
+	const scc_stats *stats[2];
+
+	int num_errors;
+
+} run_report;
+
+// Writes s as a JSON string
+static void write_json_string(FILE *f, const char *s) {
+	fputc('"', f);
+	for(; *s != '\0' ; ++s) {
+		if(*s == '"' || *s == '\\') fputc('\\', f);
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+/* Writes the report of the run to report_fname
+ *
+ * the report is a JSON object, or a CSV table with a row for each implementation
+ * if report_fname ends in .csv. returns 0 on success or -1 on failure.
+ */
+static int write_report(const char *report_fname, const run_report *r) {
+	FILE *f = fopen(report_fname, "w");
+	if(f == NULL) {
+		fprintf(stderr, "Error opening report file %s:\n%s\n", report_fname, strerror(errno));
+		return -1;
+	}
+
+	size_t len = strlen(report_fname);
+	if(len >= 4 && !strcmp(report_fname + len - 4, ".csv")) {
+		fprintf(f, "file,implementation,algorithm,order,threads,n_verts,n_edges,import_time,reorder_time,n_scc,total_time,errors,");
+		write_stats_csv_header(f);
+		fprintf(f, "\n");
+
+		for(int i = 0 ; i < r->n_runs ; ++i) {
+			fprintf(f, "\"%s\",%s,%s,%s,%d,%zu,%zu,%0.6f,%0.6f,%zd,%0.6f,%d,",
+					r->mtx_fname, r->run_names[i], r->algorithm, (r->order_name != NULL)? r->order_name : "none",
+					r->num_threads, r->n_verts, r->n_edges, r->import_time, r->reorder_time,
+					r->n_scc[i], r->total_time[i], r->num_errors);
+			write_stats_csv(f, r->stats[i]);
+			fprintf(f, "\n");
+		}
+	} else {
+		fprintf(f, "{\n  \"file\": ");
+		write_json_string(f, r->mtx_fname);
+		fprintf(f, ",\n  \"algorithm\": ");
+		write_json_string(f, r->algorithm);
+		fprintf(f, ",\n  \"order\": ");
+		write_json_string(f, (r->order_name != NULL)? r->order_name : "none");
+		fprintf(f, ",\n  \"threads\": %d,\n  \"n_verts\": %zu,\n  \"n_edges\": %zu,\n", r->num_threads, r->n_verts, r->n_edges);
+		fprintf(f, "  \"import_time\": %0.6f,\n  \"reorder_time\": %0.6f,\n", r->import_time, r->reorder_time);
+		fprintf(f, "  \"errors\": %d,\n  \"runs\": [", r->num_errors);
+
+		for(int i = 0 ; i < r->n_runs ; ++i) {
+			fprintf(f, "%s\n    {\"implementation\": \"%s\", \"n_scc\": %zd, \"total_time\": %0.6f, ",
+					(i > 0)? "," : "", r->run_names[i], r->n_scc[i], r->total_time[i]);
+			write_stats_json(f, r->stats[i]);
+			fprintf(f, "}");
+		}
+
+		fprintf(f, "\n  ]\n}\n");
+	}
+
+	if(fclose(f) == EOF) {
+		fprintf(stderr, "Error writing report file %s:\n%s\n", report_fname, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv) {
 
 	bool run_serial = false;
 	bool run_parallel = false;
+	bool write_cache = false;
+	bool verify_cache = false;
+	bool verify = false;
+	bool count_events = false;
 	int num_threads = NUM_THREADS;
 
+	// the file the report of the run is written to, if any
+	char *report_fname = NULL;
+
+	// the file the trace of the threads is written to, if any
+	char *trace_fname = NULL;
+
+	// the vertex ordering applied after import, if any
+	char *order_name = NULL;
+	vertex_order order = ORDER_DEGREE;
+
+	// the serial and parallel implementations of the selected algorithm
+	char *algorithm = "coloring";
+	ssize_t (*serial_scc)(const graph *, vert_t **) = scc_coloring;
+	ssize_t (*parallel_scc)(const graph *, vert_t **, int) = p_scc_coloring;
+
 	int opt;
-	while((opt = getopt(argc, argv, ":hspn:")) != -1) {
+	while((opt = getopt(argc, argv, ":hspcCven:a:r:o:t:")) != -1) {
 		switch(opt) {
 		case 'h':
 			printf(help_string);
@@ -79,6 +223,18 @@ int main(int argc, char **argv) {
 		case 'p':
 			run_parallel = true;
 			break;
+		case 'c':
+			write_cache = true;
+			break;
+		case 'C':
+			verify_cache = true;
+			break;
+		case 'v':
+			verify = true;
+			break;
+		case 'e':
+			count_events = true;
+			break;
 		case 'n':
 			num_threads = atoi(optarg);
 			if(!num_threads) {
@@ -90,11 +246,63 @@ int main(int argc, char **argv) {
 				exit(EINVAL);
 			}
 			break;
+		case 'a':
+			if(!strcmp(optarg, "coloring")) {
+				serial_scc = scc_coloring;
+				parallel_scc = p_scc_coloring;
+			} else if(!strcmp(optarg, "fwbw")) {
+				serial_scc = scc_fwbw;
+				parallel_scc = p_scc_fwbw;
+			} else if(!strcmp(optarg, "tarjan")) {
+				serial_scc = scc_tarjan;
+				parallel_scc = NULL;
+			} else {
+				fprintf(stderr, "Error: option '-a' -- unknown algorithm '%s'\n", optarg);
+				exit(EINVAL);
+			}
+			algorithm = optarg;
+			break;
+		case 'r':
+			if(!strcmp(optarg, "degree")) {
+				order = ORDER_DEGREE;
+			} else if(!strcmp(optarg, "bfs")) {
+				order = ORDER_BFS;
+			} else if(!strcmp(optarg, "rcm")) {
+				order = ORDER_RCM;
+			} else {
+				fprintf(stderr, "Error: option '-r' -- unknown ordering '%s'\n", optarg);
+				exit(EINVAL);
+			}
+			order_name = optarg;
+			break;
+		case 'o':
+			report_fname = optarg;
+			break;
+		case 't':
+#ifdef TRACE
+			trace_fname = optarg;
+			break;
+#else
+			fprintf(stderr, "Error: option '-t' -- scc was built without tracing, rebuild it with TRACE=1\n");
+			exit(EINVAL);
+#endif
 		case ':':
 			switch(optopt) {
 			case 'n':
 				fprintf(stderr, "Error: option '-n' must be followed by a numeral\n");
 				break;
+			case 'a':
+				fprintf(stderr, "Error: option '-a' must be followed by an algorithm name\n");
+				break;
+			case 'r':
+				fprintf(stderr, "Error: option '-r' must be followed by an ordering name\n");
+				break;
+			case 'o':
+				fprintf(stderr, "Error: option '-o' must be followed by a file name\n");
+				break;
+			case 't':
+				fprintf(stderr, "Error: option '-t' must be followed by a file name\n");
+				break;
 			}
 			exit(EINVAL);
 		case '?':
@@ -111,7 +319,12 @@ int main(int argc, char **argv) {
 
 	if(!(run_serial || run_parallel)) {
 		run_serial = true;
-		run_parallel = true;
+		run_parallel = (parallel_scc != NULL);
+	}
+
+	if(run_parallel && parallel_scc == NULL) {
+		fprintf(stderr, "Error: option '-p' -- algorithm '%s' has no parallel implementation\n", algorithm);
+		exit(EINVAL);
 	}
 
 	char* mtx_fname = NULL;
@@ -122,66 +335,207 @@ int main(int argc, char **argv) {
 	}
 	mtx_fname = argv[optind];
 
+	run_report report = {
+		.mtx_fname = mtx_fname, .algorithm = algorithm, .order_name = order_name,
+		.num_threads = num_threads, .n_runs = 0
+	};
+
+	// the number of SCCs of a generated graph, if it is known
+	ssize_t known_n_scc = -1;
+
 	printf("=== importing graph ===\n");
 	printf("file: %s\n", mtx_fname);
-	graph *G = import_graph(mtx_fname);
+	double start = stats_clock();
+	graph *G = NULL;
+	if(is_generator_spec(mtx_fname)) G = generate_graph(mtx_fname + strlen(GENERATOR_PREFIX), num_threads, &known_n_scc);
+	else G = import_graph(mtx_fname, num_threads, write_cache, verify_cache);
 	if(G == NULL) return -1;
+	report.import_time = stats_clock() - start;
 
 	printf("number of vertices = %zu\n", G->n_verts);
 	printf("number of edges = %zu\n", G->n_edges);
+	if(known_n_scc != -1) printf("known number of SCCs = %zd\n", known_n_scc);
+	printf("import time: %0.6f sec\n", report.import_time);
 
 	printf("\n");
 
-	struct timespec t1, t2;
-	double elapsedtime;
+	report.n_verts = G->n_verts;
+	report.n_edges = G->n_edges;
+
+	// new_id[v] is the label of vertex v in the reordered graph
+	vert_t *new_id = NULL;
+	if(order_name != NULL) {
+		printf("=== reordering graph (%s) ===\n", order_name);
+		double gap_bits = edge_gap_bits(G);
+
+		start = stats_clock();
+		new_id = vertex_ordering(G, order);
+		graph *H = (new_id == NULL)? NULL : permute_graph(G, new_id, num_threads);
+		report.reorder_time = stats_clock() - start;
 
-	ssize_t n_scc;
-	vert_t *scc_id;
+		free_graph(G);
+		if(H == NULL) {
+			free(new_id);
+			return -1;
+		}
+		G = H;
+
+		printf("average edge gap: %0.2f bits -> %0.2f bits\n", gap_bits, edge_gap_bits(G));
+
+		printf("reordering time: %0.6f sec\n", report.reorder_time);
+
+		printf("\n");
+	}
+
+	// the threads are traced from here on, the serial run only uses thread 0
+	if(trace_fname != NULL && trace_start(num_threads) == -1) {
+		free(new_id);
+		free_graph(G);
+		return -1;
+	}
+
+	// the statistics of the serial and parallel runs
+	scc_stats stats, p_stats;
+
+	ssize_t n_scc = -1;
+	vert_t *scc_id = NULL;
 	if(run_serial) {
-		printf("=== serial SCC algorithm ===\n");
-		clock_gettime(CLOCK_MONOTONIC, &t1);
-		n_scc = scc_coloring(G, &scc_id);
-		clock_gettime(CLOCK_MONOTONIC, &t2);
+		printf("=== serial SCC algorithm (%s) ===\n", algorithm);
+		trace_process("serial");
+		stats_begin(&stats);
+		if(count_events && stats_enable_counters(1) == -1) {
+			stats_end();
+			free_graph(G);
+			return -1;
+		}
+
+		start = stats_clock();
+		n_scc = (*serial_scc)(G, &scc_id);
+		double total_time = stats_clock() - start;
+		stats_end();
 
 		if(n_scc == -1) {
+			stats_free(&stats);
 			free_graph(G);
 			return -1;
 		}
 
 		printf("number of SCCs = %zd\n", n_scc);
+		printf("total time: %0.6f sec\n", total_time);
+		print_stats(&stats, total_time);
+		print_counters(&stats);
 
-		elapsedtime = (t2.tv_sec - t1.tv_sec);
-		elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 10000000000.0;
-		printf("total time: %0.6f sec\n", elapsedtime);
+		report.run_names[report.n_runs] = "serial";
+		report.n_scc[report.n_runs] = n_scc;
+		report.total_time[report.n_runs] = total_time;
+		report.stats[report.n_runs++] = &stats;
 
 		printf("\n");
 	}
 
-	ssize_t p_n_scc;
-	vert_t *p_scc_id;
+	ssize_t p_n_scc = -1;
+	vert_t *p_scc_id = NULL;
 	if(run_parallel) {
-		printf("=== parallel SCC algorithm ===\n");
-		clock_gettime(CLOCK_MONOTONIC, &t1);
-		p_n_scc = p_scc_coloring(G, &p_scc_id, num_threads);
-		clock_gettime(CLOCK_MONOTONIC, &t2);
+		printf("=== parallel SCC algorithm (%s) ===\n", algorithm);
+		trace_process("parallel");
+		stats_begin(&p_stats);
+		if(count_events && stats_enable_counters(num_threads) == -1) {
+			stats_end();
+			if(run_serial) stats_free(&stats);
+			free_graph(G);
+			return -1;
+		}
+
+		start = stats_clock();
+		p_n_scc = (*parallel_scc)(G, &p_scc_id, num_threads);
+		double total_time = stats_clock() - start;
+		stats_end();
 
 		if(p_n_scc == -1) {
+			if(run_serial) stats_free(&stats);
+			stats_free(&p_stats);
 			free_graph(G);
 			return -1;
 		}
 
 		printf("number of SCCs = %zd\n", p_n_scc);
+		printf("total time: %0.6f sec\n", total_time);
+		print_stats(&p_stats, total_time);
+		print_counters(&p_stats);
+
+		report.run_names[report.n_runs] = "parallel";
+		report.n_scc[report.n_runs] = p_n_scc;
+		report.total_time[report.n_runs] = total_time;
+		report.stats[report.n_runs++] = &p_stats;
+
+		printf("\n");
+	}
+
+	ssize_t ref_n_scc = -1;
+	vert_t *ref_scc_id = NULL;
+	if(verify) {
+		printf("=== reference SCC algorithm (tarjan) ===\n");
+		ref_n_scc = scc_tarjan(G, &ref_scc_id);
+
+		if(ref_n_scc == -1) {
+			free_graph(G);
+			return -1;
+		}
 
-		elapsedtime = (t2.tv_sec - t1.tv_sec);
-		elapsedtime += (t2.tv_nsec - t1.tv_nsec) / 10000000000.0;
-		printf("total time: %0.6f sec\n", elapsedtime);
+		printf("number of SCCs = %zd\n", ref_n_scc);
 
 		printf("\n");
 	}
 
+	// the results are relabeled to the original vertices before they are checked
+	if(new_id != NULL) {
+		int status = 0;
+		if(run_serial && status == 0) status = unpermute_scc_id(G->n_verts, new_id, &scc_id);
+		if(run_parallel && status == 0) status = unpermute_scc_id(G->n_verts, new_id, &p_scc_id);
+		if(verify && status == 0) status = unpermute_scc_id(G->n_verts, new_id, &ref_scc_id);
+
+		free(new_id);
+		if(status == -1) {
+			free_graph(G);
+			return -1;
+		}
+	}
+
 	printf("=== error checking ===\n");
 	int num_errors = 0;
 
+	if(verify && run_serial)
+	if(n_scc != ref_n_scc) {
+		printf(
+			"%3d: wrong number of SCCs (serial) -- %zd != %zd (tarjan)\n", 
+			num_errors++, n_scc, ref_n_scc
+		);
+	}
+
+	if(verify && run_parallel)
+	if(p_n_scc != ref_n_scc) {
+		printf(
+			"%3d: wrong number of SCCs (parallel) -- %zd != %zd (tarjan)\n", 
+			num_errors++, p_n_scc, ref_n_scc
+		);
+	}
+
+	if(known_n_scc != -1 && run_serial)
+	if(n_scc != known_n_scc) {
+		printf(
+			"%3d: wrong number of SCCs (serial) -- %zd != %zd (generator)\n",
+			num_errors++, n_scc, known_n_scc
+		);
+	}
+
+	if(known_n_scc != -1 && run_parallel)
+	if(p_n_scc != known_n_scc) {
+		printf(
+			"%3d: wrong number of SCCs (parallel) -- %zd != %zd (generator)\n",
+			num_errors++, p_n_scc, known_n_scc
+		);
+	}
+
 	if(run_serial && run_parallel)
 	if(n_scc != p_n_scc) {
 		printf(
@@ -215,6 +569,22 @@ int main(int argc, char **argv) {
 			);
 		}
 
+		if(verify && run_serial)
+		if(scc_id[i] != ref_scc_id[i]) {
+			printf(
+				"%3d: wrong scc id (serial) at index %zu -- %u != %u (tarjan)\n",
+				num_errors++, i, scc_id[i], ref_scc_id[i]
+			);
+		}
+
+		if(verify && run_parallel)
+		if(p_scc_id[i] != ref_scc_id[i]) {
+			printf(
+				"%3d: wrong scc id (parallel) at index %zu -- %u != %u (tarjan)\n",
+				num_errors++, i, p_scc_id[i], ref_scc_id[i]
+			);
+		}
+
 		if(run_serial)
 		if(scc_id[i] > G->n_verts) {
 			printf(
@@ -235,10 +605,22 @@ int main(int argc, char **argv) {
 	
 	printf("\n");
 
+	int status = 0;
+	if(report_fname != NULL) {
+		report.num_errors = num_errors;
+		status = write_report(report_fname, &report);
+	}
+
+	if(trace_fname != NULL && trace_dump(trace_fname) == -1) status = -1;
+
 	if(run_serial) free(scc_id);
 	if(run_parallel) free(p_scc_id);
+	if(verify) free(ref_scc_id);
+
+	if(run_serial) stats_free(&stats);
+	if(run_parallel) stats_free(&p_stats);
 
 	free_graph(G);
 
-	return 0;
+	return status;
 }
@@ -18,6 +18,7 @@
  */
 
 #include "scc_opencilk.h"
+#include <stats.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,15 +29,211 @@
 #include <string.h>
 
 #include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+
+// with TRACE the vertices of a round of color propagation are split in chunks of this size,
+// each traced as a single task. it is the largest grain cilk_for would choose itself
+#ifndef CILK_CHUNK_SIZE
+#define CILK_CHUNK_SIZE 2048
+#endif
 
 
 // implements a cilk sum reducer
 void sum_identity(void *view) { *(size_t *)view = 0; }
 void sum_reducer(void *left, void* right) { *(size_t *)left += *(size_t *)right; }
 
-// implements a cilk or reducer
-void or_identity(void *view) { *(bool *)view = false; }
-void or_reducer(void *left, void *right) { *(bool *)left = *(bool *)left || *(bool *)right; }
+/* Runs rounds of Trim-1 in parallel until no vertex is removed
+ *
+ * the *n_next vertices in *next have been removed but their neighbours have not been
+ * updated yet. each of them decreases the in_degree of its successors and the out_degree
+ * of its predecessors, and the vertices whose degree drops to zero are removed and
+ * appended to the next frontier. a vertex may reach zero from both sides at once, so
+ * it is appended by the one that removes it with atomic_remove_vertex.
+ * returns the number of vertices removed by the rounds.
+ */
+static size_t cilk_trim_rounds(const graph *G, vertex_set *is_vertex, vert_t *scc_id,
+		vert_t *in_degree, vert_t *out_degree, vert_t **frontier, vert_t **next, size_t *n_next) {
+
+	size_t n_trimmed = 0;
+	while(*n_next > 0) {
+		// the next frontier becomes the current one
+		vert_t *temp = *frontier;
+		*frontier = *next;
+		*next = temp;
+
+		size_t n_frontier = *n_next;
+		*n_next = 0;
+
+		const vert_t *current = *frontier;
+		vert_t *next_frontier = *next;
+
+		cilk_for(size_t i = 0 ; i < n_frontier ; ++i) {
+			vert_t v = current[i];
+
+			adj_span neighbours = neighbours_span(v, G);
+			adj_iter neighbours_it = adj_begin(neighbours);
+			for(size_t j = 0 ; j < neighbours.len ; ++j) {
+				vert_t w = adj_next(&neighbours_it);
+				if(w == v || !is_active_vertex_atomic(w, is_vertex)) continue;
+
+				vert_t degree = __atomic_sub_fetch(&in_degree[w], 1, __ATOMIC_RELAXED);
+				if(degree == 0 && atomic_remove_vertex(w, is_vertex)) {
+					scc_id[w] = w;
+					next_frontier[__atomic_fetch_add(n_next, 1, __ATOMIC_RELAXED)] = w;
+				}
+			}
+
+			adj_span predecessors = predecessors_span(v, G);
+			adj_iter predecessors_it = adj_begin(predecessors);
+			for(size_t j = 0 ; j < predecessors.len ; ++j) {
+				vert_t u = adj_next(&predecessors_it);
+				if(u == v || !is_active_vertex_atomic(u, is_vertex)) continue;
+
+				vert_t degree = __atomic_sub_fetch(&out_degree[u], 1, __ATOMIC_RELAXED);
+				if(degree == 0 && atomic_remove_vertex(u, is_vertex)) {
+					scc_id[u] = u;
+					next_frontier[__atomic_fetch_add(n_next, 1, __ATOMIC_RELAXED)] = u;
+				}
+			}
+		}
+
+		n_trimmed += *n_next;
+	}
+
+	return n_trimmed;
+}
+
+/* Removes the trivial SCCs from G in parallel until none are left
+ *
+ * each vertex keeps the number of its active predecessors and successors (not counting
+ * self loops), so trimming to a fixpoint takes O(V + E) work in total instead of a sweep
+ * per iteration. the SCCs of two vertices are removed with Trim-2 after Trim-1 is done,
+ * and then Trim-1 continues from the vertices they leave trivial.
+ * frontier and next are used as scratch space and must have space for n_verts vertices.
+ * *n_removed is set to the number of vertices removed.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t cilk_trim_trivial_sccs(const graph *G, vertex_set *is_vertex, vert_t *scc_id,
+		vert_t *frontier, vert_t *next, size_t *n_removed) {
+	double start = stats_phase_begin();
+
+	vert_t *in_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *out_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(in_degree == NULL || out_degree == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(in_degree);
+		free(out_degree);
+		return -1;
+	}
+
+	// count the degrees of all the active vertices first, so the vertices
+	// removed below are counted by their neighbours
+	cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		if(is_active_vertex(v, is_vertex)) {
+			in_degree[v] = active_degree(v, predecessors_span(v, G), is_vertex);
+			out_degree[v] = active_degree(v, neighbours_span(v, G), is_vertex);
+		}
+	}
+
+	// the trivial vertices are each an scc on their own. other threads may be
+	// removing vertices of the same word of is_vertex
+	size_t n_next = 0;
+	cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		if(is_active_vertex_atomic(v, is_vertex) && (in_degree[v] == 0 || out_degree[v] == 0)) {
+			scc_id[v] = v;
+			atomic_remove_vertex(v, is_vertex);
+
+			next[__atomic_fetch_add(&n_next, 1, __ATOMIC_RELAXED)] = v;
+		}
+	}
+	size_t n_scc = n_next;
+
+	// Trim-1 until no trivial vertices are left
+	n_scc += cilk_trim_rounds(G, is_vertex, scc_id, in_degree, out_degree, &frontier, &next, &n_next);
+	*n_removed = n_scc;
+
+	// Trim-2, then Trim-1 on the vertices left behind. the degrees do not change
+	// while the pairs are found and the pairs are disjoint
+	size_t cilk_reducer(sum_identity, sum_reducer) n_pairs = 0;
+	cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		vert_t u;
+		if(is_active_vertex_atomic(v, is_vertex) && is_trivial_pair(v, G, is_vertex, in_degree, out_degree, &u, true)) {
+			scc_id[v] = v;
+			scc_id[u] = v;
+
+			atomic_remove_vertex(v, is_vertex);
+			atomic_remove_vertex(u, is_vertex);
+
+			size_t pos = __atomic_fetch_add(&n_next, 2, __ATOMIC_RELAXED);
+			next[pos] = v;
+			next[pos + 1] = u;
+			n_pairs += 1;
+		}
+	}
+	n_scc += n_pairs;
+	*n_removed += n_next;
+
+	size_t n_trimmed = cilk_trim_rounds(G, is_vertex, scc_id, in_degree, out_degree, &frontier, &next, &n_next);
+	n_scc += n_trimmed;
+	*n_removed += n_trimmed;
+
+	free(in_degree);
+	free(out_degree);
+
+	stats_count(STAT_TRIMMED, *n_removed);
+	stats_phase(PHASE_TRIM, start);
+
+	return n_scc;
+}
+
+/* Sets the color of vertex v of the frontier to the smallest color of its active predecessors
+ *
+ * a vertex taken from the frontier may be added to next again, but in the first round
+ * next may already contain it. when the color of v drops its successors with a larger
+ * color are appended to next, by the strand that sets their in_next.
+ * in_next[v] is cleared before the colors of the predecessors are read, and a strand that
+ * lowers one of them sets in_next[v] after it, so either the new color is seen or v is
+ * appended to next again.
+ * returns the number of edges traversed.
+ */
+static inline size_t cilk_propagate_color(vert_t v, const graph *G, vertex_set *is_vertex, vert_t *colors,
+		bool first_round, bool *in_next, vert_t *next, size_t *n_next) {
+
+	if(!first_round) __atomic_exchange_n(&in_next[v], false, __ATOMIC_SEQ_CST);
+	if(!is_active_vertex(v, is_vertex)) return 0;
+
+	// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
+	// because we want to write in one memory position (colors[v])
+	// as opposed to every u for each v. this is useful for 
+	// the parallelization since memory locations the treads
+	// write to will not interfere.
+	// then we set colors[v] to be the minimum of its active predecessors (or itself)
+	adj_span predecessors = predecessors_span(v, G);
+	vert_t old_color = __atomic_load_n(&colors[v], __ATOMIC_RELAXED);
+	vert_t color = min_active_color(predecessors, is_vertex, colors, old_color);
+	size_t n_edges = predecessors.len;
+
+	if(color < old_color) {
+		__atomic_store_n(&colors[v], color, __ATOMIC_RELAXED);
+
+		// the successors of v with a larger color may now change color as well
+		adj_span neighbours = neighbours_span(v, G);
+		adj_iter neighbours_it = adj_begin(neighbours);
+		n_edges += neighbours.len;
+		for(size_t j = 0 ; j < neighbours.len ; ++j) {
+			vert_t w = adj_next(&neighbours_it);
+			if(!is_active_vertex(w, is_vertex) || __atomic_load_n(&colors[w], __ATOMIC_RELAXED) <= color) continue;
+
+			// only the strand that sets in_next[w] appends w to next
+			if(!__atomic_exchange_n(&in_next[w], true, __ATOMIC_SEQ_CST)) {
+				next[__atomic_fetch_add(n_next, 1, __ATOMIC_RELAXED)] = w;
+			}
+		}
+	}
+
+	return n_edges;
+}
 
 /* Implements the graph coloring algorithm to find the SCCs of G
  *
@@ -48,12 +245,8 @@ void or_reducer(void *left, void *right) { *(bool *)left = *(bool *)left || *(bo
  */
 ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 
-	bool *is_vertex = (bool *) malloc(G->n_verts * sizeof(bool));
-	if(is_vertex == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-		return -1;
-	}
-	cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) is_vertex[v] = true;
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) return -1;
 	size_t n_active_verts = G->n_verts;
 
 	// allocate the memory required for the scc_id array
@@ -61,41 +254,42 @@ ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 	if(*scc_id == NULL) {
 		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-		free(is_vertex);
+		free_vertex_set(is_vertex);
 		return -1;
 	}
 
-	// initialize n_sccs to 0
-	size_t n_scc = 0;
-	
-	// remove trivial sccs 
-	// the loop will run just twice since after that
-	// you get diminishing returns
-	for(uint8_t i = 0 ; i < 2 ; ++i) {
-		size_t cilk_reducer(sum_identity, sum_reducer) verts_removed = 0;
-
-		// loop over all vertices
-		cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v]) {
-				int is_trivial = is_trivial_scc(v, G, is_vertex);
-
-				// check if the vertex is active, and then if it is trivial
-				if(is_trivial) {
-					// if it is, set scc_id for the vertex to be itself
-					// and increase the number of sccs
-					(*scc_id)[v] = v;
+	// the colors are propagated using a worklist. frontier holds the vertices whose color
+	// may change in the current round and next the ones for the following round.
+	// in_next[v] is true when v is already in next, so that it is added only once.
+	vert_t *frontier = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *next = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	bool *in_next = (bool *) calloc(G->n_verts, sizeof(bool));
+	if(frontier == NULL || next == NULL || in_next == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-					// finally remove the vertex from the graph
-					is_vertex[v] = false;
-					verts_removed++;
-				}
-			}
-		}
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		free(frontier);
+		free(next);
+		free(in_next);
+		return -1;
+	}
 
-		n_active_verts -= verts_removed;
-		n_scc += verts_removed;
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_trivial = cilk_trim_trivial_sccs(G, is_vertex, *scc_id, frontier, next, &n_removed);
+	if(n_trivial == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		free(frontier);
+		free(next);
+		free(in_next);
+		return -1;
 	}
 
+	size_t n_scc = n_trivial;
+	n_active_verts -= n_removed;
+
 	// the core loop of the algorithm
 	// this will run as long as G is non empty
 	while(n_active_verts > 0) {
@@ -104,47 +298,69 @@ ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		if(colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
+			free_vertex_set(is_vertex);
 			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
 			return -1;
 		}
 		cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) colors[v] = v;
 
-		// this loop will run as long as at least one vertex changed colors in
-		// the last iteration since a vertex changing color might end up changing
-		// the color of its neighbours in the next iteration.
-		bool cilk_reducer(or_identity, or_reducer) changed_color = true;
-		while(changed_color) {
-			changed_color = false;
-
-			// we loop over all the vertives v in the graph (checking if the v is active)
-			cilk_for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-				if(is_vertex[v]) {
-					// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
-					// because we want to write in one memory position (colors[v])
-					// as opposed to every u for each v. this is useful for 
-					// the parallelization since memory locations the treads
-					// write to will not interfere.
-
-					vert_t *predecessors;
-					ssize_t n_predecessors = get_predecessors(v, G, is_vertex, &predecessors);
-					if(n_predecessors > 0) {
-						// then we set colors[v] to be the minimum of its predecessors (or itself)
-						for(size_t i = 0 ; i < n_predecessors ; ++i) {
-							vert_t u = predecessors[i];
-							if(colors[v] > colors[u]) {
-								colors[v] = colors[u];
-								changed_color = true;
-							}
-						}
-
-						free(predecessors);
-					}
-
+		double start = stats_phase_begin();
+
+		// in the first round every active vertex is in the frontier. after that only the
+		// successors of the vertices that changed color in the last round can change color,
+		// so each round does work proportional to the frontier instead of the whole graph.
+		// when few vertices are left the first frontier is the list of the active vertices,
+		// otherwise it is every vertex and the removed ones are skipped.
+		bool first_round = true;
+		bool all_verts = (n_active_verts * VERTEX_SET_SPARSE >= G->n_verts);
+		size_t n_frontier = all_verts ? G->n_verts : compact_vertex_set(is_vertex, frontier);
+		while(n_frontier > 0) {
+			size_t n_next = 0;
+			size_t cilk_reducer(sum_identity, sum_reducer) n_edges = 0;
+
+			// we loop over all the vertices v in the frontier
+#ifdef TRACE
+			// in chunks, so that a chunk is traced as a single task
+			size_t n_chunks = (n_frontier + CILK_CHUNK_SIZE - 1) / CILK_CHUNK_SIZE;
+			cilk_for(size_t chunk = 0 ; chunk < n_chunks ; ++chunk) {
+				trace_thread(__cilkrts_get_worker_number());
+				trace_begin("cilk_propagate_colors");
+
+				size_t chunk_end = (chunk + 1) * CILK_CHUNK_SIZE;
+				if(chunk_end > n_frontier) chunk_end = n_frontier;
+
+				for(size_t i = chunk * CILK_CHUNK_SIZE ; i < chunk_end ; ++i) {
+					vert_t v = all_verts ? i : frontier[i];
+					n_edges += cilk_propagate_color(v, G, is_vertex, colors, first_round, in_next, next, &n_next);
 				}
+
+				trace_end("cilk_propagate_colors");
 			}
+#else
+			cilk_for(size_t i = 0 ; i < n_frontier ; ++i) {
+				vert_t v = all_verts ? i : frontier[i];
+				n_edges += cilk_propagate_color(v, G, is_vertex, colors, first_round, in_next, next, &n_next);
+			}
+#endif
+
+			stats_count(STAT_EDGES, n_edges);
+			stats_count(STAT_SWEEPS, 1);
+
+			// the next frontier becomes the current one
+			vert_t *temp = frontier;
+			frontier = next;
+			next = temp;
+
+			n_frontier = n_next;
+			first_round = false;
+			all_verts = false;
 		}
 
+		stats_phase(PHASE_COLORING, start);
+		start = stats_phase_begin();
 
 		// after the coloring is finished we need to find all the unique colors c in the colors array
 		// there may be up to n_verts unique colors (one for each vertex)
@@ -152,36 +368,138 @@ ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		if(unique_colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
+			free_vertex_set(is_vertex);
 			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
 			free(colors);
 
 			return -1;
 		}
 		size_t n_colors = 0;
 
+		// color_size[c] will hold the number of vertices with color c
+		vert_t *color_size = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+		if(color_size == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free(colors);
+			free(unique_colors);
+
+			return -1;
+		}
+
 		// from the way colors was initialized, the unique colors are 
 		// those of the vertices v such that colors[v] = v, then c := v.
 		// we append c to the unique_colors array
-		for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v] && colors[v] == v) 
-				unique_colors[n_colors++] = v;
+		for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+				v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+			color_size[colors[v]] += 1;
+
+			if(colors[v] == v) unique_colors[n_colors++] = v;
 		}
 
 		// free the extra memory allocated to unique_colors
 		unique_colors = (vert_t *) realloc(unique_colors, n_colors * sizeof(vert_t));
 
+		// move the colors with large regions to the start of unique_colors
+		size_t n_large_colors = 0;
+		for(size_t i = 0 ; i < n_colors ; ++i) {
+			vert_t c = unique_colors[i];
+			if(color_size[c] >= P_BFS_THRESHOLD) {
+				unique_colors[i] = unique_colors[n_large_colors];
+				unique_colors[n_large_colors++] = c;
+			}
+		}
+
+		free(color_size);
+
+		stats_iteration(n_colors);
+		stats_phase(PHASE_COLORS, start);
+		start = stats_phase_begin();
+
 		size_t cilk_reducer(sum_identity, sum_reducer) verts_removed = 0;
 		size_t cilk_reducer(sum_identity, sum_reducer) sccs_found_thd = 0;
 
-		// then loop over all the unique colors c
-		cilk_for(size_t i = 0 ; i < n_colors ; ++i) {
+		// the SCCs of the large colors are found one at a time, each using the parallel BFS
+		for(size_t i = 0 ; i < n_large_colors ; ++i) {
+			vert_t c = unique_colors[i];
+
+			vert_t *scc_c;
+			ssize_t n_scc_c = p_backward_bfs(c, G, c, colors, is_vertex, &scc_c, num_threads);
+			if(n_scc_c == -1) {
+				free_vertex_set(is_vertex);
+				free(*scc_id);
+				free(frontier);
+				free(next);
+				free(in_next);
+				free(colors);
+				free(unique_colors);
+
+				return -1;
+			} else if(n_scc_c > 0) {
+				cilk_for(size_t j = 0 ; j < n_scc_c ; ++j) {
+					vert_t v = scc_c[j];
+					(*scc_id)[v] = c;
+					atomic_remove_vertex(v, is_vertex);
+				}
+
+				verts_removed += n_scc_c;
+				sccs_found_thd += 1;
+
+				free(scc_c);
+			}
+		}
+
+		// every worker reuses its own workspace for the bfs of all its colors,
+		// it is created the first time the worker takes a color
+		int n_workers = __cilkrts_get_nworkers();
+		bfs_workspace **workspaces = (bfs_workspace **) calloc(n_workers, sizeof(bfs_workspace *));
+		if(workspaces == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free(colors);
+			free(unique_colors);
+
+			return -1;
+		}
+
+		// then loop over all the remaining unique colors c
+		bool failed = false;
+		cilk_for(size_t i = n_large_colors ; i < n_colors ; ++i) {
 			vert_t c = unique_colors[i];
 
+			// every color is traced as a task of its own
+			int worker = __cilkrts_get_worker_number();
+			trace_thread(worker);
+			trace_begin("cilk_get_sccs");
+
+			bfs_workspace **ws = &workspaces[worker];
+			if(*ws == NULL) *ws = new_bfs_workspace(G->n_verts);
+			if(*ws == NULL) {
+				__atomic_store_n(&failed, true, __ATOMIC_RELAXED);
+				trace_end("cilk_get_sccs");
+				continue;
+			}
+
+			// the other strands remove the sccs they find during the searches
+			(*ws)->shared = true;
+
 			// perform a backward bfs on the subgraph of G where colors[v] = c
 			// these create a new scc
-			vert_t *scc_c;
-			ssize_t n_scc_c = backward_bfs(c, G, c, colors, is_vertex, &scc_c);
+			const vert_t *scc_c;
+			ssize_t n_scc_c = backward_bfs_ws(c, G, c, colors, is_vertex, *ws, &scc_c);
 			if(n_scc_c > 0) {
 				// for each vertex in the new scc set scc_id = c and increase n_scc
 				for(size_t j = 0 ; j < n_scc_c ; ++j) {
@@ -189,14 +507,37 @@ ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 					(*scc_id)[v] = c;
 
 					// finally remove the vertices from the graph
-					is_vertex[v] = false;
+					atomic_remove_vertex(v, is_vertex);
 				}
 
 				verts_removed += n_scc_c;
 				sccs_found_thd += 1;
-
-				free(scc_c);
 			}
+
+			trace_end("cilk_get_sccs");
+		}
+
+		for(int w = 0 ; w < n_workers ; ++w) {
+			if(workspaces[w] == NULL) continue;
+
+			stats_count(STAT_EDGES, workspaces[w]->n_edges);
+			free_bfs_workspace(workspaces[w]);
+		}
+		free(workspaces);
+
+		stats_phase(PHASE_BFS, start);
+
+		// the colors of the workers without a workspace were skipped
+		if(failed) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free(colors);
+			free(unique_colors);
+
+			return -1;
 		}
 
 		n_active_verts -= verts_removed;
@@ -206,7 +547,10 @@ ssize_t cilk_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		free(colors);
 	}
 
-	free(is_vertex);
+	free_vertex_set(is_vertex);
+	free(frontier);
+	free(next);
+	free(in_next);
 
 	return n_scc;
 }
@@ -18,6 +18,7 @@
  */
 
 #include "scc_openmp.h"
+#include <stats.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,6 +28,181 @@
 
 #include <string.h>
 
+#include <omp.h>
+
+
+/* Runs rounds of Trim-1 in parallel until no vertex is removed
+ *
+ * the *n_next vertices in *next have been removed but their neighbours have not been
+ * updated yet. each of them decreases the in_degree of its successors and the out_degree
+ * of its predecessors, and the vertices whose degree drops to zero are removed and
+ * appended to the next frontier. a vertex may reach zero from both sides at once, so
+ * it is appended by the one that removes it with atomic_remove_vertex.
+ * returns the number of vertices removed by the rounds.
+ */
+static size_t omp_trim_rounds(const graph *G, vertex_set *is_vertex, vert_t *scc_id,
+		vert_t *in_degree, vert_t *out_degree, vert_t **frontier, vert_t **next, size_t *n_next, int num_threads) {
+
+	size_t n_trimmed = 0;
+	while(*n_next > 0) {
+		// the next frontier becomes the current one
+		vert_t *temp = *frontier;
+		*frontier = *next;
+		*next = temp;
+
+		size_t n_frontier = *n_next;
+		*n_next = 0;
+
+		const vert_t *current = *frontier;
+		vert_t *next_frontier = *next;
+
+		#pragma omp parallel for default (shared) num_threads (num_threads)
+		for(size_t i = 0 ; i < n_frontier ; ++i) {
+			vert_t v = current[i];
+
+			adj_span neighbours = neighbours_span(v, G);
+			adj_iter neighbours_it = adj_begin(neighbours);
+			for(size_t j = 0 ; j < neighbours.len ; ++j) {
+				vert_t w = adj_next(&neighbours_it);
+				if(w == v || !is_active_vertex_atomic(w, is_vertex)) continue;
+
+				vert_t degree;
+				#pragma omp atomic capture
+					degree = --in_degree[w];
+
+				if(degree == 0 && atomic_remove_vertex(w, is_vertex)) {
+					scc_id[w] = w;
+
+					size_t pos;
+					#pragma omp atomic capture
+						pos = (*n_next)++;
+
+					next_frontier[pos] = w;
+				}
+			}
+
+			adj_span predecessors = predecessors_span(v, G);
+			adj_iter predecessors_it = adj_begin(predecessors);
+			for(size_t j = 0 ; j < predecessors.len ; ++j) {
+				vert_t u = adj_next(&predecessors_it);
+				if(u == v || !is_active_vertex_atomic(u, is_vertex)) continue;
+
+				vert_t degree;
+				#pragma omp atomic capture
+					degree = --out_degree[u];
+
+				if(degree == 0 && atomic_remove_vertex(u, is_vertex)) {
+					scc_id[u] = u;
+
+					size_t pos;
+					#pragma omp atomic capture
+						pos = (*n_next)++;
+
+					next_frontier[pos] = u;
+				}
+			}
+		}
+
+		n_trimmed += *n_next;
+	}
+
+	return n_trimmed;
+}
+
+/* Removes the trivial SCCs from G in parallel until none are left
+ *
+ * each vertex keeps the number of its active predecessors and successors (not counting
+ * self loops), so trimming to a fixpoint takes O(V + E) work in total instead of a sweep
+ * per iteration. the SCCs of two vertices are removed with Trim-2 after Trim-1 is done,
+ * and then Trim-1 continues from the vertices they leave trivial.
+ * frontier and next are used as scratch space and must have space for n_verts vertices.
+ * *n_removed is set to the number of vertices removed.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t omp_trim_trivial_sccs(const graph *G, vertex_set *is_vertex, vert_t *scc_id,
+		vert_t *frontier, vert_t *next, size_t *n_removed, int num_threads) {
+	double start = stats_phase_begin();
+
+	vert_t *in_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *out_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(in_degree == NULL || out_degree == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(in_degree);
+		free(out_degree);
+		return -1;
+	}
+
+	// count the degrees of all the active vertices first, so the vertices
+	// removed below are counted by their neighbours
+	#pragma omp parallel for default (shared) num_threads (num_threads)
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		if(is_active_vertex(v, is_vertex)) {
+			in_degree[v] = active_degree(v, predecessors_span(v, G), is_vertex);
+			out_degree[v] = active_degree(v, neighbours_span(v, G), is_vertex);
+		}
+	}
+
+	// the trivial vertices are each an scc on their own. other threads may be
+	// removing vertices of the same word of is_vertex
+	size_t n_next = 0;
+	#pragma omp parallel for default (shared) num_threads (num_threads)
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		if(is_active_vertex_atomic(v, is_vertex) && (in_degree[v] == 0 || out_degree[v] == 0)) {
+			scc_id[v] = v;
+			atomic_remove_vertex(v, is_vertex);
+
+			size_t pos;
+			#pragma omp atomic capture
+				pos = n_next++;
+
+			next[pos] = v;
+		}
+	}
+	size_t n_scc = n_next;
+
+	// Trim-1 until no trivial vertices are left
+	n_scc += omp_trim_rounds(G, is_vertex, scc_id, in_degree, out_degree, &frontier, &next, &n_next, num_threads);
+	*n_removed = n_scc;
+
+	// Trim-2, then Trim-1 on the vertices left behind. the degrees do not change
+	// while the pairs are found and the pairs are disjoint
+	size_t n_pairs = 0;
+	#pragma omp parallel for default (shared) num_threads (num_threads) \
+		reduction (+:n_pairs)
+	for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+		vert_t u;
+		if(is_active_vertex_atomic(v, is_vertex) && is_trivial_pair(v, G, is_vertex, in_degree, out_degree, &u, true)) {
+			scc_id[v] = v;
+			scc_id[u] = v;
+
+			atomic_remove_vertex(v, is_vertex);
+			atomic_remove_vertex(u, is_vertex);
+
+			size_t pos;
+			#pragma omp atomic capture
+				{ pos = n_next; n_next += 2; }
+
+			next[pos] = v;
+			next[pos + 1] = u;
+			n_pairs += 1;
+		}
+	}
+	n_scc += n_pairs;
+	*n_removed += n_next;
+
+	size_t n_trimmed = omp_trim_rounds(G, is_vertex, scc_id, in_degree, out_degree, &frontier, &next, &n_next, num_threads);
+	n_scc += n_trimmed;
+	*n_removed += n_trimmed;
+
+	free(in_degree);
+	free(out_degree);
+
+	stats_count(STAT_TRIMMED, *n_removed);
+	stats_phase(PHASE_TRIM, start);
+
+	return n_scc;
+}
 
 /* Implements the graph coloring algorithm to find the SCCs of G
  *
@@ -37,16 +213,14 @@
  * if v belongs to the scc with id c then: scc_id[v] = c
  */
 ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
+
+	// in counters mode every thread of the team counts the events of its own thread.
+	// the team is kept by the runtime between the parallel regions
+	#pragma omp parallel default (shared) num_threads (num_threads)
+	stats_attach_thread(omp_get_thread_num());
 	
-	bool *is_vertex = (bool *) malloc(G->n_verts * sizeof(bool));
-	if(is_vertex == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-		return -1;
-	}
-	
-	// initializing is_vertex array in parallel
-	#pragma omp parallel for default (shared) num_threads (num_threads)
-	for(vert_t v = 0 ; v < G->n_verts ; ++v) is_vertex[v] = true;
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) return -1;
 	size_t n_active_verts = G->n_verts;
 
 	// allocate the memory required for the scc_id array
@@ -54,47 +228,42 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 	if(*scc_id == NULL) {
 		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-		free(is_vertex);
+		free_vertex_set(is_vertex);
 		return -1;
 	}
 
-	// initialize n_sccs to 0
-	size_t n_scc = 0;
-	
-	// remove trivial sccs 
-	// the loop will just twice since after that
-	// you get diminishing returns
-	for(uint8_t i = 0 ; i < 2 ; ++i) {
-		size_t verts_removed = 0;
+	// the colors are propagated using a worklist. frontier holds the vertices whose color
+	// may change in the current round and next the ones for the following round.
+	// in_next[v] is true when v is already in next, so that it is added only once.
+	vert_t *frontier = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *next = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	bool *in_next = (bool *) calloc(G->n_verts, sizeof(bool));
+	if(frontier == NULL || next == NULL || in_next == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-		// loop over all vertices in parallel
-		// verts removed is private to each thread and when all threads return
-		// the value will be set as the sum of the values of all the threads.
-		#pragma omp parallel for default (shared) num_threads (num_threads) \
-			reduction (+:verts_removed) 
-		for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v]) {
-				int is_trivial = is_trivial_scc(v, G, is_vertex);
-
-				// check if the vertex is active, and then if it is trivial
-				if(is_trivial) {
-					// if it is, set scc_id for the vertex to be itself
-					// and increase the number of sccs
-					(*scc_id)[v] = v;
-
-					// finally remove the vertex from the graph
-					is_vertex[v] = false;
-
-					verts_removed++;
-				}
-			}
-		}
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		free(frontier);
+		free(next);
+		free(in_next);
+		return -1;
+	}
 
-		// update n_scc and n_active_verts accordingly
-		n_scc += verts_removed;
-		n_active_verts -= verts_removed;
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_trivial = omp_trim_trivial_sccs(G, is_vertex, *scc_id, frontier, next, &n_removed, num_threads);
+	if(n_trivial == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		free(frontier);
+		free(next);
+		free(in_next);
+		return -1;
 	}
 
+	size_t n_scc = n_trivial;
+	n_active_verts -= n_removed;
+
 	// the core loop of the algorithm
 	// this will run as long as G is non empty
 	while(n_active_verts > 0) {
@@ -103,8 +272,11 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		if(colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
+			free_vertex_set(is_vertex);
 			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
 			return -1;
 		}
 
@@ -112,42 +284,107 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		#pragma omp parallel for default (shared) num_threads (num_threads)
 		for(vert_t v = 0 ; v < G->n_verts ; ++v) colors[v] = v;
 
-		// this loop will run as long as at least one vertex changed colors in
-		// the last iteration since a vertex changing color might end up changing
-		// the color of its neighbours in the next iteration.
-		bool changed_color = true;
-		while(changed_color) {
-			changed_color = false;
+		double start = stats_phase_begin();
+
+		// in the first round every active vertex is in the frontier. after that only the
+		// successors of the vertices that changed color in the last round can change color,
+		// so each round does work proportional to the frontier instead of the whole graph.
+		// when few vertices are left the first frontier is the list of the active vertices,
+		// otherwise it is every vertex and the removed ones are skipped.
+		bool first_round = true;
+		bool all_verts = (n_active_verts * VERTEX_SET_SPARSE >= G->n_verts);
+		size_t n_frontier = all_verts ? G->n_verts : compact_vertex_set(is_vertex, frontier);
+		while(n_frontier > 0) {
+			size_t n_next = 0;
+			size_t n_edges = 0;
+
+			// we loop over all the vertices v in the frontier in parallel.
+			// the threads do not wait for each other at the end of the loop, so that
+			// the trace shows when each of them finished its part
+			#pragma omp parallel default (shared) num_threads (num_threads)
+			{
+				trace_thread(omp_get_thread_num());
+				trace_begin("omp_propagate_colors");
+
+				#pragma omp for reduction (+:n_edges) nowait
+				for(size_t i = 0 ; i < n_frontier ; ++i) {
+					// a vertex taken from the frontier may be added to next again,
+					// but in the first round next may already contain it.
+					// in_next[v] is cleared before the colors of the predecessors are read, and
+					// a thread that lowers one of them sets in_next[v] after it, so either this
+					// thread sees the new color or v is appended to next again
+					vert_t v = all_verts ? i : frontier[i];
+					if(!first_round) {
+						#pragma omp atomic write seq_cst
+							in_next[v] = false;
+					}
 
-			// we loop over all the vertives v in the graph in parallel
-			#pragma omp parallel for default (shared) num_threads (num_threads)
-			for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-				if(is_vertex[v]) {
-					// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
-					// because we want to write in one memory position (colors[v])
-					// as opposed to every u for each v. this is useful for 
-					// the parallelization since memory locations the treads
-					// write to will not interfere.
-
-					vert_t *predecessors;
-					ssize_t n_predecessors = get_predecessors(v, G, is_vertex, &predecessors);
-					if(n_predecessors > 0) {
-						// then we set colors[v] to be the minimum of its predecessors (or itself)
-						for(size_t i = 0 ; i < n_predecessors ; ++i) {
-							vert_t u = predecessors[i];
-							if(colors[v] > colors[u]) {
-								colors[v] = colors[u];
-								changed_color = true;
+					if(is_active_vertex(v, is_vertex)) {
+						// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
+						// because we want to write in one memory position (colors[v])
+						// as opposed to every u for each v. this is useful for 
+						// the parallelization since memory locations the treads
+						// write to will not interfere.
+						// then we set colors[v] to be the minimum of its active predecessors (or itself)
+						adj_span predecessors = predecessors_span(v, G);
+						vert_t old_color;
+						#pragma omp atomic read
+							old_color = colors[v];
+
+						vert_t color = min_active_color(predecessors, is_vertex, colors, old_color);
+						n_edges += predecessors.len;
+
+						if(color < old_color) {
+							#pragma omp atomic write
+								colors[v] = color;
+
+							// the successors of v with a larger color may now change color as well
+							adj_span neighbours = neighbours_span(v, G);
+							adj_iter neighbours_it = adj_begin(neighbours);
+							n_edges += neighbours.len;
+							for(size_t j = 0 ; j < neighbours.len ; ++j) {
+								vert_t w = adj_next(&neighbours_it);
+								vert_t w_color;
+								#pragma omp atomic read
+									w_color = colors[w];
+
+								if(!is_active_vertex(w, is_vertex) || w_color <= color) continue;
+
+								// only the thread that sets in_next[w] appends w to next
+								bool was_next;
+								#pragma omp atomic capture seq_cst
+									{ was_next = in_next[w]; in_next[w] = true; }
+
+								if(!was_next) {
+									size_t pos;
+									#pragma omp atomic capture
+										pos = n_next++;
+
+									next[pos] = w;
+								}
 							}
 						}
-
-						free(predecessors);
 					}
-
 				}
+
+				trace_end("omp_propagate_colors");
 			}
+
+			stats_count(STAT_EDGES, n_edges);
+			stats_count(STAT_SWEEPS, 1);
+
+			// the next frontier becomes the current one
+			vert_t *temp = frontier;
+			frontier = next;
+			next = temp;
+
+			n_frontier = n_next;
+			first_round = false;
+			all_verts = false;
 		}
 
+		stats_phase(PHASE_COLORING, start);
+		start = stats_phase_begin();
 
 		// after the coloring is finished we need to find all the unique colors c in the colors array
 		// there may be up to n_verts unique colors (one for each vertex)
@@ -155,53 +392,114 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		if(unique_colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
+			free_vertex_set(is_vertex);
 			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
 			free(colors);
 
 			return -1;
 		}
 		size_t n_colors = 0;
 
+		// color_size[c] will hold the number of vertices with color c
+		vert_t *color_size = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+		if(color_size == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free(colors);
+			free(unique_colors);
+
+			return -1;
+		}
+
 		// from the way colors was initialized, the unique colors are 
 		// those of the vertices v such that colors[v] = v, then c := v.
 		// we append c to the unique_colors array. we can do this in parallel
-		#pragma omp parallel for default (shared) num_threads (num_threads)
-		for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v] && colors[v] == v) {
-				// but we must consider the operation below critical (mutex),
-				// meaning only one thread may perform it at a time
-				#pragma omp critical
-					unique_colors[n_colors++] = v;
+		#pragma omp parallel default (shared) num_threads (num_threads)
+		{
+			// consecutive vertices usually have the same color, so each thread counts
+			// the vertices in runs of the same color and adds each run to color_size
+			vert_t run_color = 0;
+			vert_t run_length = 0;
+
+			#pragma omp for
+			for(vert_t v = 0 ; v < G->n_verts ; ++v) {
+				if(is_active_vertex(v, is_vertex)) {
+					if(colors[v] != run_color && run_length > 0) {
+						#pragma omp atomic
+							color_size[run_color] += run_length;
+						run_length = 0;
+					}
+
+					run_color = colors[v];
+					run_length += 1;
+				}
+
+				if(is_active_vertex(v, is_vertex) && colors[v] == v) {
+					// but we must consider the operation below critical (mutex),
+					// meaning only one thread may perform it at a time
+					#pragma omp critical
+						unique_colors[n_colors++] = v;
+				}
+			}
+
+			if(run_length > 0) {
+				#pragma omp atomic
+					color_size[run_color] += run_length;
 			}
 		}
 
 		// free the extra memory allocated to unique_colors
 		unique_colors = (vert_t *) realloc(unique_colors, n_colors * sizeof(vert_t));
 
+		// move the colors with large regions to the start of unique_colors
+		size_t n_large_colors = 0;
+		for(size_t i = 0 ; i < n_colors ; ++i) {
+			vert_t c = unique_colors[i];
+			if(color_size[c] >= P_BFS_THRESHOLD) {
+				unique_colors[i] = unique_colors[n_large_colors];
+				unique_colors[n_large_colors++] = c;
+			}
+		}
+
+		free(color_size);
+
+		stats_iteration(n_colors);
+		stats_phase(PHASE_COLORS, start);
+		start = stats_phase_begin();
+
 		size_t sccs_found = 0;
 		size_t verts_removed = 0;
 
-		// then loop over all the unique colors c in parallel
-		// performing once again a sum reduction on sccs_found
-		// and verts_removed on each thread.
-		#pragma omp parallel for default (shared) num_threads(num_threads) \
-			reduction (+:sccs_found, verts_removed)
-		for(size_t i = 0 ; i < n_colors ; ++i) {
+		// the SCCs of the large colors are found one at a time, each using the parallel BFS
+		for(size_t i = 0 ; i < n_large_colors ; ++i) {
 			vert_t c = unique_colors[i];
 
-			// perform a backward bfs on the subgraph of G where colors[v] = c
-			// these create a new scc
 			vert_t *scc_c;
-			ssize_t n_scc_c = backward_bfs(c, G, c, colors, is_vertex, &scc_c);
-			if(n_scc_c > 0) {
-				// for each vertex in the new scc set scc_id = c and increase n_scc
+			ssize_t n_scc_c = p_backward_bfs(c, G, c, colors, is_vertex, &scc_c, num_threads);
+			if(n_scc_c == -1) {
+				free_vertex_set(is_vertex);
+				free(*scc_id);
+				free(frontier);
+				free(next);
+				free(in_next);
+				free(colors);
+				free(unique_colors);
+
+				return -1;
+			} else if(n_scc_c > 0) {
+				#pragma omp parallel for default (shared) num_threads (num_threads)
 				for(size_t j = 0 ; j < n_scc_c ; ++j) {
 					vert_t v = scc_c[j];
 					(*scc_id)[v] = c;
-
-					// finally remove the vertices from the graph
-					is_vertex[v] = false;
+					atomic_remove_vertex(v, is_vertex);
 				}
 
 				verts_removed += n_scc_c;
@@ -211,6 +509,68 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 			}
 		}
 
+		// then loop over all the remaining unique colors c in parallel
+		// performing once again a sum reduction on sccs_found
+		// and verts_removed on each thread.
+		bool failed = false;
+		#pragma omp parallel default (shared) num_threads(num_threads)
+		{
+			// every thread reuses its own workspace for the bfs of all its colors.
+			// the other threads remove the sccs they find during the searches
+			bfs_workspace *ws = new_bfs_workspace(G->n_verts);
+			if(ws == NULL) __atomic_store_n(&failed, true, __ATOMIC_RELAXED);
+			else ws->shared = true;
+
+			trace_thread(omp_get_thread_num());
+			trace_begin("omp_get_sccs");
+
+			#pragma omp for reduction (+:sccs_found, verts_removed) nowait
+			for(size_t i = n_large_colors ; i < n_colors ; ++i) {
+				vert_t c = unique_colors[i];
+				if(ws == NULL) continue;
+
+				// perform a backward bfs on the subgraph of G where colors[v] = c
+				// these create a new scc
+				const vert_t *scc_c;
+				ssize_t n_scc_c = backward_bfs_ws(c, G, c, colors, is_vertex, ws, &scc_c);
+				if(n_scc_c > 0) {
+					// for each vertex in the new scc set scc_id = c and increase n_scc
+					for(size_t j = 0 ; j < n_scc_c ; ++j) {
+						vert_t v = scc_c[j];
+						(*scc_id)[v] = c;
+
+						// finally remove the vertices from the graph
+						atomic_remove_vertex(v, is_vertex);
+					}
+
+					verts_removed += n_scc_c;
+					sccs_found += 1;
+				}
+			}
+
+			trace_end("omp_get_sccs");
+
+			if(ws != NULL) {
+				stats_count(STAT_EDGES, ws->n_edges);
+				free_bfs_workspace(ws);
+			}
+		}
+
+		stats_phase(PHASE_BFS, start);
+
+		// the colors of the threads without a workspace were skipped
+		if(failed) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free(colors);
+			free(unique_colors);
+
+			return -1;
+		}
+
 		// update n_scc and n_active_verts accordingly
 		n_scc += sccs_found;
 		n_active_verts -= verts_removed;
@@ -219,7 +579,10 @@ ssize_t omp_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		free(colors);
 	}
 
-	free(is_vertex);
+	free_vertex_set(is_vertex);
+	free(frontier);
+	free(next);
+	free(in_next);
 
 	return n_scc;
 }
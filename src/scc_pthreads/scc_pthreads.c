@@ -19,6 +19,9 @@
 
 #include "scc_pthreads.h"
 
+#include <scc_serial.h>
+#include <stats.h>
+
 #include <pthread.h>
 
 #include <stdio.h>
@@ -29,26 +32,281 @@
 #include <string.h>
 
 
-/* This function is meant to be executed inside a thread.
+/* thread_pool is a set of worker threads that are created once and then execute
+ * every phase of the algorithm, instead of creating new threads for each phase.
  *
- * it initializes the is_vertex array between vertices start and end
+ * a phase is dispatched with thread_pool_run, which takes an array of num_threads
+ * work descriptors (the *_args structs below). every thread i, with the calling thread
+ * acting as thread 0, executes task(&args[i]). the workers wait on the phase_start
+ * barrier for the next phase, and all the threads wait on the phase_end barrier
+ * for the current phase to finish.
  */
-struct init_vertex_args {
-	vert_t start;
-	vert_t end;
+struct thread_pool {
+	int num_threads;
 
-	bool *is_vertex;
+	pthread_t *threads;
+	struct thread_pool_worker *workers;
 
-}; static void *p_init_is_vertex(void *args) {
-	struct init_vertex_args *ivargs = (struct init_vertex_args *) args;
+	pthread_barrier_t phase_start;
+	pthread_barrier_t phase_end;
 
-	// loop over all vertices between start and end
-	for(vert_t v = ivargs->start ; v < ivargs->end ; ++v) {
-		// initialize is_vertex[v] as true
-		ivargs->is_vertex[v] = true;
+	// the work descriptors of the current phase
+	void *(*task)(void *);
+	const char *task_name;
+	char *task_args;
+	size_t task_args_size;
+
+	bool shutdown;
+
+};
+
+struct thread_pool_worker {
+	int thread_id;
+	struct thread_pool *pool;
+
+}; static void *thread_pool_worker_loop(void *args) {
+	struct thread_pool_worker *worker = (struct thread_pool_worker *) args;
+	struct thread_pool *pool = worker->pool;
+
+	// in counters mode every worker counts the events of its own thread
+	stats_attach_thread(worker->thread_id);
+	trace_thread(worker->thread_id);
+
+	while(true) {
+		// wait for the next phase to be dispatched
+		pthread_barrier_wait(&pool->phase_start);
+		if(pool->shutdown) break;
+
+		trace_begin(pool->task_name);
+		(*pool->task)(pool->task_args + worker->thread_id * pool->task_args_size);
+		trace_end(pool->task_name);
+
+		pthread_barrier_wait(&pool->phase_end);
 	}
+
 	return NULL;
-} 
+}
+
+/* Creates the num_threads - 1 worker threads of the pool
+ *
+ * the calling thread is the first thread of the pool.
+ * returns 0 on success and -1 on failure.
+ */
+static int thread_pool_init(struct thread_pool *pool, int num_threads) {
+	pool->num_threads = num_threads;
+	pool->shutdown = false;
+
+	pool->threads = (pthread_t *) malloc(num_threads * sizeof(pthread_t));
+	pool->workers = (struct thread_pool_worker *) malloc(num_threads * sizeof(struct thread_pool_worker));
+	if(pool->threads == NULL || pool->workers == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(pool->threads);
+		free(pool->workers);
+		return -1;
+	}
+
+	pthread_barrier_init(&pool->phase_start, NULL, num_threads);
+	pthread_barrier_init(&pool->phase_end, NULL, num_threads);
+
+	for(int i = 1 ; i < num_threads ; ++i) {
+		pool->workers[i].thread_id = i;
+		pool->workers[i].pool = pool;
+
+		pthread_create(&pool->threads[i], NULL, thread_pool_worker_loop, &pool->workers[i]);
+	}
+
+	return 0;
+}
+
+/* Executes one phase on the pool
+ *
+ * args is an array of num_threads work descriptors of args_size bytes each.
+ * returns after every thread has finished its part of the phase.
+ * in the trace the part of every thread is shown as task_name.
+ */
+static void thread_pool_run_task(struct thread_pool *pool, void *(*task)(void *), const char *task_name, void *args, size_t args_size) {
+	pool->task = task;
+	pool->task_name = task_name;
+	pool->task_args = (char *) args;
+	pool->task_args_size = args_size;
+
+	// release the workers, then do the work of thread 0
+	pthread_barrier_wait(&pool->phase_start);
+
+	trace_begin(task_name);
+	(*task)(args);
+	trace_end(task_name);
+
+	pthread_barrier_wait(&pool->phase_end);
+}
+
+// the phases are traced under the name of their task
+#define thread_pool_run(pool, task, args, args_size) thread_pool_run_task(pool, task, #task, args, args_size)
+
+// Stops the worker threads of the pool and frees its resources
+static void thread_pool_destroy(struct thread_pool *pool) {
+	pool->shutdown = true;
+	pthread_barrier_wait(&pool->phase_start);
+
+	for(int i = 1 ; i < pool->num_threads ; ++i) pthread_join(pool->threads[i], NULL);
+
+	pthread_barrier_destroy(&pool->phase_start);
+	pthread_barrier_destroy(&pool->phase_end);
+
+	free(pool->threads);
+	free(pool->workers);
+}
+
+
+/* work_queue holds the range of tasks [lo, hi) that a thread still has to execute.
+ *
+ * the tasks of a phase (chunks of vertices or colors) are split in equal contiguous ranges,
+ * one for each thread. a thread takes tasks from the front of its own range and when it
+ * runs out it steals the back half of the range of another thread. lo and hi are packed
+ * in a single word so that both operations are a single compare and swap.
+ * each queue is on its own cache line so that the threads do not interfere with each other.
+ */
+struct work_queue {
+	uint64_t range;
+
+} __attribute__((aligned(64)));
+
+static inline uint64_t work_range(uint32_t lo, uint32_t hi) {
+	return ((uint64_t) hi << 32) | lo;
+}
+
+// Splits n_tasks tasks in equal contiguous ranges, one for each of the num_threads queues
+static void work_queues_init(struct work_queue *queues, int num_threads, size_t n_tasks) {
+	for(int i = 0 ; i < num_threads ; ++i) {
+		uint32_t lo = (i * n_tasks) / num_threads;
+		uint32_t hi = ((i + 1) * n_tasks) / num_threads;
+
+		queues[i].range = work_range(lo, hi);
+	}
+}
+
+/* Gets the next task of thread thread_id
+ *
+ * the task is taken from the queue of the thread, or stolen from the other queues.
+ * returns false when there are no tasks left in any queue.
+ */
+static bool work_queue_next(struct work_queue *queues, int num_threads, int thread_id, size_t *task) {
+	struct work_queue *own = &queues[thread_id];
+
+	// take the task at the front of the own queue
+	uint64_t range = __atomic_load_n(&own->range, __ATOMIC_ACQUIRE);
+	while((uint32_t) range < (uint32_t) (range >> 32)) {
+		uint32_t lo = (uint32_t) range;
+		uint32_t hi = (uint32_t) (range >> 32);
+
+		if(__atomic_compare_exchange_n(&own->range, &range, work_range(lo + 1, hi),
+					false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			*task = lo;
+			return true;
+		}
+	}
+
+	// the own queue is empty, so steal the back half of the queue of another thread
+	for(int k = 1 ; k < num_threads ; ++k) {
+		struct work_queue *victim = &queues[(thread_id + k) % num_threads];
+
+		range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+		while((uint32_t) range < (uint32_t) (range >> 32)) {
+			uint32_t lo = (uint32_t) range;
+			uint32_t hi = (uint32_t) (range >> 32);
+			uint32_t mid = hi - (hi - lo + 1) / 2;
+
+			if(__atomic_compare_exchange_n(&victim->range, &range, work_range(lo, mid),
+						false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				// execute the first stolen task and keep the rest in the own queue
+				__atomic_store_n(&own->range, work_range(mid + 1, hi), __ATOMIC_RELEASE);
+
+				*task = mid;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/* Splits the vertices of G in chunks of roughly equal work
+ *
+ * the work of a vertex is one plus its in-degree, taken from csc_col_id, which is what
+ * the coloring iteration and the BFS on predecessors spend on it. with compressed
+ * adjacency lists the offsets count bytes instead, which follows the decoding work.
+ * a chunk ends as soon as its work reaches P_CHUNK_WEIGHT, so a hub vertex may be
+ * a chunk on its own.
+ * chunk i contains the vertices chunk_start[i]..chunk_start[i+1].
+ * returns the chunk_start array of size n_chunks + 1 or NULL on failure.
+ */
+static vert_t *vertex_chunks(const graph *G, size_t *n_chunks) {
+	// the work of the vertices up to v is csc_col_id[v] + v, so the chunks need
+	// at most that many entries in total
+	size_t max_chunks = ((size_t) G->csc_col_id[G->n_verts] + G->n_verts) / P_CHUNK_WEIGHT + 1;
+
+	vert_t *chunk_start = (vert_t *) malloc((max_chunks + 1) * sizeof(vert_t));
+	if(chunk_start == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return NULL;
+	}
+
+	*n_chunks = 0;
+	vert_t start = 0;
+	while(start < G->n_verts) {
+		chunk_start[(*n_chunks)++] = start;
+
+		// binary search for the first vertex where the work since start reaches P_CHUNK_WEIGHT
+		uint64_t target = (uint64_t) G->csc_col_id[start] + start + P_CHUNK_WEIGHT;
+		vert_t lo = start + 1;
+		vert_t hi = G->n_verts;
+		while(lo < hi) {
+			vert_t mid = lo + (hi - lo) / 2;
+			if((uint64_t) G->csc_col_id[mid] + mid < target) lo = mid + 1;
+			else hi = mid;
+		}
+
+		start = lo;
+	}
+	chunk_start[*n_chunks] = G->n_verts;
+
+	return chunk_start;
+}
+
+
+/* frontier_buffer collects the vertices a thread appends to the next frontier.
+ *
+ * the vertices are copied to next when the buffer is full, so that the shared
+ * n_next counter is not updated for every vertex.
+ */
+struct frontier_buffer {
+	vert_t verts[P_FRONTIER_BUFFER];
+	size_t len;
+
+};
+
+// Copies the vertices of the buffer to the end of next
+static void frontier_flush(struct frontier_buffer *buffer, vert_t *next, size_t *n_next) {
+	if(buffer->len == 0) return;
+
+	size_t pos = __atomic_fetch_add(n_next, buffer->len, __ATOMIC_RELAXED);
+	memcpy(next + pos, buffer->verts, buffer->len * sizeof(vert_t));
+	buffer->len = 0;
+}
+
+// Appends v to the next frontier through the buffer
+static inline void frontier_push(struct frontier_buffer *buffer, vert_t v, vert_t *next, size_t *n_next) {
+	if(buffer->len == P_FRONTIER_BUFFER) frontier_flush(buffer, next, n_next);
+	buffer->verts[buffer->len++] = v;
+}
+
+// Returns the number of frontier vertices in a chunk, so that a chunk has about P_CHUNK_WEIGHT work
+static size_t frontier_chunk_len(const graph *G) {
+	size_t vert_work = (G->n_verts > 0)? (G->n_edges + G->n_verts) / G->n_verts : 1;
+	return (P_CHUNK_WEIGHT / vert_work > 0)? P_CHUNK_WEIGHT / vert_work : 1;
+}
 
 
 /* This function is meant to be executed inside a thread.
@@ -73,158 +331,490 @@ struct init_colors_args {
 }
 
 
-/* This function is meant to be executed inside a thread.
+/* color_buckets_args holds the arguments of the phases that group the active vertices
+ * by color, with a parallel counting sort.
  *
- * it initializes the unique_colors array between vertices start and end
- * it appends all unique colors to the unique_colors array;
+ * each thread is responsible for the vertices between start and end. bucket_pos[c]
+ * first counts the vertices of color c, then it becomes the position where the next
+ * vertex of color c is written in color_verts. the vertices of each color end up
+ * contiguous in color_verts, in its bucket.
  */
-struct init_unique_colors_args {
+struct color_buckets_args {
 	vert_t start;
 	vert_t end;
 
-	bool *is_vertex;
-	vert_t *colors;
+	const vertex_set *is_vertex;
+	const vert_t *colors;
+
+	vert_t *bucket_pos;
 
+	size_t n_colors_thd;
+	size_t colors_offset;
 	vert_t *unique_colors;
-	size_t *n_colors;
 
-	pthread_mutex_t *n_colors_lock;
+	vert_t *color_verts;
 
-}; static void *p_init_unique_colors(void *args) {
-	struct init_unique_colors_args *iucargs = (struct init_unique_colors_args *)args;
+};
 
-	// loop over all vertices between start and end
-	for(vert_t v = iucargs->start ; v < iucargs->end ; ++v) {
-		// from the way colors was initialized, the unique colors are 
-		// those of the vertices v such that colors[v] = v, then c := v.
-		// we append c to the unique_colors array
-		if(iucargs->is_vertex[v] && iucargs->colors[v] == v) {
-			// n_colors is shared between the threads so we need a mutex to protect it.
-			// this won't hinder performance too much since the unique colors are generally
-			// much fewer than the vertices.
-			pthread_mutex_lock(iucargs->n_colors_lock);
-			iucargs->unique_colors[(*(iucargs->n_colors))++] = v;
-			pthread_mutex_unlock(iucargs->n_colors_lock);
+/* This function is meant to be executed inside a thread.
+ *
+ * it counts the vertices of each color in bucket_pos, and the unique colors in n_colors_thd.
+ */
+static void *p_count_colors(void *args) {
+	struct color_buckets_args *cbargs = (struct color_buckets_args *) args;
+
+	cbargs->n_colors_thd = 0;
+
+	// consecutive vertices usually have the same color, so the vertices are counted
+	// in runs of the same color and each run is added atomically to bucket_pos
+	vert_t run_color = 0;
+	vert_t run_length = 0;
+
+	// loop over all active vertices between start and end
+	for(vert_t v = next_active_vertex(cbargs->start, cbargs->end, cbargs->is_vertex) ; v < cbargs->end ;
+			v = next_active_vertex(v + 1, cbargs->end, cbargs->is_vertex)) {
+		vert_t c = cbargs->colors[v];
+		if(c != run_color && run_length > 0) {
+			__atomic_fetch_add(&cbargs->bucket_pos[run_color], run_length, __ATOMIC_RELAXED);
+			run_length = 0;
 		}
+
+		run_color = c;
+		run_length += 1;
+
+		// from the way colors was initialized, the unique colors are
+		// those of the vertices v such that colors[v] = v
+		cbargs->n_colors_thd += (c == v);
+	}
+
+	if(run_length > 0) {
+		__atomic_fetch_add(&cbargs->bucket_pos[run_color], run_length, __ATOMIC_RELAXED);
 	}
 
 	return NULL;
 }
 
+/* This function is meant to be executed inside a thread.
+ *
+ * it writes the unique colors of its vertices in unique_colors, starting at colors_offset.
+ * the threads write disjoint parts of unique_colors, so no locking is needed and the
+ * colors end up in increasing order.
+ */
+static void *p_list_colors(void *args) {
+	struct color_buckets_args *cbargs = (struct color_buckets_args *) args;
+
+	size_t n_colors = cbargs->colors_offset;
+	for(vert_t v = next_active_vertex(cbargs->start, cbargs->end, cbargs->is_vertex) ; v < cbargs->end ;
+			v = next_active_vertex(v + 1, cbargs->end, cbargs->is_vertex)) {
+		if(cbargs->colors[v] == v) cbargs->unique_colors[n_colors++] = v;
+	}
+
+	return NULL;
+}
 
 /* This function is meant to be executed inside a thread.
  *
- * it performs one iteration of the trimming procedure for vertices between start and end,
- * meaning it removes all vertices with in-degree or out-degree of zero (excluding self loops).
+ * it places its vertices in the bucket of their color. the space of a run of vertices
+ * with the same color is reserved with a single atomic add on bucket_pos, then the run
+ * is walked again to write its vertices.
+ */
+static void *p_scatter_colors(void *args) {
+	struct color_buckets_args *cbargs = (struct color_buckets_args *) args;
+	const vertex_set *is_vertex = cbargs->is_vertex;
+
+	vert_t v = next_active_vertex(cbargs->start, cbargs->end, is_vertex);
+	while(v < cbargs->end) {
+		vert_t c = cbargs->colors[v];
+
+		// find the end of the run of color c that starts at v
+		vert_t run_end = v;
+		vert_t run_length = 0;
+		while(run_end < cbargs->end && cbargs->colors[run_end] == c) {
+			run_length += 1;
+			run_end = next_active_vertex(run_end + 1, cbargs->end, is_vertex);
+		}
+
+		vert_t pos = __atomic_fetch_add(&cbargs->bucket_pos[c], run_length, __ATOMIC_RELAXED);
+		for(; v != run_end ; v = next_active_vertex(v + 1, cbargs->end, is_vertex)) {
+			cbargs->color_verts[pos++] = v;
+		}
+	}
+
+	return NULL;
+}
+
+/* Groups the active vertices of G by color in contiguous buckets
+ *
+ * unique_colors is set to the n_colors colors in increasing order, and the vertices of
+ * unique_colors[i] are color_verts[bucket_start[i]..bucket_start[i + 1]). the arrays are
+ * allocated here and should be freed by the caller.
+ * returns n_colors or -1 on failure.
+ */
+static ssize_t p_color_buckets(const graph *G, const vertex_set *is_vertex, size_t n_active_verts,
+		const vert_t *colors, struct thread_pool *pool,
+		vert_t **unique_colors, vert_t **bucket_start, vert_t **color_verts) {
+	int num_threads = pool->num_threads;
+
+	vert_t *bucket_pos = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+	*color_verts = (vert_t *) malloc(n_active_verts * sizeof(vert_t));
+	if(bucket_pos == NULL || *color_verts == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(bucket_pos);
+		free(*color_verts);
+		return -1;
+	}
+
+	size_t p_block_size = G->n_verts / num_threads;
+
+	struct color_buckets_args cbargs[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		cbargs[i].start = i * p_block_size;
+		cbargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+
+		cbargs[i].is_vertex = is_vertex;
+		cbargs[i].colors = colors;
+
+		cbargs[i].bucket_pos = bucket_pos;
+		cbargs[i].color_verts = *color_verts;
+	}
+	thread_pool_run(pool, p_count_colors, cbargs, sizeof(cbargs[0]));
+
+	// each thread writes its unique colors after the ones of the previous threads
+	size_t n_colors = 0;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		cbargs[i].colors_offset = n_colors;
+		n_colors += cbargs[i].n_colors_thd;
+	}
+
+	*unique_colors = (vert_t *) malloc(n_colors * sizeof(vert_t));
+	*bucket_start = (vert_t *) malloc((n_colors + 1) * sizeof(vert_t));
+	if(*unique_colors == NULL || *bucket_start == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(bucket_pos);
+		free(*color_verts);
+		free(*unique_colors);
+		free(*bucket_start);
+		return -1;
+	}
+
+	for(int i = 0 ; i < num_threads ; ++i) cbargs[i].unique_colors = *unique_colors;
+	thread_pool_run(pool, p_list_colors, cbargs, sizeof(cbargs[0]));
+
+	// the buckets are placed in the order of the colors, the cumulative sum of their
+	// sizes gives where each one starts
+	vert_t pos = 0;
+	for(size_t i = 0 ; i < n_colors ; ++i) {
+		vert_t c = (*unique_colors)[i];
+		vert_t size = bucket_pos[c];
+
+		(*bucket_start)[i] = pos;
+		bucket_pos[c] = pos;
+		pos += size;
+	}
+	(*bucket_start)[n_colors] = pos;
+
+	thread_pool_run(pool, p_scatter_colors, cbargs, sizeof(cbargs[0]));
+
+	free(bucket_pos);
+
+	return n_colors;
+}
+
+
+/* trim_args holds the arguments of the phases of the trimming procedure.
+ *
+ * in_degree and out_degree hold the number of active predecessors and successors of
+ * each active vertex (not counting self loops). the phases that work on blocks of
+ * vertices use start and end, and the ones that work on the frontier take chunks of
+ * chunk_len vertices from the work queues. removed vertices are appended to next.
  */
-struct trimming_args {
+struct trim_args {
+	int thread_id;
+	int num_threads;
+
 	vert_t start;
 	vert_t end;
 
+	struct work_queue *queues;
+	size_t chunk_len;
+
+	const vert_t *frontier;
+	size_t n_frontier;
+
 	const graph *G;
-	bool *is_vertex;
+	vertex_set *is_vertex;
 
 	vert_t **scc_id;
 	size_t n_scc_thd;
 
-}; static void *p_trimming(void *args) {
-	struct trimming_args *trargs = (struct trimming_args *) args;
+	vert_t *in_degree;
+	vert_t *out_degree;
+
+	vert_t *next;
+	size_t *n_next;
+
+};
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it counts the active predecessors and successors of the vertices between start and end
+ */
+static void *p_trim_degrees(void *args) {
+	struct trim_args *trargs = (struct trim_args *) args;
+
+	for(vert_t v = next_active_vertex(trargs->start, trargs->end, trargs->is_vertex) ; v < trargs->end ;
+			v = next_active_vertex(v + 1, trargs->end, trargs->is_vertex)) {
+		trargs->in_degree[v] = active_degree(v, predecessors_span(v, trargs->G), trargs->is_vertex);
+		trargs->out_degree[v] = active_degree(v, neighbours_span(v, trargs->G), trargs->is_vertex);
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it removes the vertices between start and end with no active predecessors or successors,
+ * each one an scc on its own, and appends them to next.
+ */
+static void *p_trim_seed(void *args) {
+	struct trim_args *trargs = (struct trim_args *) args;
+	struct frontier_buffer buffer = { .len = 0 };
+
+	for(vert_t v = next_active_vertex_atomic(trargs->start, trargs->end, trargs->is_vertex) ; v < trargs->end ;
+			v = next_active_vertex_atomic(v + 1, trargs->end, trargs->is_vertex)) {
+		if(trargs->in_degree[v] == 0 || trargs->out_degree[v] == 0) {
+			(*(trargs->scc_id))[v] = v;
+
+			// the blocks of the threads may share a word of is_vertex
+			atomic_remove_vertex(v, trargs->is_vertex);
+			frontier_push(&buffer, v, trargs->next, trargs->n_next);
+		}
+	}
+
+	frontier_flush(&buffer, trargs->next, trargs->n_next);
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it performs one round of Trim-1 on the chunks of the frontier, which holds removed
+ * vertices. each of them decreases the in_degree of its successors and the out_degree of
+ * its predecessors, and the vertices whose degree drops to zero are removed and appended
+ * to next. a vertex may reach zero from both sides at once, so the thread whose
+ * atomic_remove_vertex removes it is the one that appends it.
+ */
+static void *p_trim_frontier(void *args) {
+	struct trim_args *trargs = (struct trim_args *) args;
+	struct frontier_buffer buffer = { .len = 0 };
+
+	size_t chunk;
+	while(work_queue_next(trargs->queues, trargs->num_threads, trargs->thread_id, &chunk)) {
+		size_t start = chunk * trargs->chunk_len;
+		size_t end = (start + trargs->chunk_len < trargs->n_frontier)? start + trargs->chunk_len : trargs->n_frontier;
+
+		for(size_t i = start ; i < end ; ++i) {
+			vert_t v = trargs->frontier[i];
+
+			adj_span neighbours = neighbours_span(v, trargs->G);
+			adj_iter neighbours_it = adj_begin(neighbours);
+			for(size_t j = 0 ; j < neighbours.len ; ++j) {
+				vert_t w = adj_next(&neighbours_it);
+				if(w == v || !is_active_vertex_atomic(w, trargs->is_vertex)) continue;
+
+				if(__atomic_sub_fetch(&trargs->in_degree[w], 1, __ATOMIC_RELAXED) == 0 &&
+						atomic_remove_vertex(w, trargs->is_vertex)) {
+					(*(trargs->scc_id))[w] = w;
+					frontier_push(&buffer, w, trargs->next, trargs->n_next);
+				}
+			}
+
+			adj_span predecessors = predecessors_span(v, trargs->G);
+			adj_iter predecessors_it = adj_begin(predecessors);
+			for(size_t j = 0 ; j < predecessors.len ; ++j) {
+				vert_t u = adj_next(&predecessors_it);
+				if(u == v || !is_active_vertex_atomic(u, trargs->is_vertex)) continue;
+
+				if(__atomic_sub_fetch(&trargs->out_degree[u], 1, __ATOMIC_RELAXED) == 0 &&
+						atomic_remove_vertex(u, trargs->is_vertex)) {
+					(*(trargs->scc_id))[u] = u;
+					frontier_push(&buffer, u, trargs->next, trargs->n_next);
+				}
+			}
+		}
+	}
+
+	frontier_flush(&buffer, trargs->next, trargs->n_next);
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it performs Trim-2 on the vertices between start and end, removing the SCCs of two
+ * vertices and appending both vertices to next. the degrees do not change during this
+ * phase and the pairs are disjoint, so each pair is found by a single thread.
+ */
+static void *p_trim_pairs(void *args) {
+	struct trim_args *trargs = (struct trim_args *) args;
+	struct frontier_buffer buffer = { .len = 0 };
 
-	// n_scc_thd holds the number of sccs that were found in this thread
-	// this will be added to n_scc after the thread is joined with the 
-	// main thread.
 	trargs->n_scc_thd = 0;
 
-	// loop over all vertices between start and end
-	for(vert_t v = trargs->start ; v < trargs->end ; ++v) {
-		// check if the vertex is active, and then if it is trivial
-		if(trargs->is_vertex[v] && is_trivial_scc(v, trargs->G, trargs->is_vertex)) {
-			// if it is, set scc_id for the vertex to be itself
-			// and increase the number of sccs
+	for(vert_t v = next_active_vertex_atomic(trargs->start, trargs->end, trargs->is_vertex) ; v < trargs->end ;
+			v = next_active_vertex_atomic(v + 1, trargs->end, trargs->is_vertex)) {
+		vert_t u;
+		if(is_trivial_pair(v, trargs->G, trargs->is_vertex, trargs->in_degree, trargs->out_degree, &u, true)) {
 			(*(trargs->scc_id))[v] = v;
-			trargs->n_scc_thd += 1;
+			(*(trargs->scc_id))[u] = v;
 
-			// finally remove the vertex from the graph
-			trargs->is_vertex[v] = false;
+			atomic_remove_vertex(v, trargs->is_vertex);
+			atomic_remove_vertex(u, trargs->is_vertex);
+			frontier_push(&buffer, v, trargs->next, trargs->n_next);
+			frontier_push(&buffer, u, trargs->next, trargs->n_next);
+
+			trargs->n_scc_thd += 1;
 		}
 	}
 
+	frontier_flush(&buffer, trargs->next, trargs->n_next);
+
 	return NULL;
 }
 
 
 /* This function is meant to be executed inside a thread.
  *
- * it performs one iteration of the coloring procedure for vertices between start and end,
- * meaning for each vertex it sets its color as the minimum of the colors of its immediate
- * predecessors (or itself).
+ * it performs one round of the coloring procedure for the chunks of the frontier in the
+ * work queues, meaning for each vertex it sets its color as the minimum of the colors
+ * of its immediate predecessors (or itself). the successors of the vertices that changed
+ * color are appended to next, since only they may change color in the following round.
+ * if frontier is NULL the frontier contains every vertex and the chunks are given by
+ * chunk_start, otherwise chunk i contains frontier[i * chunk_len]..frontier[(i + 1) * chunk_len].
+ * first_round is true in the first round of the coloring, when next is still being filled.
+ * n_edges_thd is set to the number of edges scanned by the thread.
  */
-struct coloring_args {
-	vert_t start;
-	vert_t end;
+struct propagate_colors_args {
+	int thread_id;
+	int num_threads;
 
-	const graph *G;
-	bool *is_vertex;
+	struct work_queue *queues;
+	const vert_t *chunk_start;
+	size_t chunk_len;
 
-	bool *changed_color;
+	const vert_t *frontier;
+	size_t n_frontier;
+	bool first_round;
+
+	const graph *G;
+	vertex_set *is_vertex;
 
 	vert_t *colors;
 
-}; static void *p_coloring(void *args) {
-	struct coloring_args *colargs = (struct coloring_args *) args;
+	vert_t *next;
+	size_t *n_next;
+	uint8_t *in_next;
+
+	size_t n_edges_thd;
+
+}; static void *p_propagate_colors(void *args) {
+	struct propagate_colors_args *pcargs = (struct propagate_colors_args *) args;
+
+	struct frontier_buffer buffer = { .len = 0 };
+	size_t n_edges = 0;
+
+	// take chunks of the frontier from the work queues until all of them are done
+	size_t chunk;
+	while(work_queue_next(pcargs->queues, pcargs->num_threads, pcargs->thread_id, &chunk)) {
+		size_t start, end;
+		if(pcargs->frontier == NULL) {
+			start = pcargs->chunk_start[chunk];
+			end = pcargs->chunk_start[chunk + 1];
+		} else {
+			start = chunk * pcargs->chunk_len;
+			end = (start + pcargs->chunk_len < pcargs->n_frontier)? start + pcargs->chunk_len : pcargs->n_frontier;
+		}
+
+		for(size_t i = start ; i < end ; ++i) {
+			// a vertex taken from the frontier may be added to next again,
+			// but in the first round next may already contain it.
+			// in_next[v] is cleared before the colors of the predecessors are read, and
+			// a thread that lowers one of them sets in_next[v] after it, so either this
+			// thread sees the new color or v is appended to next again
+			vert_t v = (pcargs->frontier == NULL)? i : pcargs->frontier[i];
+			if(!pcargs->first_round) __atomic_exchange_n(&pcargs->in_next[v], 0, __ATOMIC_SEQ_CST);
 
-	// we loop over all the vertives v in the graph between start and end (checking if v is active)
-	for(vert_t v = colargs->start ; v < colargs->end ; ++v) {
-		if(colargs->is_vertex[v]) {
+			if(!is_active_vertex(v, pcargs->is_vertex)) continue;
 
 			// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
 			// because we want to write in one memory position (colors[v])
-			// as opposed to every u for each v. this is useful for 
-			// the parallelization since the memory locations that 
-			// the treads write to will not interfere with each other.
-
-			vert_t *predecessors;
-			ssize_t n_predecessors = get_predecessors(v, colargs->G, colargs->is_vertex, &predecessors);
-
-			if(n_predecessors > 0) {
-				// then we set colors[v] to be the minimum of its predecessors (or itself)
-				for(size_t i = 0 ; i < n_predecessors ; ++i) {
-					vert_t u = predecessors[i];
-					if(colargs->colors[v] > colargs->colors[u]) {
-						colargs->colors[v] = colargs->colors[u];
-						*(colargs->changed_color) = true;
-					}
+			// as opposed to every u for each v. this way only the thread
+			// that has v in its chunk writes to colors[v].
+			adj_span predecessors = predecessors_span(v, pcargs->G);
+			vert_t old_color = __atomic_load_n(&pcargs->colors[v], __ATOMIC_RELAXED);
+			vert_t color = min_active_color(predecessors, pcargs->is_vertex, pcargs->colors, old_color);
+			n_edges += predecessors.len;
+
+			if(color == old_color) continue;
+			__atomic_store_n(&pcargs->colors[v], color, __ATOMIC_RELAXED);
+
+			// the successors of v with a larger color may now change color as well
+			adj_span neighbours = neighbours_span(v, pcargs->G);
+			adj_iter neighbours_it = adj_begin(neighbours);
+			n_edges += neighbours.len;
+			for(size_t j = 0 ; j < neighbours.len ; ++j) {
+				vert_t w = adj_next(&neighbours_it);
+				if(!is_active_vertex(w, pcargs->is_vertex) ||
+						__atomic_load_n(&pcargs->colors[w], __ATOMIC_RELAXED) <= color) continue;
+
+				// only the thread that sets in_next[w] appends w to next
+				if(__atomic_exchange_n(&pcargs->in_next[w], 1, __ATOMIC_SEQ_CST) == 0) {
+					frontier_push(&buffer, w, pcargs->next, pcargs->n_next);
 				}
-
-				free(predecessors);
 			}
-
 		}
 	}
 
+	frontier_flush(&buffer, pcargs->next, pcargs->n_next);
+	pcargs->n_edges_thd = n_edges;
+
 	return NULL;
 }
 
 
 /* This function is meant to be executed inside a thread.
  *
- * it finds the scc starting from root c for all c in unique colors between start and end,
- * meaing it berforms backward BFS on the subgraph of G that contains the vertices of color c
- * and returns all the vertices reached (the new SCC). it then saves the SCC and removes
- * all vertices of the subgraph from G.
+ * it finds the scc starting from root c for all c in the chunks of unique colors in the
+ * work queues, meaing it berforms backward BFS on the subgraph of G that contains the
+ * vertices of color c and returns all the vertices reached (the new SCC). it then saves
+ * the SCC and removes all vertices of the subgraph from G.
+ *
+ * the vertices of color unique_colors[i] are color_verts[bucket_start[i]..bucket_start[i + 1]).
+ * the SCC is saved by walking the bucket, which is mostly in increasing order, instead of
+ * the bfs result, so the writes to scc_id and is_vertex are close to each other.
+ * the colors with P_BFS_THRESHOLD or more vertices are skipped, they are done by p_large_color_scc.
  */
 struct get_sccs_args {
-	size_t start;
-	size_t end;
+	int thread_id;
+	int num_threads;
+
+	struct work_queue *queues;
+	const size_t *chunk_start;
 
 	size_t n_scc_thd;
 	size_t n_vert_removed_thd;
 
 	const graph *G;
-	bool *is_vertex;
+	vertex_set *is_vertex;
 
 	vert_t *colors;
 	vert_t *unique_colors;
+	const vert_t *bucket_start;
+	const vert_t *color_verts;
+
+	bfs_workspace *ws;
 
 	vert_t **scc_id;
 
@@ -237,30 +827,53 @@ struct get_sccs_args {
 	sccargs->n_scc_thd = 0;
 	sccargs->n_vert_removed_thd = 0;
 
-	// then loop over all the unique colors c between start and end
-	for(size_t i = sccargs->start ; i < sccargs->end ; ++i) {
-		vert_t c = sccargs->unique_colors[i];
+	// take chunks of unique colors from the work queues until all of them are done
+	size_t chunk;
+	while(work_queue_next(sccargs->queues, sccargs->num_threads, sccargs->thread_id, &chunk)) {
 
-		// perform a backward bfs on the subgraph of G where colors[v] = c
-		// these create a new scc
-		vert_t *scc_c;
-		ssize_t n_scc_c = backward_bfs(c, sccargs->G, c, sccargs->colors, sccargs->is_vertex, &scc_c);
+		// then loop over all the unique colors c in the chunk
+		for(size_t i = sccargs->chunk_start[chunk] ; i < sccargs->chunk_start[chunk + 1] ; ++i) {
+			vert_t c = sccargs->unique_colors[i];
+			const vert_t *bucket = sccargs->color_verts + sccargs->bucket_start[i];
+			vert_t bucket_size = sccargs->bucket_start[i + 1] - sccargs->bucket_start[i];
 
-		if(n_scc_c > 0) {
-			// for each vertex in the new scc set scc_id = c and increase n_scc
-			for(size_t j = 0 ; j < n_scc_c ; ++j) {
-				vert_t v = scc_c[j];
-				(*(sccargs->scc_id))[v] = c;
+			if(bucket_size >= P_BFS_THRESHOLD) continue;
 
-				// finally remove the vertices from the graph
-				sccargs->is_vertex[v] = false;
+			// a color with a single vertex is an SCC on its own, no bfs is needed
+			if(bucket_size == 1) {
+				(*(sccargs->scc_id))[c] = c;
+				atomic_remove_vertex(c, sccargs->is_vertex);
+
+				sccargs->n_vert_removed_thd += 1;
+				sccargs->n_scc_thd += 1;
+				continue;
 			}
 
-			// each unique color corresponds to one SCC and removes n_scc_c vertices
-			sccargs->n_vert_removed_thd += n_scc_c;
-			sccargs->n_scc_thd += 1;
+			// perform a backward bfs on the subgraph of G where colors[v] = c
+			// these create a new scc
+			const vert_t *scc_c;
+			ssize_t n_scc_c = backward_bfs_ws(c, sccargs->G, c, sccargs->colors, sccargs->is_vertex, sccargs->ws, &scc_c);
+
+			if(n_scc_c > 0) {
+				// the vertices of the bucket visited by the bfs are the new scc.
+				// for each of them set scc_id = c
+				uint16_t epoch = sccargs->ws->epoch;
+				const uint16_t *visited = sccargs->ws->visited;
+				for(vert_t j = 0 ; j < bucket_size ; ++j) {
+					vert_t v = bucket[j];
+					if(n_scc_c < bucket_size && visited[v] != epoch) continue;
+
+					(*(sccargs->scc_id))[v] = c;
+
+					// finally remove the vertices from the graph. other threads may be
+					// removing vertices of the same word of is_vertex
+					atomic_remove_vertex(v, sccargs->is_vertex);
+				}
 
-			free(scc_c);
+				// each unique color corresponds to one SCC and removes n_scc_c vertices
+				sccargs->n_vert_removed_thd += n_scc_c;
+				sccargs->n_scc_thd += 1;
+			}
 		}
 	}
 
@@ -268,77 +881,656 @@ struct get_sccs_args {
 }
 
 
-/* Implements the graph coloring algorithm to find the SCCs of G
- *
- * takes as input the graph G and a double pointer where the result will 
- * be stored. returns the number of sccs.
+/* This function is meant to be executed inside a thread.
  *
- * scc_id is of size n_verts
- * if v belongs to the scc with id c then: scc_id[v] = c
+ * it finds the active vertex between start and end with the largest product
+ * of in-degree and out-degree, which is the best candidate pivot of the block.
  */
-ssize_t p_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
+struct choose_pivot_args {
+	vert_t start;
+	vert_t end;
 
-	// create num_threads threads
-	pthread_t threads[num_threads];
+	const graph *G;
+	vertex_set *is_vertex;
 
-	// the block size refers to the number of vertices that each thread will be responsible for.
-	size_t p_block_size = G->n_verts / num_threads;
-	
-	// allocate the memory required for the is_vertex array
-	bool *is_vertex = (bool *) malloc(G->n_verts * sizeof(bool));
-	if(is_vertex == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-		return -1;
-	}
+	vert_t pivot;
+	uint64_t pivot_score;
+	bool found_pivot;
 
-	// initialize the is_vertex array in parallel
-	struct init_vertex_args ivargs[num_threads];
-	for(int i = 0 ; i < num_threads ; ++i) {
-		ivargs[i].start = i * p_block_size;
-		ivargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
-		ivargs[i].is_vertex = is_vertex;
+}; static void *p_choose_pivot(void *args) {
+	struct choose_pivot_args *cpargs = (struct choose_pivot_args *) args;
 
-		pthread_create(&threads[i], NULL, p_init_is_vertex, &ivargs[i]);
-	} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
-	
-	// initialize n_active_verts to n_verts
-	size_t n_active_verts = G->n_verts;
+	cpargs->found_pivot = false;
 
-	// allocate the memory required for the scc_id array
-	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
-	if(*scc_id == NULL) {
-		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+	for(vert_t v = next_active_vertex(cpargs->start, cpargs->end, cpargs->is_vertex) ; v < cpargs->end ;
+			v = next_active_vertex(v + 1, cpargs->end, cpargs->is_vertex)) {
+		adj_span neighbours = neighbours_span(v, cpargs->G);
+		adj_span predecessors = predecessors_span(v, cpargs->G);
 
-		free(is_vertex);
-		return -1;
+		uint64_t score = (uint64_t) neighbours.len * predecessors.len;
+		if(!cpargs->found_pivot || score > cpargs->pivot_score) {
+			cpargs->pivot = v;
+			cpargs->pivot_score = score;
+			cpargs->found_pivot = true;
+		}
 	}
 
-	// initialize n_sccs to 0
-	size_t n_scc = 0;
-	
-	// remove trivial sccs 
-	// the loop will run just twice since after that
-	// you get diminishing returns
-	for(uint8_t i = 0 ; i < 2 ; ++i) {
-		// perform one trimming iteration in parallel
-		struct trimming_args trargs[num_threads];
-		for(int i = 0 ; i < num_threads ; ++i) {
-			trargs[i].start = i * p_block_size;
-			trargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
-
-			trargs[i].G = G;
-			trargs[i].is_vertex = is_vertex;
+	return NULL;
+}
 
-			trargs[i].scc_id = scc_id;
-			
-			pthread_create(&threads[i], NULL, p_trimming, &trargs[i]);
-		} for(int i = 0 ; i < num_threads ; ++i) {
-			pthread_join(threads[i], NULL);
 
-			n_scc += trargs[i].n_scc_thd;
-			n_active_verts -= trargs[i].n_scc_thd;
+/* This function is meant to be executed inside a thread.
+ *
+ * it performs a forward or backward bfs from pivot on the active vertices of G,
+ * or nothing if search is NULL.
+ * this lets the forward and backward reach of the pivot be computed at the same time.
+ */
+struct reach_args {
+	vert_t pivot;
+
+	const graph *G;
+	vertex_set *is_vertex;
+
+	const vert_t *properties;
+
+	ssize_t (*search)(vert_t, const graph *, vert_t, const vert_t *, const vertex_set *, vert_t **);
+
+	vert_t *reach;
+	ssize_t n_reach;
+
+}; static void *p_reach(void *args) {
+	struct reach_args *rargs = (struct reach_args *) args;
+
+	// only two threads have a search to perform
+	if(rargs->search == NULL) return NULL;
+
+	// every vertex has the same property so the bfs visits all the active vertices
+	rargs->n_reach = (*rargs->search)(
+			rargs->pivot, rargs->G, 0, rargs->properties, rargs->is_vertex, &rargs->reach);
+
+	return NULL;
+}
+
+
+/* wcc_args holds the work of a thread in the phases that find the weakly connected
+ * components (WCCs) of G and decompose the small ones.
+ *
+ * parent is a union-find forest over the vertices, where the root of each tree is the
+ * smallest vertex of the component. the phases that go over all the vertices use start
+ * and end, while the linking phase takes the chunks of chunk_start from the work queues.
+ * the small components are decomposed with Tarjan's algorithm, each by a single thread,
+ * taking the chunks of comp_chunk_start from the work queues. component i has the
+ * vertices comp_verts[comp_start[i]]..comp_verts[comp_start[i+1]].
+ */
+struct wcc_args {
+	int thread_id;
+	int num_threads;
+
+	vert_t start;
+	vert_t end;
+
+	struct work_queue *queues;
+	const vert_t *chunk_start;
+
+	const graph *G;
+	vertex_set *is_vertex;
+
+	vert_t *parent;
+	vert_t *comp_size;
+
+	const vert_t *comp_verts;
+	const vert_t *comp_start;
+	const size_t *comp_chunk_start;
+
+	tarjan_workspace ws;
+
+	vert_t **scc_id;
+
+	size_t n_scc_thd;
+	size_t n_vert_removed_thd;
+
+};
+
+// comp_size of the roots of the components left to the parallel algorithms
+#define WCC_LARGE ((vert_t) -1)
+
+// Returns the root of the tree of v, halving the path to it on the way
+static inline vert_t wcc_find(vert_t *parent, vert_t v) {
+	vert_t p = __atomic_load_n(&parent[v], __ATOMIC_RELAXED);
+	while(p != v) {
+		// the parents only move closer to the root, so a concurrent update of
+		// parent[v] is at most replaced by another ancestor of v
+		vert_t grandparent = __atomic_load_n(&parent[p], __ATOMIC_RELAXED);
+		if(grandparent != p) __atomic_store_n(&parent[v], grandparent, __ATOMIC_RELAXED);
+
+		v = p;
+		p = grandparent;
+	}
+
+	return v;
+}
+
+// Merges the trees of u and v, linking the larger root below the smaller one
+static void wcc_union(vert_t *parent, vert_t u, vert_t v) {
+	while(true) {
+		u = wcc_find(parent, u);
+		v = wcc_find(parent, v);
+		if(u == v) return;
+
+		if(u < v) {
+			vert_t temp = u;
+			u = v;
+			v = temp;
 		}
+
+		// another thread may have linked u since it was found, in which case
+		// the roots are found again
+		vert_t expected = u;
+		if(__atomic_compare_exchange_n(&parent[u], &expected, v,
+					false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return;
+	}
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it makes every vertex between start and end a tree of its own
+ */
+static void *p_wcc_init(void *args) {
+	struct wcc_args *wargs = (struct wcc_args *) args;
+
+	for(vert_t v = wargs->start ; v < wargs->end ; ++v) {
+		wargs->parent[v] = v;
+		wargs->comp_size[v] = 0;
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it merges the trees of the active vertices in the chunks it takes from the work queues
+ * with the trees of their active predecessors.
+ */
+static void *p_wcc_link(void *args) {
+	struct wcc_args *wargs = (struct wcc_args *) args;
+
+	size_t chunk;
+	while(work_queue_next(wargs->queues, wargs->num_threads, wargs->thread_id, &chunk)) {
+		vert_t end = wargs->chunk_start[chunk + 1];
+
+		for(vert_t v = next_active_vertex(wargs->chunk_start[chunk], end, wargs->is_vertex) ; v < end ;
+				v = next_active_vertex(v + 1, end, wargs->is_vertex)) {
+			adj_span predecessors = predecessors_span(v, wargs->G);
+			adj_iter predecessors_it = adj_begin(predecessors);
+			for(size_t j = 0 ; j < predecessors.len ; ++j) {
+				vert_t u = adj_next(&predecessors_it);
+				if(u != v && is_active_vertex(u, wargs->is_vertex)) wcc_union(wargs->parent, u, v);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it points every active vertex between start and end directly to the root of its tree
+ * and counts the vertices of each component in comp_size of the root.
+ */
+static void *p_wcc_sizes(void *args) {
+	struct wcc_args *wargs = (struct wcc_args *) args;
+
+	for(vert_t v = next_active_vertex(wargs->start, wargs->end, wargs->is_vertex) ; v < wargs->end ;
+			v = next_active_vertex(v + 1, wargs->end, wargs->is_vertex)) {
+		vert_t root = wcc_find(wargs->parent, v);
+		__atomic_store_n(&wargs->parent[v], root, __ATOMIC_RELAXED);
+
+		__atomic_fetch_add(&wargs->comp_size[root], 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/* This function is meant to be executed inside a thread.
+ *
+ * it finds the SCCs of the small components in the chunks it takes from the work queues
+ * using Tarjan's algorithm, and removes their vertices from the graph.
+ */
+static void *p_wcc_tarjan(void *args) {
+	struct wcc_args *wargs = (struct wcc_args *) args;
+
+	wargs->n_scc_thd = 0;
+	wargs->n_vert_removed_thd = 0;
+
+	size_t chunk;
+	while(work_queue_next(wargs->queues, wargs->num_threads, wargs->thread_id, &chunk)) {
+		for(size_t i = wargs->comp_chunk_start[chunk] ; i < wargs->comp_chunk_start[chunk + 1] ; ++i) {
+			const vert_t *verts = wargs->comp_verts + wargs->comp_start[i];
+			size_t n_verts = wargs->comp_start[i + 1] - wargs->comp_start[i];
+
+			// every vertex of the component is a root, since the search from
+			// the first one may not reach all of them
+			wargs->n_scc_thd += tarjan_sccs(wargs->G, wargs->is_vertex, verts, n_verts,
+					&wargs->ws, *(wargs->scc_id));
+
+			// other threads may be removing vertices of the same word of is_vertex
+			for(size_t j = 0 ; j < n_verts ; ++j) atomic_remove_vertex(verts[j], wargs->is_vertex);
+			wargs->n_vert_removed_thd += n_verts;
+		}
+	}
+
+	return NULL;
+}
+
+
+// Runs the levels of a parallel BFS as one phase on the pool, whose size is num_threads
+static void thread_pool_run_bfs(void *(*task)(void *), void *args, size_t args_size, int num_threads, void *pool) {
+	thread_pool_run_task((struct thread_pool *) pool, task, "p_bfs_level", args, args_size);
+}
+
+/* Finds the SCC of color c using the parallel BFS
+ *
+ * this is used for the colors whose region is large, where a single thread
+ * would perform most of the work while the others are idle. the search runs
+ * on the threads of the pool.
+ * returns the number of vertices in the SCC or -1 on failure.
+ */
+static ssize_t p_large_color_scc(
+		vert_t c, const graph *G, vertex_set *is_vertex, const vert_t *colors, vert_t **scc_id, struct thread_pool *pool) {
+
+	// perform a backward bfs on the subgraph of G where colors[v] = c
+	// these create a new scc
+	vert_t *scc_c;
+	ssize_t n_scc_c = p_bfs_run(c, G, predecessors_span, c, colors, is_vertex, &scc_c,
+			pool->num_threads, thread_pool_run_bfs, pool);
+
+	if(n_scc_c > 0) {
+		// for each vertex in the new scc set scc_id = c
+		for(size_t j = 0 ; j < n_scc_c ; ++j) {
+			vert_t v = scc_c[j];
+			(*scc_id)[v] = c;
+
+			// finally remove the vertices from the graph
+			remove_vertex(v, is_vertex);
+		}
+
+		free(scc_c);
+	}
+
+	return n_scc_c;
+}
+
+
+/* Runs rounds of Trim-1 in parallel until no vertex is removed
+ *
+ * the *n_next vertices in *next have been removed but their neighbours have not been
+ * updated yet. frontier and next are swapped between the rounds.
+ * returns the number of vertices removed by the rounds.
+ */
+static size_t p_trim_rounds(struct thread_pool *pool, struct trim_args *trargs,
+		vert_t **frontier, vert_t **next, size_t *n_next) {
+	int num_threads = pool->num_threads;
+
+	size_t n_trimmed = 0;
+	while(*n_next > 0) {
+		// the next frontier becomes the current one
+		vert_t *temp = *frontier;
+		*frontier = *next;
+		*next = temp;
+
+		size_t n_frontier = *n_next;
+		*n_next = 0;
+
+		struct work_queue queues[num_threads];
+		work_queues_init(queues, num_threads, (n_frontier + trargs[0].chunk_len - 1) / trargs[0].chunk_len);
+
+		for(int i = 0 ; i < num_threads ; ++i) {
+			trargs[i].queues = queues;
+
+			trargs[i].frontier = *frontier;
+			trargs[i].n_frontier = n_frontier;
+
+			trargs[i].next = *next;
+		}
+		thread_pool_run(pool, p_trim_frontier, trargs, sizeof(trargs[0]));
+
+		n_trimmed += *n_next;
+	}
+
+	return n_trimmed;
+}
+
+/* Removes the trivial SCCs from G in parallel until none are left
+ *
+ * each vertex keeps the number of its active predecessors and successors (not counting
+ * self loops), so trimming to a fixpoint takes O(V + E) work in total instead of a sweep
+ * per iteration. the SCCs of two vertices are removed with Trim-2 after Trim-1 is done,
+ * and then Trim-1 continues from the vertices they leave trivial.
+ * *n_removed is set to the number of vertices removed.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t p_trim_trivial_sccs(
+		const graph *G, vertex_set *is_vertex, vert_t **scc_id, struct thread_pool *pool, size_t *n_removed) {
+	int num_threads = pool->num_threads;
+	double start = stats_phase_begin();
+
+	// the block size refers to the number of vertices that each thread will be responsible for.
+	size_t p_block_size = G->n_verts / num_threads;
+
+	vert_t *in_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *out_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *frontier = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *next = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(in_degree == NULL || out_degree == NULL || frontier == NULL || next == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(in_degree);
+		free(out_degree);
+		free(frontier);
+		free(next);
+		return -1;
+	}
+
+	size_t n_next = 0;
+
+	struct trim_args trargs[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		trargs[i].thread_id = i;
+		trargs[i].num_threads = num_threads;
+
+		trargs[i].start = i * p_block_size;
+		trargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+
+		trargs[i].chunk_len = frontier_chunk_len(G);
+
+		trargs[i].G = G;
+		trargs[i].is_vertex = is_vertex;
+
+		trargs[i].scc_id = scc_id;
+
+		trargs[i].in_degree = in_degree;
+		trargs[i].out_degree = out_degree;
+
+		trargs[i].next = next;
+		trargs[i].n_next = &n_next;
+	}
+
+	// count the degrees of all the active vertices first, so the vertices
+	// removed below are counted by their neighbours
+	thread_pool_run(pool, p_trim_degrees, trargs, sizeof(trargs[0]));
+
+	// the trivial vertices are each an scc on their own
+	thread_pool_run(pool, p_trim_seed, trargs, sizeof(trargs[0]));
+	size_t n_scc = n_next;
+
+	// Trim-1 until no trivial vertices are left
+	n_scc += p_trim_rounds(pool, trargs, &frontier, &next, &n_next);
+	*n_removed = n_scc;
+
+	// Trim-2, then Trim-1 on the vertices left behind
+	for(int i = 0 ; i < num_threads ; ++i) trargs[i].next = next;
+	thread_pool_run(pool, p_trim_pairs, trargs, sizeof(trargs[0]));
+	for(int i = 0 ; i < num_threads ; ++i) n_scc += trargs[i].n_scc_thd;
+	*n_removed += n_next;
+
+	size_t n_trimmed = p_trim_rounds(pool, trargs, &frontier, &next, &n_next);
+	n_scc += n_trimmed;
+	*n_removed += n_trimmed;
+
+	free(in_degree);
+	free(out_degree);
+	free(frontier);
+	free(next);
+
+	stats_count(STAT_TRIMMED, *n_removed);
+	stats_phase(PHASE_TRIM, start);
+
+	return n_scc;
+}
+
+
+/* Finds the SCCs of the small weakly connected components of G in parallel
+ *
+ * the SCCs never cross the WCCs, so each WCC can be decomposed on its own. the WCCs are
+ * found with a concurrent union-find over the edges of the active vertices. the ones with
+ * fewer than P_WCC_THRESHOLD vertices are decomposed in parallel, each by a single thread
+ * using Tarjan's algorithm, which is linear in the size of the component. the large ones
+ * are left in the graph for the parallel algorithms.
+ * *n_removed is set to the number of vertices removed.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t p_wcc_sccs(
+		const graph *G, vertex_set *is_vertex, vert_t **scc_id, struct thread_pool *pool, size_t *n_removed) {
+	int num_threads = pool->num_threads;
+	double start = stats_phase_begin();
+
+	// the block size refers to the number of vertices that each thread will be responsible for.
+	size_t p_block_size = G->n_verts / num_threads;
+
+	size_t n_vert_chunks;
+	vert_t *vert_chunk_start = vertex_chunks(G, &n_vert_chunks);
+	if(vert_chunk_start == NULL) return -1;
+
+	vert_t *parent = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *comp_size = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(parent == NULL || comp_size == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(vert_chunk_start);
+		free(parent);
+		free(comp_size);
+		return -1;
+	}
+
+	struct wcc_args wargs[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		wargs[i].thread_id = i;
+		wargs[i].num_threads = num_threads;
+
+		wargs[i].start = i * p_block_size;
+		wargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+
+		wargs[i].chunk_start = vert_chunk_start;
+
+		wargs[i].G = G;
+		wargs[i].is_vertex = is_vertex;
+
+		wargs[i].parent = parent;
+		wargs[i].comp_size = comp_size;
+
+		wargs[i].scc_id = scc_id;
+	}
+
+	// find the WCCs and the number of vertices in each of them
+	thread_pool_run(pool, p_wcc_init, wargs, sizeof(wargs[0]));
+
+	struct work_queue queues[num_threads];
+	work_queues_init(queues, num_threads, n_vert_chunks);
+	for(int i = 0 ; i < num_threads ; ++i) wargs[i].queues = queues;
+	thread_pool_run(pool, p_wcc_link, wargs, sizeof(wargs[0]));
+
+	thread_pool_run(pool, p_wcc_sizes, wargs, sizeof(wargs[0]));
+
+	free(vert_chunk_start);
+
+	// the vertices of the small components are grouped by component in comp_verts
+	vert_t *comp_verts = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *comp_start = (vert_t *) malloc((G->n_verts + 1) * sizeof(vert_t));
+	if(comp_verts == NULL || comp_start == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(parent);
+		free(comp_size);
+		free(comp_verts);
+		free(comp_start);
+		return -1;
+	}
+
+	// comp_size of the root of a small component becomes the position of its first vertex
+	// in comp_verts, and that of a large component is set to WCC_LARGE
+	size_t n_comps = 0;
+	vert_t n_comp_verts = 0;
+	vert_t max_comp_size = 0;
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		if(parent[v] != v) continue;
+
+		if(comp_size[v] >= P_WCC_THRESHOLD) {
+			comp_size[v] = WCC_LARGE;
+			continue;
+		}
+
+		if(comp_size[v] > max_comp_size) max_comp_size = comp_size[v];
+
+		comp_start[n_comps++] = n_comp_verts;
+		n_comp_verts += comp_size[v];
+		comp_size[v] = comp_start[n_comps - 1];
+	}
+	comp_start[n_comps] = n_comp_verts;
+
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		vert_t root = parent[v];
+		if(comp_size[root] != WCC_LARGE) comp_verts[comp_size[root]++] = v;
+	}
+
+	free(parent);
+	free(comp_size);
+
+	// the vertices searched by each thread are in the same component, so the stacks
+	// of a thread need at most max_comp_size entries
+	size_t *comp_chunk_start = (size_t *) malloc((n_comps + 1) * sizeof(size_t));
+	vert_t *index = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+	vert_t *low_link = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *scc_stack = (vert_t *) malloc(num_threads * max_comp_size * sizeof(vert_t));
+	vert_t *dfs_stack = (vert_t *) malloc(num_threads * max_comp_size * sizeof(vert_t));
+	adj_iter *dfs_iter = (adj_iter *) malloc(num_threads * max_comp_size * sizeof(adj_iter));
+	if(comp_chunk_start == NULL || index == NULL || low_link == NULL ||
+			scc_stack == NULL || dfs_stack == NULL || dfs_iter == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(comp_verts);
+		free(comp_start);
+		free(comp_chunk_start);
+		free(index);
+		free(low_link);
+		free(scc_stack);
+		free(dfs_stack);
+		free(dfs_iter);
+		return -1;
+	}
+
+	// split the small components in chunks of roughly equal work, weighting
+	// each component by the number of its vertices
+	size_t vert_work = (G->n_verts > 0)? (G->n_edges + G->n_verts) / G->n_verts : 1;
+
+	size_t n_comp_chunks = 0;
+	size_t chunk_work = 0;
+	for(size_t i = 0 ; i < n_comps ; ++i) {
+		if(chunk_work == 0) comp_chunk_start[n_comp_chunks++] = i;
+
+		chunk_work += (comp_start[i + 1] - comp_start[i]) * vert_work;
+		if(chunk_work >= P_CHUNK_WEIGHT) chunk_work = 0;
+	}
+	comp_chunk_start[n_comp_chunks] = n_comps;
+
+	// then decompose the small components in parallel
+	work_queues_init(queues, num_threads, n_comp_chunks);
+	for(int i = 0 ; i < num_threads ; ++i) {
+		wargs[i].comp_verts = comp_verts;
+		wargs[i].comp_start = comp_start;
+		wargs[i].comp_chunk_start = comp_chunk_start;
+
+		wargs[i].ws.index = index;
+		wargs[i].ws.low_link = low_link;
+		wargs[i].ws.scc_stack = scc_stack + i * max_comp_size;
+		wargs[i].ws.dfs_stack = dfs_stack + i * max_comp_size;
+		wargs[i].ws.dfs_iter = dfs_iter + i * max_comp_size;
+		wargs[i].ws.n_edges = 0;
+	}
+	thread_pool_run(pool, p_wcc_tarjan, wargs, sizeof(wargs[0]));
+
+	size_t n_scc = 0;
+	*n_removed = 0;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		n_scc += wargs[i].n_scc_thd;
+		*n_removed += wargs[i].n_vert_removed_thd;
+		stats_count(STAT_EDGES, wargs[i].ws.n_edges);
+	}
+
+	free(comp_verts);
+	free(comp_start);
+	free(comp_chunk_start);
+	free(index);
+	free(low_link);
+	free(scc_stack);
+	free(dfs_stack);
+	free(dfs_iter);
+
+	stats_phase(PHASE_COMPONENTS, start);
+
+	return n_scc;
+}
+
+
+// Frees the BFS workspaces of the threads, some of which may be NULL
+static void free_bfs_workspaces(bfs_workspace **workspaces, int num_threads) {
+	for(int i = 0 ; i < num_threads ; ++i) {
+		if(workspaces[i] != NULL) free_bfs_workspace(workspaces[i]);
 	}
+}
+
+/* Finds the SCCs of the active vertices of G using the graph coloring algorithm in parallel
+ *
+ * n_active_verts is the number of active vertices in is_vertex.
+ * at the end all the vertices have been removed from the graph.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t p_coloring_sccs(
+		const graph *G, vertex_set *is_vertex, size_t n_active_verts, vert_t **scc_id, struct thread_pool *pool) {
+	int num_threads = pool->num_threads;
+
+	// the block size refers to the number of vertices that each thread will be responsible for.
+	size_t p_block_size = G->n_verts / num_threads;
+
+	// the coloring iterations take chunks of vertices of equal work from the work queues
+	size_t n_vert_chunks;
+	vert_t *vert_chunk_start = vertex_chunks(G, &n_vert_chunks);
+	if(vert_chunk_start == NULL) return -1;
+
+	// the average work of a vertex, used to weight the chunks of colors by their size
+	size_t vert_work = (G->n_verts > 0)? (G->n_edges + G->n_verts) / G->n_verts : 1;
+	size_t chunk_len = frontier_chunk_len(G);
+
+	// the colors are propagated using a worklist. frontier holds the vertices whose color
+	// may change in the current round and next the ones for the following round.
+	// in_next[v] is set when v is already in next, so that it is added only once.
+	vert_t *frontier = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *next = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	uint8_t *in_next = (uint8_t *) calloc(G->n_verts, sizeof(uint8_t));
+
+	// every thread reuses its own workspace for the bfs of all its colors.
+	// the other threads remove the sccs they find during the searches
+	bfs_workspace *workspaces[num_threads];
+	bool workspaces_ok = true;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		workspaces[i] = new_bfs_workspace(G->n_verts);
+		if(workspaces[i] != NULL) workspaces[i]->shared = true;
+		workspaces_ok = workspaces_ok && (workspaces[i] != NULL);
+	}
+
+	if(frontier == NULL || next == NULL || in_next == NULL || !workspaces_ok) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(vert_chunk_start);
+		free(frontier);
+		free(next);
+		free(in_next);
+		free_bfs_workspaces(workspaces, num_threads);
+		return -1;
+	}
+
+	size_t n_scc = 0;
 
 	// the core loop of the algorithm
 	// this will run as long as G is non empty
@@ -348,8 +1540,11 @@ ssize_t p_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 		if(colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
-			free(*scc_id);
+			free(vert_chunk_start);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free_bfs_workspaces(workspaces, num_threads);
 			return -1;
 		}
 
@@ -359,96 +1554,473 @@ ssize_t p_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
 			icargs[i].start = i * p_block_size;
 			icargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
 			icargs[i].colors = colors;
-			pthread_create(&threads[i], NULL, p_init_colors, &icargs[i]);
+		}
+		thread_pool_run(pool, p_init_colors, icargs, sizeof(icargs[0]));
+
+		double start = stats_phase_begin();
+
+		// in the first round every active vertex is in the frontier. after that only the
+		// successors of the vertices that changed color in the last round can change color,
+		// so each round does work proportional to the frontier instead of the whole graph.
+		// when few vertices are left the first frontier is the list of the active vertices,
+		// otherwise it is every vertex and the removed ones are skipped.
+		bool first_round = true;
+		bool all_verts = (n_active_verts * VERTEX_SET_SPARSE >= G->n_verts);
+		size_t n_frontier = all_verts ? G->n_verts : compact_vertex_set(is_vertex, frontier);
+		while(n_frontier > 0) {
+			size_t n_next = 0;
+
+			struct work_queue queues[num_threads];
+			if(all_verts) work_queues_init(queues, num_threads, n_vert_chunks);
+			else work_queues_init(queues, num_threads, (n_frontier + chunk_len - 1) / chunk_len);
+
+			struct propagate_colors_args pcargs[num_threads];
+			for(int i = 0 ; i < num_threads ; ++i) {
+				pcargs[i].thread_id = i;
+				pcargs[i].num_threads = num_threads;
 
-		} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
+				pcargs[i].queues = queues;
+				pcargs[i].chunk_start = vert_chunk_start;
+				pcargs[i].chunk_len = chunk_len;
 
-		// this loop will run as long as at least one vertex changed colors in
-		// the last iteration since a vertex changing color might end up changing
-		// the color of its neighbours in the next iteration.
-		bool changed_color = true;
-		while(changed_color) {
-			changed_color = false;
+				pcargs[i].frontier = all_verts ? NULL : frontier;
+				pcargs[i].n_frontier = n_frontier;
+				pcargs[i].first_round = first_round;
 
-			struct coloring_args colargs[num_threads];
-			for(int i = 0 ; i < num_threads ; ++i) {
-				colargs[i].start = i * p_block_size;
-				colargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+				pcargs[i].G = G;
+				pcargs[i].is_vertex = is_vertex;
 
-				colargs[i].G = G;
-				colargs[i].is_vertex = is_vertex;
+				pcargs[i].colors = colors;
 
-				colargs[i].changed_color = &changed_color;
+				pcargs[i].next = next;
+				pcargs[i].n_next = &n_next;
+				pcargs[i].in_next = in_next;
 
-				colargs[i].colors = colors;
+			}
+			thread_pool_run(pool, p_propagate_colors, pcargs, sizeof(pcargs[0]));
 
-				pthread_create(&threads[i], NULL, p_coloring, &colargs[i]);
-			} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
-		}
+			for(int i = 0 ; i < num_threads ; ++i) stats_count(STAT_EDGES, pcargs[i].n_edges_thd);
+			stats_count(STAT_SWEEPS, 1);
 
+			// the next frontier becomes the current one
+			vert_t *temp = frontier;
+			frontier = next;
+			next = temp;
 
-		// after the coloring is finished we need to find all the unique colors c in the colors array
-		// there may be up to n_verts unique colors (one for each vertex)
-		vert_t *unique_colors = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
-		if(unique_colors == NULL) {
-			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
-			free(is_vertex);
-			free(*scc_id);
-			free(colors);
-			return 0;
+			n_frontier = n_next;
+			first_round = false;
+			all_verts = false;
 		}
 
-		size_t n_colors = 0;
-		pthread_mutex_t n_colors_lock = PTHREAD_MUTEX_INITIALIZER;
-
-		// initializing the unique colors array in parallel
-		struct init_unique_colors_args iucargs[num_threads];
-		for(int i = 0 ; i < num_threads ; ++i) {
-			iucargs[i].start = i * p_block_size;
-			iucargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+		stats_phase(PHASE_COLORING, start);
+		start = stats_phase_begin();
+
+		// after the coloring is finished the active vertices are grouped by color,
+		// so that the SCC of each color is found from its own bucket
+		vert_t *unique_colors, *bucket_start, *color_verts;
+		ssize_t n_buckets = p_color_buckets(G, is_vertex, n_active_verts, colors, pool,
+				&unique_colors, &bucket_start, &color_verts);
+		if(n_buckets == -1) {
+			free(vert_chunk_start);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free_bfs_workspaces(workspaces, num_threads);
+			free(colors);
+			return -1;
+		}
+		size_t n_colors = n_buckets;
+
+		stats_iteration(n_colors);
+		stats_phase(PHASE_COLORS, start);
+		start = stats_phase_begin();
+
+		// the SCCs of the colors with large buckets are found one at a time, each using all the threads
+		for(size_t i = 0 ; i < n_colors ; ++i) {
+			if(bucket_start[i + 1] - bucket_start[i] < P_BFS_THRESHOLD) continue;
+
+			ssize_t n_scc_c = p_large_color_scc(unique_colors[i], G, is_vertex, colors, scc_id, pool);
+			if(n_scc_c == -1) {
+				free(vert_chunk_start);
+				free(frontier);
+				free(next);
+				free(in_next);
+				free_bfs_workspaces(workspaces, num_threads);
+				free(colors);
+				free(unique_colors);
+				free(bucket_start);
+				free(color_verts);
+				return -1;
+			}
 
-			iucargs[i].is_vertex = is_vertex;
-			iucargs[i].colors = colors;
+			n_scc += (n_scc_c > 0);
+			n_active_verts -= n_scc_c;
+		}
 
-			iucargs[i].unique_colors = unique_colors;
-			iucargs[i].n_colors = &n_colors;
+		// split the colors in chunks of roughly equal work, weighting each color
+		// by the size of its bucket. the large colors are already done and weigh nothing
+		size_t *color_chunk_start = (size_t *) malloc((n_colors + 1) * sizeof(size_t));
+		if(color_chunk_start == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+			free(vert_chunk_start);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free_bfs_workspaces(workspaces, num_threads);
+			free(colors);
+			free(unique_colors);
+			free(bucket_start);
+			free(color_verts);
+			return -1;
+		}
 
-			iucargs[i].n_colors_lock = &n_colors_lock;
+		size_t n_color_chunks = 0;
+		size_t chunk_work = 0;
+		for(size_t i = 0 ; i < n_colors ; ++i) {
+			if(chunk_work == 0) color_chunk_start[n_color_chunks++] = i;
 
-			pthread_create(&threads[i], NULL, p_init_unique_colors, &iucargs[i]);
-		} for(int i = 0 ; i < num_threads ; ++i) pthread_join(threads[i], NULL);
-		
+			vert_t size = bucket_start[i + 1] - bucket_start[i];
+			if(size < P_BFS_THRESHOLD) chunk_work += size * vert_work;
+			if(chunk_work >= P_CHUNK_WEIGHT) chunk_work = 0;
+		}
+		color_chunk_start[n_color_chunks] = n_colors;
 
-		// free the extra memory allocated to unique_colors
-		unique_colors = (vert_t *) realloc(unique_colors, n_colors * sizeof(vert_t));
+		// then get the SCCs for each of the remaining unique colors in parallel
+		struct work_queue queues[num_threads];
+		work_queues_init(queues, num_threads, n_color_chunks);
 
-		// then get the SCCs for each unique color in parallel
-		size_t p_color_block_size = n_colors / num_threads;
 		struct get_sccs_args sccargs[num_threads];
 		for(int i = 0 ; i < num_threads ; ++i) {
-			sccargs[i].start = i * p_color_block_size;
-			sccargs[i].end = (i == num_threads - 1)? n_colors : (i + 1) * p_color_block_size;
+			sccargs[i].thread_id = i;
+			sccargs[i].num_threads = num_threads;
+
+			sccargs[i].queues = queues;
+			sccargs[i].chunk_start = color_chunk_start;
 
 			sccargs[i].G = G;
 			sccargs[i].is_vertex = is_vertex;
 
 			sccargs[i].colors = colors;
 			sccargs[i].unique_colors = unique_colors;
+			sccargs[i].bucket_start = bucket_start;
+			sccargs[i].color_verts = color_verts;
+
+			sccargs[i].ws = workspaces[i];
 
 			sccargs[i].scc_id = scc_id;
-			pthread_create(&threads[i], NULL, p_get_sccs, &sccargs[i]);
-		} for (int i = 0 ; i < num_threads ; ++i) {
-			pthread_join(threads[i], NULL);
-			
+		}
+		thread_pool_run(pool, p_get_sccs, sccargs, sizeof(sccargs[0]));
+
+		for(int i = 0 ; i < num_threads ; ++i) {
 			n_scc += sccargs[i].n_scc_thd;
 			n_active_verts -= sccargs[i].n_vert_removed_thd;
 		}
 
+		stats_phase(PHASE_BFS, start);
+
+		free(color_chunk_start);
 		free(unique_colors);
+		free(bucket_start);
+		free(color_verts);
 		free(colors);
 	}
 
-	free(is_vertex);
+	for(int i = 0 ; i < num_threads ; ++i) stats_count(STAT_EDGES, workspaces[i]->n_edges);
+
+	free(vert_chunk_start);
+	free(frontier);
+	free(next);
+	free(in_next);
+	free_bfs_workspaces(workspaces, num_threads);
 
 	return n_scc;
 }
+
+
+/* Finds the SCC that contains pivot as the intersection of its forward and backward reach
+ *
+ * the forward and backward bfs are performed at the same time by two threads of the pool.
+ * every active vertex in the SCC gets scc_id equal to the smallest vertex of the SCC,
+ * as with the coloring algorithm, and is removed from the graph.
+ * returns the number of vertices in the SCC or -1 on failure.
+ */
+static ssize_t p_pivot_scc(vert_t pivot, const graph *G, vertex_set *is_vertex, vert_t **scc_id, struct thread_pool *pool) {
+	int num_threads = pool->num_threads;
+
+	// the bfs only visits vertices with the same property, so every vertex gets the same one
+	vert_t *properties = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+	bool *in_fw = (bool *) calloc(G->n_verts, sizeof(bool));
+	if(properties == NULL || in_fw == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(properties);
+		free(in_fw);
+		return -1;
+	}
+
+	// thread 0 performs the forward bfs and thread 1 the backward bfs
+	struct reach_args rargs[num_threads < 2 ? 2 : num_threads];
+	for(int i = 0 ; i < num_threads || i < 2 ; ++i) {
+		rargs[i].pivot = pivot;
+
+		rargs[i].G = G;
+		rargs[i].is_vertex = is_vertex;
+
+		rargs[i].properties = properties;
+		rargs[i].search = (i == 0)? forward_bfs : (i == 1)? backward_bfs : NULL;
+	}
+
+	if(num_threads >= 2) {
+		thread_pool_run(pool, p_reach, rargs, sizeof(rargs[0]));
+	} else {
+		p_reach(&rargs[0]);
+		p_reach(&rargs[1]);
+	}
+
+	free(properties);
+
+	if(rargs[0].n_reach == -1 || rargs[1].n_reach == -1) {
+		if(rargs[0].n_reach != -1) free(rargs[0].reach);
+		if(rargs[1].n_reach != -1) free(rargs[1].reach);
+
+		free(in_fw);
+		return -1;
+	}
+
+	vert_t *fw = rargs[0].reach;
+	vert_t *bw = rargs[1].reach;
+
+	for(size_t i = 0 ; i < rargs[0].n_reach ; ++i) in_fw[fw[i]] = true;
+
+	// the SCC of pivot is the intersection of the two, move it to the start of bw
+	size_t n_scc_pivot = 0;
+	vert_t c = pivot;
+	for(size_t i = 0 ; i < rargs[1].n_reach ; ++i) {
+		vert_t v = bw[i];
+		if(in_fw[v]) {
+			bw[n_scc_pivot++] = v;
+			if(v < c) c = v;
+		}
+	}
+
+	// then set the scc_id of its vertices and remove them from the graph
+	for(size_t i = 0 ; i < n_scc_pivot ; ++i) {
+		vert_t v = bw[i];
+		(*scc_id)[v] = c;
+		remove_vertex(v, is_vertex);
+	}
+
+	free(in_fw);
+	free(fw);
+	free(bw);
+
+	return n_scc_pivot;
+}
+
+
+/* Chooses the pivot of the FW-BW algorithm in parallel
+ *
+ * the vertex with the largest product of in-degree and out-degree is most likely
+ * to belong to the largest SCC of the graph.
+ */
+static vert_t p_choose_pivot_vertex(const graph *G, vertex_set *is_vertex, struct thread_pool *pool) {
+	int num_threads = pool->num_threads;
+
+	// the block size refers to the number of vertices that each thread will be responsible for.
+	size_t p_block_size = G->n_verts / num_threads;
+
+	struct choose_pivot_args cpargs[num_threads];
+	for(int i = 0 ; i < num_threads ; ++i) {
+		cpargs[i].start = i * p_block_size;
+		cpargs[i].end = (i == num_threads - 1)? G->n_verts : (i + 1) * p_block_size;
+
+		cpargs[i].G = G;
+		cpargs[i].is_vertex = is_vertex;
+
+	}
+	thread_pool_run(pool, p_choose_pivot, cpargs, sizeof(cpargs[0]));
+
+	// then keep the best pivot out of all the blocks
+	vert_t pivot = 0;
+	uint64_t pivot_score = 0;
+	bool found_pivot = false;
+	for(int i = 0 ; i < num_threads ; ++i) {
+		if(cpargs[i].found_pivot && (!found_pivot || cpargs[i].pivot_score > pivot_score)) {
+			pivot = cpargs[i].pivot;
+			pivot_score = cpargs[i].pivot_score;
+			found_pivot = true;
+		}
+	}
+
+	return pivot;
+}
+
+
+/* Implements the graph coloring algorithm to find the SCCs of G
+ *
+ * takes as input the graph G and a double pointer where the result will 
+ * be stored. returns the number of sccs.
+ *
+ * scc_id is of size n_verts
+ * if v belongs to the scc with id c then: scc_id[v] = c
+ */
+ssize_t p_scc_coloring(const graph *G, vert_t **scc_id, int num_threads) {
+
+	// the worker threads are created once and reused by every phase below
+	struct thread_pool pool;
+	if(thread_pool_init(&pool, num_threads) == -1) return -1;
+
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) {
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	// initialize n_active_verts to n_verts
+	size_t n_active_verts = G->n_verts;
+
+	// allocate the memory required for the scc_id array
+	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(*scc_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_vertex_set(is_vertex);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_trivial = p_trim_trivial_sccs(G, is_vertex, scc_id, &pool, &n_removed);
+	if(n_trivial == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+
+	// decompose the small weakly connected components on their own
+	ssize_t n_wcc_scc = p_wcc_sccs(G, is_vertex, scc_id, &pool, &n_removed);
+	if(n_wcc_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+
+	// then find the rest of the sccs using the coloring algorithm
+	ssize_t n_scc = p_coloring_sccs(G, is_vertex, n_active_verts, scc_id, &pool);
+	if(n_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	free_vertex_set(is_vertex);
+	thread_pool_destroy(&pool);
+
+	return n_trivial + n_wcc_scc + n_scc;
+}
+
+
+/* Implements the forward-backward (FW-BW) algorithm to find the SCCs of G
+ *
+ * after trimming, the SCC of a pivot vertex is found as the intersection of the vertices
+ * reachable from it and the vertices that reach it. this peels off the giant SCC of the graph
+ * in two BFS, which the coloring algorithm would need O(diameter) iterations to find.
+ * the graph is trimmed again and the remaining SCCs are found with the coloring algorithm.
+ *
+ * the arguments and the result are the same as in p_scc_coloring.
+ */
+ssize_t p_scc_fwbw(const graph *G, vert_t **scc_id, int num_threads) {
+
+	// the worker threads are created once and reused by every phase below
+	struct thread_pool pool;
+	if(thread_pool_init(&pool, num_threads) == -1) return -1;
+
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) {
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	// initialize n_active_verts to n_verts
+	size_t n_active_verts = G->n_verts;
+
+	// allocate the memory required for the scc_id array
+	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(*scc_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_vertex_set(is_vertex);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_scc = p_trim_trivial_sccs(G, is_vertex, scc_id, &pool, &n_removed);
+	if(n_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+
+	// decompose the small weakly connected components on their own,
+	// so that the pivot is chosen in one of the large ones
+	ssize_t n_wcc_scc = p_wcc_sccs(G, is_vertex, scc_id, &pool, &n_removed);
+	if(n_wcc_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+	n_scc += n_wcc_scc;
+
+	if(n_active_verts > 0) {
+		// peel off the scc of the pivot
+		double start = stats_phase_begin();
+		vert_t pivot = p_choose_pivot_vertex(G, is_vertex, &pool);
+		ssize_t n_scc_pivot = p_pivot_scc(pivot, G, is_vertex, scc_id, &pool);
+		stats_phase(PHASE_BFS, start);
+		if(n_scc_pivot == -1) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			thread_pool_destroy(&pool);
+			return -1;
+		}
+		n_active_verts -= n_scc_pivot;
+		n_scc += 1;
+
+		// removing the scc may have left new trivial sccs behind
+		ssize_t n_trivial = p_trim_trivial_sccs(G, is_vertex, scc_id, &pool, &n_removed);
+		if(n_trivial == -1) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			thread_pool_destroy(&pool);
+			return -1;
+		}
+		n_active_verts -= n_removed;
+		n_scc += n_trivial;
+	}
+
+	// then find the rest of the sccs using the coloring algorithm
+	ssize_t n_scc_rest = p_coloring_sccs(G, is_vertex, n_active_verts, scc_id, &pool);
+	if(n_scc_rest == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		thread_pool_destroy(&pool);
+		return -1;
+	}
+
+	free_vertex_set(is_vertex);
+	thread_pool_destroy(&pool);
+
+	return n_scc + n_scc_rest;
+}
@@ -24,7 +24,27 @@
 
 #include <graph.h>
 
+// the work of a vertex is one plus its in-degree. the coloring and the SCC extraction
+// are split in chunks of about this much work, which the threads take dynamically
+#ifndef P_CHUNK_WEIGHT
+#define P_CHUNK_WEIGHT 4096
+#endif
+
+// the number of vertices each thread collects before appending them to the next frontier
+#ifndef P_FRONTIER_BUFFER
+#define P_FRONTIER_BUFFER 256
+#endif
+
+// weakly connected components with fewer vertices than this are decomposed by a single
+// thread with Tarjan's algorithm, and the larger ones by all the threads together
+#ifndef P_WCC_THRESHOLD
+#define P_WCC_THRESHOLD 65536
+#endif
+
 // Implements the graph coloring algorithm to find the SCCs of G
 ssize_t p_scc_coloring(const graph *G, vert_t **vertex_scc_id, int num_threads);
 
+// Implements the forward-backward (FW-BW) algorithm to find the SCCs of G
+ssize_t p_scc_fwbw(const graph *G, vert_t **vertex_scc_id, int num_threads);
+
 #endif
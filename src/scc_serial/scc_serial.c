@@ -18,6 +18,7 @@
  */
 
 #include "scc_serial.h"
+#include <stats.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,121 +29,295 @@
 #include <string.h>
 
 
-/* Implements the graph coloring algorithm to find the SCCs of G
+/* Removes the vertices of the queue from the graph and trims the ones left trivial
  *
- * takes as input the graph G and a double pointer where the result will 
- * be stored. returns the number of sccs.
+ * every removed vertex decreases the in_degree of its successors and the out_degree
+ * of its predecessors. a vertex whose in_degree or out_degree drops to zero becomes
+ * an SCC on its own, so it is removed and appended to the queue (Trim-1).
+ * returns the new length of the queue, which holds all the removed vertices.
+ */
+static size_t trim_queue(const graph *G, vertex_set *is_vertex, vert_t *scc_id,
+		vert_t *in_degree, vert_t *out_degree, vert_t *queue, size_t head, size_t tail) {
+
+	for( ; head < tail ; ++head) {
+		vert_t v = queue[head];
+
+		adj_span neighbours = neighbours_span(v, G);
+		adj_iter neighbours_it = adj_begin(neighbours);
+		for(size_t i = 0 ; i < neighbours.len ; ++i) {
+			vert_t w = adj_next(&neighbours_it);
+			if(w != v && is_active_vertex(w, is_vertex) && --in_degree[w] == 0) {
+				scc_id[w] = w;
+				remove_vertex(w, is_vertex);
+				queue[tail++] = w;
+			}
+		}
+
+		adj_span predecessors = predecessors_span(v, G);
+		adj_iter predecessors_it = adj_begin(predecessors);
+		for(size_t i = 0 ; i < predecessors.len ; ++i) {
+			vert_t u = adj_next(&predecessors_it);
+			if(u != v && is_active_vertex(u, is_vertex) && --out_degree[u] == 0) {
+				scc_id[u] = u;
+				remove_vertex(u, is_vertex);
+				queue[tail++] = u;
+			}
+		}
+	}
+
+	return tail;
+}
+
+/* Removes the trivial SCCs from G until none are left
  *
- * scc_id is of size n_verts
- * if v belongs to the scc with id c then: scc_id[v] = c
+ * each vertex keeps the number of its active predecessors and successors (not counting
+ * self loops), so trimming to a fixpoint takes O(V + E) in total instead of a sweep per
+ * iteration. the SCCs of two vertices are removed with Trim-2 after Trim-1 is done, and
+ * then Trim-1 continues from the vertices they leave trivial.
+ * *n_removed is set to the number of vertices removed.
+ * returns the number of sccs found or -1 on failure.
  */
-ssize_t scc_coloring(const graph *G, vert_t **scc_id) {
-	
-	bool *is_vertex = (bool *) malloc(G->n_verts * sizeof(bool));
-	if(is_vertex == NULL) {
+static ssize_t trim_trivial_sccs(const graph *G, vertex_set *is_vertex, vert_t *scc_id, size_t *n_removed) {
+	double start = stats_phase_begin();
+
+	vert_t *in_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *out_degree = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *queue = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(in_degree == NULL || out_degree == NULL || queue == NULL) {
 		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(in_degree);
+		free(out_degree);
+		free(queue);
 		return -1;
 	}
-	for(vert_t v = 0 ; v < G->n_verts ; ++v) is_vertex[v] = true;
-	size_t n_active_verts = G->n_verts;
 
-	// allocate the memory required for the scc_id array
-	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
-	if(*scc_id == NULL) {
+	// count the degrees of all the active vertices first, so the vertices
+	// removed below are counted by their neighbours
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		in_degree[v] = active_degree(v, predecessors_span(v, G), is_vertex);
+		out_degree[v] = active_degree(v, neighbours_span(v, G), is_vertex);
+	}
+
+	// the trivial vertices are each an scc on their own
+	size_t tail = 0;
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		if(in_degree[v] == 0 || out_degree[v] == 0) {
+			scc_id[v] = v;
+			remove_vertex(v, is_vertex);
+			queue[tail++] = v;
+		}
+	}
+
+	// Trim-1 until no trivial vertices are left
+	size_t head = 0;
+	tail = trim_queue(G, is_vertex, scc_id, in_degree, out_degree, queue, head, tail);
+	size_t n_scc = tail;
+
+	// Trim-2, then Trim-1 on the vertices left behind
+	head = tail;
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		vert_t u;
+		if(is_trivial_pair(v, G, is_vertex, in_degree, out_degree, &u, false)) {
+			scc_id[v] = v;
+			scc_id[u] = v;
+			remove_vertex(v, is_vertex);
+			remove_vertex(u, is_vertex);
+			queue[tail++] = v;
+			queue[tail++] = u;
+
+			n_scc += 1;
+		}
+	}
+
+	size_t n_pairs_end = tail;
+	tail = trim_queue(G, is_vertex, scc_id, in_degree, out_degree, queue, head, tail);
+	n_scc += tail - n_pairs_end;
+
+	*n_removed = tail;
+
+	free(in_degree);
+	free(out_degree);
+	free(queue);
+
+	stats_count(STAT_TRIMMED, tail);
+	stats_phase(PHASE_TRIM, start);
+
+	return n_scc;
+}
+
+static ssize_t coloring_sccs(const graph *G, vertex_set *is_vertex, size_t n_active_verts, vert_t *scc_id);
+
+/* Finds the SCCs of the active vertices of G on the subgraph they induce
+ *
+ * the removed vertices and their edges are dropped, so the coloring iterations on the
+ * subgraph only touch the active vertices and edges. the scc ids found in the subgraph
+ * are mapped back to the vertices of G, and since the relabeling keeps the order of the
+ * vertices the scc id is still the smallest vertex of the scc.
+ * at the end all the vertices have been removed from the graph.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t compacted_coloring_sccs(const graph *G, vertex_set *is_vertex, vert_t *scc_id) {
+	vert_t *old_id;
+	graph *H = induced_subgraph(G, is_vertex, &old_id);
+	if(H == NULL) return -1;
+
+	vertex_set *is_vertex_H = new_vertex_set(H->n_verts);
+	vert_t *scc_id_H = (vert_t *) malloc(H->n_verts * sizeof(vert_t));
+	if(is_vertex_H == NULL || scc_id_H == NULL) {
 		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-		free(is_vertex);
+		if(is_vertex_H != NULL) free_vertex_set(is_vertex_H);
+		free(scc_id_H);
+		free(old_id);
+		free_graph(H);
 		return -1;
 	}
 
-	// initialize n_sccs to 0
+	ssize_t n_scc = coloring_sccs(H, is_vertex_H, H->n_verts, scc_id_H);
+	if(n_scc != -1) {
+		// map the scc ids back to the vertices of G and remove them from the graph
+		for(vert_t v = 0 ; v < H->n_verts ; ++v) {
+			scc_id[old_id[v]] = old_id[scc_id_H[v]];
+			remove_vertex(old_id[v], is_vertex);
+		}
+	}
+
+	free_vertex_set(is_vertex_H);
+	free(scc_id_H);
+	free(old_id);
+	free_graph(H);
+
+	return n_scc;
+}
+
+/* Finds the SCCs of the active vertices of G using the graph coloring algorithm
+ *
+ * n_active_verts is the number of active vertices in is_vertex.
+ * at the end all the vertices have been removed from the graph.
+ * returns the number of sccs found or -1 on failure.
+ */
+static ssize_t coloring_sccs(const graph *G, vertex_set *is_vertex, size_t n_active_verts, vert_t *scc_id) {
 	size_t n_scc = 0;
-	
-	// remove trivial sccs 
-	// the loop will run just twice since after that
-	// you get diminishing returns for each iteration
-	for(uint8_t i = 0 ; i < 2 ; ++i) {
-		// loop over all vertices
-		for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v]) {
-				int is_trivial = is_trivial_scc(v, G, is_vertex);
-				if(is_trivial == -1) {
-					free(is_vertex);
-					free(*scc_id);
-					return -1;
 
-				}
+	// the colors are propagated using a worklist. frontier holds the vertices whose color
+	// may change in the current round and next the ones for the following round.
+	// in_next[v] is true when v is already in next, so that it is added only once.
+	vert_t *frontier = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	vert_t *next = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	bool *in_next = (bool *) calloc(G->n_verts, sizeof(bool));
 
-				// check if the vertex is active, and then if it is trivial
-				if(is_trivial) {
-					// if it is, set scc_id for the vertex to be itself
-					// and increase the number of sccs
-					(*scc_id)[v] = v;
-					n_scc += 1;
+	// the same workspace is used by the bfs of every color
+	bfs_workspace *ws = new_bfs_workspace(G->n_verts);
+	if(frontier == NULL || next == NULL || in_next == NULL || ws == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-					// finally remove the vertex from the graph
-					is_vertex[v] = false;
-					n_active_verts -= 1;
-				}
-			}
-		}
+		free(frontier);
+		free(next);
+		free(in_next);
+		if(ws != NULL) free_bfs_workspace(ws);
+		return -1;
 	}
 
 	// the core loop of the algorithm
 	// this will run as long as G is non empty
 	while(n_active_verts > 0) {
+		// once few vertices are left, the rest of the sccs are found on the subgraph
+		// of the active vertices instead of walking the whole graph in each iteration
+		if(COMPACTION_THRESHOLD > 0 && n_active_verts * COMPACTION_THRESHOLD < G->n_verts) {
+			ssize_t n_scc_rest = compacted_coloring_sccs(G, is_vertex, scc_id);
+			if(n_scc_rest == -1) {
+				free(frontier);
+				free(next);
+				free(in_next);
+				free_bfs_workspace(ws);
+				return -1;
+			}
+
+			n_scc += n_scc_rest;
+			break;
+		}
+
 		// initialize the colors array as colors(v) = v for each v in G
 		vert_t *colors = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
 		if(colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
-			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free_bfs_workspace(ws);
 			return -1;
 		}
 		for(vert_t v = 0 ; v < G->n_verts ; ++v) colors[v] = v;
 
-		// this loop will run as long as at least one vertex changed colors in
-		// the last iteration since a vertex changing color might end up changing
-		// the color of its neighbours in the next iteration.
-		bool changed_color = true;
-		while(changed_color) {
-			changed_color = false;
-
-			// we loop over all the vertives v in the graph (checking if the v is active)
-			for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-				if(is_vertex[v]) {
-					// we get the predecessors of the vertex v (vertices u such that [u, v] in G)
-					// because we want to write in one memory position (colors[v])
-					// as opposed to every u for each v. this is useful for 
-					// the parallelization since memory locations the treads
-					// write to will not interfere.
-
-					vert_t *predecessors;
-					ssize_t n_predecessors = get_predecessors(v, G, is_vertex, &predecessors);
-					if(n_predecessors == -1) {
-						free(is_vertex);
-						free(*scc_id);
-						free(colors);
-						return -1;
-
-					} else if(n_predecessors > 0) {
-						// then we set colors[v] to be the minimum of its predecessors (or itself)
-						for(size_t i = 0 ; i < n_predecessors ; ++i) {
-							vert_t u = predecessors[i];
-							if(colors[v] > colors[u]) {
-								colors[v] = colors[u];
-								changed_color = true;
-							}
-						}
-
-						free(predecessors);
+		double start = stats_phase_begin();
+		size_t n_edges = 0;
+
+		// in the first round every active vertex is in the frontier. after that only the
+		// successors of the vertices that changed color in the last round can change color,
+		// so each round does work proportional to the frontier instead of the whole graph.
+		// when few vertices are left the first frontier is the list of the active vertices,
+		// otherwise it is every vertex and the removed ones are skipped.
+		bool first_round = true;
+		bool all_verts = (n_active_verts * VERTEX_SET_SPARSE >= G->n_verts);
+		size_t n_frontier = all_verts ? G->n_verts : compact_vertex_set(is_vertex, frontier);
+		while(n_frontier > 0) {
+			size_t n_next = 0;
+
+			for(size_t i = 0 ; i < n_frontier ; ++i) {
+				// a vertex taken from the frontier may be added to next again,
+				// but in the first round next may already contain it
+				vert_t v = all_verts ? i : frontier[i];
+				if(!first_round) in_next[v] = false;
+
+				if(!is_active_vertex(v, is_vertex)) continue;
+
+				// we set colors[v] to be the minimum of its active predecessors (or itself)
+				// (vertices u such that [u, v] in G). the colors are updated in place,
+				// so a new color may travel more than one edge in each round.
+				adj_span predecessors = predecessors_span(v, G);
+				vert_t color = min_active_color(predecessors, is_vertex, colors, colors[v]);
+				n_edges += predecessors.len;
+
+				if(color == colors[v]) continue;
+				colors[v] = color;
+
+				// the successors of v with a larger color may now change color as well.
+				// in the first round the successors w > v are still ahead in this round
+				// and will read the new color of v, so they do not need to be added.
+				adj_span neighbours = neighbours_span(v, G);
+				adj_iter neighbours_it = adj_begin(neighbours);
+				n_edges += neighbours.len;
+				for(size_t j = 0 ; j < neighbours.len ; ++j) {
+					vert_t w = adj_next(&neighbours_it);
+					if(first_round && w > v) continue;
+
+					if(is_active_vertex(w, is_vertex) && colors[w] > color && !in_next[w]) {
+						in_next[w] = true;
+						next[n_next++] = w;
 					}
-
 				}
 			}
+
+			// the next frontier becomes the current one
+			vert_t *temp = frontier;
+			frontier = next;
+			next = temp;
+
+			n_frontier = n_next;
+			first_round = false;
+			all_verts = false;
+
+			stats_count(STAT_SWEEPS, 1);
 		}
 
+		stats_count(STAT_EDGES, n_edges);
+		stats_phase(PHASE_COLORING, start);
+		start = stats_phase_begin();
 
 		// after the coloring is finished we need to find all the unique colors c in the colors array
 		// there may be up to n_verts unique colors (one for each vertex)
@@ -150,10 +325,11 @@ ssize_t scc_coloring(const graph *G, vert_t **scc_id) {
 		if(unique_colors == NULL) {
 			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
 
-			free(is_vertex);
-			free(*scc_id);
+			free(frontier);
+			free(next);
+			free(in_next);
+			free_bfs_workspace(ws);
 			free(colors);
-
 			return -1;
 		}
 		size_t n_colors = 0;
@@ -161,25 +337,31 @@ ssize_t scc_coloring(const graph *G, vert_t **scc_id) {
 		// from the way colors was initialized, the unique colors are 
 		// those of the vertices v such that colors[v] = v, then c := v.
 		// we append c to the unique_colors array
-		for(vert_t v = 0 ; v < G->n_verts ; ++v) {
-			if(is_vertex[v] && colors[v] == v) 
-				unique_colors[n_colors++] = v;
+		for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+				v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+			if(colors[v] == v) unique_colors[n_colors++] = v;
 		}
 
 		// free the extra memory allocated to unique_colors
 		unique_colors = (vert_t *) realloc(unique_colors, n_colors * sizeof(vert_t));
 
+		stats_iteration(n_colors);
+		stats_phase(PHASE_COLORS, start);
+		start = stats_phase_begin();
+
 		// then loop over all the unique colors c
 		for(size_t i = 0 ; i < n_colors ; ++i) {
 			vert_t c = unique_colors[i];
 
 			// perform a backward bfs on the subgraph of G where colors[v] = c
 			// these create a new scc
-			vert_t *scc_c;
-			ssize_t n_scc_c = backward_bfs(c, G, c, colors, is_vertex, &scc_c);
+			const vert_t *scc_c;
+			ssize_t n_scc_c = backward_bfs_ws(c, G, c, colors, is_vertex, ws, &scc_c);
 			if(n_scc_c == -1) {
-				free(is_vertex);
-				free(*scc_id);
+				free(frontier);
+				free(next);
+				free(in_next);
+				free_bfs_workspace(ws);
 				free(colors);
 				free(unique_colors);
 				return -1;
@@ -188,23 +370,389 @@ ssize_t scc_coloring(const graph *G, vert_t **scc_id) {
 				// for each vertex in the new scc set scc_id = c and increase n_scc
 				for(size_t j = 0 ; j < n_scc_c ; ++j) {
 					vert_t v = scc_c[j];
-					(*scc_id)[v] = c;
+					scc_id[v] = c;
 
 					// finally remove the vertices from the graph
-					is_vertex[v] = false;
+					remove_vertex(v, is_vertex);
 				}
 				n_active_verts -= n_scc_c;
 				n_scc += 1;
-
-				free(scc_c);
 			}
 		}
 
+		stats_phase(PHASE_BFS, start);
+
 		free(unique_colors);
 		free(colors);
 	}
 
-	free(is_vertex);
+	stats_count(STAT_EDGES, ws->n_edges);
+
+	free(frontier);
+	free(next);
+	free(in_next);
+	free_bfs_workspace(ws);
+
+	return n_scc;
+}
+
+/* Finds the SCC that contains pivot as the intersection of its forward and backward reach
+ *
+ * every active vertex in the SCC gets scc_id equal to the smallest vertex of the SCC,
+ * as with the coloring algorithm, and is removed from the graph.
+ * returns the number of vertices in the SCC or -1 on failure.
+ */
+static ssize_t pivot_scc(vert_t pivot, const graph *G, vertex_set *is_vertex, vert_t *scc_id) {
+	// the bfs only visits vertices with the same property, so every vertex gets the same one
+	vert_t *properties = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+	bool *in_fw = (bool *) calloc(G->n_verts, sizeof(bool));
+	if(properties == NULL || in_fw == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free(properties);
+		free(in_fw);
+		return -1;
+	}
+
+	// get the vertices reachable from pivot and the ones that reach pivot
+	vert_t *fw, *bw;
+	ssize_t n_fw = forward_bfs(pivot, G, 0, properties, is_vertex, &fw);
+	if(n_fw == -1) {
+		free(properties);
+		free(in_fw);
+		return -1;
+	}
+
+	ssize_t n_bw = backward_bfs(pivot, G, 0, properties, is_vertex, &bw);
+	if(n_bw == -1) {
+		free(properties);
+		free(in_fw);
+		free(fw);
+		return -1;
+	}
+
+	for(size_t i = 0 ; i < n_fw ; ++i) in_fw[fw[i]] = true;
+
+	// the SCC of pivot is the intersection of the two, move it to the start of bw
+	size_t n_scc_pivot = 0;
+	vert_t c = pivot;
+	for(size_t i = 0 ; i < n_bw ; ++i) {
+		vert_t v = bw[i];
+		if(in_fw[v]) {
+			bw[n_scc_pivot++] = v;
+			if(v < c) c = v;
+		}
+	}
+
+	// then set the scc_id of its vertices and remove them from the graph
+	for(size_t i = 0 ; i < n_scc_pivot ; ++i) {
+		vert_t v = bw[i];
+		scc_id[v] = c;
+		remove_vertex(v, is_vertex);
+	}
+
+	free(properties);
+	free(in_fw);
+	free(fw);
+	free(bw);
+
+	return n_scc_pivot;
+}
+
+/* Chooses the pivot of the FW-BW algorithm
+ *
+ * the vertex with the largest product of in-degree and out-degree is most likely
+ * to belong to the largest SCC of the graph.
+ */
+static vert_t choose_pivot(const graph *G, const vertex_set *is_vertex) {
+	vert_t pivot = 0;
+	uint64_t pivot_score = 0;
+	bool found_pivot = false;
+
+	for(vert_t v = next_active_vertex(0, G->n_verts, is_vertex) ; v < G->n_verts ;
+			v = next_active_vertex(v + 1, G->n_verts, is_vertex)) {
+		uint64_t score = (uint64_t) neighbours_span(v, G).len * predecessors_span(v, G).len;
+		if(!found_pivot || score > pivot_score) {
+			pivot = v;
+			pivot_score = score;
+			found_pivot = true;
+		}
+	}
+
+	return pivot;
+}
+
+
+// index of the vertices whose scc has been found by tarjan_sccs
+#define TARJAN_DONE ((vert_t) -1)
+
+/* Finds the SCCs of the active vertices of G reachable from roots using Tarjan's algorithm
+ *
+ * the depth first search is iterative: dfs_stack holds the path from the root of the search
+ * and dfs_iter the position of each vertex of the path in the list of its neighbours.
+ * index[v] is the order in which v was visited and low_link[v] the smallest index reachable
+ * from v through the vertices still in scc_stack. when low_link[v] == index[v] the vertices
+ * above v in scc_stack form an scc, and their index is set to TARJAN_DONE.
+ * every vertex in the scc gets scc_id equal to its smallest vertex, as with the coloring
+ * algorithm. is_vertex is not modified, so the caller should remove the vertices searched.
+ * it is read atomically, since the parallel callers remove the vertices of other components.
+ * if roots is NULL every vertex of G is a root and n_roots is ignored.
+ * returns the number of sccs found.
+ */
+ssize_t tarjan_sccs(const graph *G, const vertex_set *is_vertex, const vert_t *roots, size_t n_roots,
+		tarjan_workspace *ws, vert_t *scc_id) {
+	vert_t *index = ws->index;
+	vert_t *low_link = ws->low_link;
+	vert_t *scc_stack = ws->scc_stack;
+	vert_t *dfs_stack = ws->dfs_stack;
+	adj_iter *dfs_iter = ws->dfs_iter;
+
+	size_t n_scc = 0;
+	vert_t n_visited = 0;
+	size_t scc_top = 0;
+	size_t n_edges = 0;
+
+	if(roots == NULL) n_roots = G->n_verts;
+
+	for(size_t r = 0 ; r < n_roots ; ++r) {
+		vert_t root = (roots != NULL)? roots[r] : r;
+		if(index[root] != 0 || !is_active_vertex_atomic(root, is_vertex)) continue;
+
+		index[root] = low_link[root] = ++n_visited;
+		scc_stack[scc_top++] = root;
+		dfs_stack[0] = root;
+		dfs_iter[0] = adj_begin(neighbours_span(root, G));
+		size_t depth = 1;
+
+		while(depth > 0) {
+			vert_t v = dfs_stack[depth - 1];
+
+			// go over the neighbours of v until an unvisited vertex is found.
+			// the iterator is left after it, so the search of v continues
+			// from the next neighbour once the search from w returns
+			adj_iter *it = &dfs_iter[depth - 1];
+			bool found = false;
+			vert_t w = v;
+			while(it->left > 0) {
+				w = adj_next(it);
+				n_edges += 1;
+				if(!is_active_vertex_atomic(w, is_vertex)) continue;
+				if(index[w] == 0) {
+					found = true;
+					break;
+				}
+
+				// w is still in scc_stack unless its scc is done
+				if(index[w] != TARJAN_DONE && index[w] < low_link[v]) low_link[v] = index[w];
+			}
+
+			if(found) {
+				index[w] = low_link[w] = ++n_visited;
+				scc_stack[scc_top++] = w;
+				dfs_stack[depth] = w;
+				dfs_iter[depth] = adj_begin(neighbours_span(w, G));
+				depth += 1;
+				continue;
+			}
+
+			// all the edges of v are done, so return to its parent
+			depth -= 1;
+			if(depth > 0) {
+				vert_t u = dfs_stack[depth - 1];
+				if(low_link[v] < low_link[u]) low_link[u] = low_link[v];
+			}
+
+			if(low_link[v] != index[v]) continue;
+
+			// v is the first vertex of its scc that was visited
+			size_t scc_start = scc_top;
+			vert_t c = v;
+			do {
+				vert_t u = scc_stack[--scc_start];
+				if(u < c) c = u;
+			} while(scc_stack[scc_start] != v);
+
+			for(size_t i = scc_start ; i < scc_top ; ++i) {
+				vert_t u = scc_stack[i];
+				scc_id[u] = c;
+				index[u] = TARJAN_DONE;
+			}
+			scc_top = scc_start;
+			n_scc += 1;
+		}
+	}
+
+	ws->n_edges += n_edges;
+	return n_scc;
+}
+
+
+/* Implements the graph coloring algorithm to find the SCCs of G
+ *
+ * takes as input the graph G and a double pointer where the result will 
+ * be stored. returns the number of sccs.
+ *
+ * scc_id is of size n_verts
+ * if v belongs to the scc with id c then: scc_id[v] = c
+ */
+ssize_t scc_coloring(const graph *G, vert_t **scc_id) {
+	
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) return -1;
+	size_t n_active_verts = G->n_verts;
+
+	// allocate the memory required for the scc_id array
+	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(*scc_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_vertex_set(is_vertex);
+		return -1;
+	}
+
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_trivial = trim_trivial_sccs(G, is_vertex, *scc_id, &n_removed);
+	if(n_trivial == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+
+	// then find the rest of the sccs using the coloring algorithm
+	ssize_t n_scc = coloring_sccs(G, is_vertex, n_active_verts, *scc_id);
+	if(n_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		return -1;
+	}
+
+	free_vertex_set(is_vertex);
+
+	return n_trivial + n_scc;
+}
+
+/* Implements the forward-backward (FW-BW) algorithm to find the SCCs of G
+ *
+ * after trimming, the SCC of a pivot vertex is found as the intersection of the vertices
+ * reachable from it and the vertices that reach it. this peels off the giant SCC of the graph
+ * in two BFS, which the coloring algorithm would need O(diameter) iterations to find.
+ * the graph is trimmed again and the remaining SCCs are found with the coloring algorithm.
+ *
+ * the arguments and the result are the same as in scc_coloring.
+ */
+ssize_t scc_fwbw(const graph *G, vert_t **scc_id) {
+
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) return -1;
+	size_t n_active_verts = G->n_verts;
+
+	// allocate the memory required for the scc_id array
+	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	if(*scc_id == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_vertex_set(is_vertex);
+		return -1;
+	}
+
+	// remove trivial sccs
+	size_t n_removed;
+	ssize_t n_scc = trim_trivial_sccs(G, is_vertex, *scc_id, &n_removed);
+	if(n_scc == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		return -1;
+	}
+	n_active_verts -= n_removed;
+
+	if(n_active_verts > 0) {
+		// peel off the scc of the pivot
+		double start = stats_phase_begin();
+		ssize_t n_scc_pivot = pivot_scc(choose_pivot(G, is_vertex), G, is_vertex, *scc_id);
+		stats_phase(PHASE_BFS, start);
+		if(n_scc_pivot == -1) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			return -1;
+		}
+		n_active_verts -= n_scc_pivot;
+		n_scc += 1;
+
+		// removing the scc may have left new trivial sccs behind
+		ssize_t n_trivial = trim_trivial_sccs(G, is_vertex, *scc_id, &n_removed);
+		if(n_trivial == -1) {
+			free_vertex_set(is_vertex);
+			free(*scc_id);
+			return -1;
+		}
+		n_active_verts -= n_removed;
+		n_scc += n_trivial;
+	}
+
+	// then find the rest of the sccs using the coloring algorithm
+	ssize_t n_scc_rest = coloring_sccs(G, is_vertex, n_active_verts, *scc_id);
+	if(n_scc_rest == -1) {
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		return -1;
+	}
+
+	free_vertex_set(is_vertex);
+
+	return n_scc + n_scc_rest;
+}
+
+/* Implements Tarjan's algorithm to find the SCCs of G
+ *
+ * every vertex and edge of G is visited once by an iterative depth first search, so this
+ * takes O(V + E) time regardless of the diameter of the graph. it is the linear time
+ * reference for the other algorithms, and its scc ids are the same as theirs.
+ *
+ * the arguments and the result are the same as in scc_coloring.
+ */
+ssize_t scc_tarjan(const graph *G, vert_t **scc_id) {
+
+	vertex_set *is_vertex = new_vertex_set(G->n_verts);
+	if(is_vertex == NULL) return -1;
+
+	// allocate the memory required for the scc_id array
+	*scc_id = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+
+	// a single search may reach every vertex, so the stacks need n_verts entries
+	tarjan_workspace ws;
+	ws.index = (vert_t *) calloc(G->n_verts, sizeof(vert_t));
+	ws.low_link = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	ws.scc_stack = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	ws.dfs_stack = (vert_t *) malloc(G->n_verts * sizeof(vert_t));
+	ws.dfs_iter = (adj_iter *) malloc(G->n_verts * sizeof(adj_iter));
+	ws.n_edges = 0;
+	if(*scc_id == NULL || ws.index == NULL || ws.low_link == NULL ||
+			ws.scc_stack == NULL || ws.dfs_stack == NULL || ws.dfs_iter == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_vertex_set(is_vertex);
+		free(*scc_id);
+		free(ws.index);
+		free(ws.low_link);
+		free(ws.scc_stack);
+		free(ws.dfs_stack);
+		free(ws.dfs_iter);
+		return -1;
+	}
+
+	double start = stats_phase_begin();
+	ssize_t n_scc = tarjan_sccs(G, is_vertex, NULL, 0, &ws, *scc_id);
+	stats_count(STAT_EDGES, ws.n_edges);
+	stats_phase(PHASE_TARJAN, start);
+
+	free_vertex_set(is_vertex);
+	free(ws.index);
+	free(ws.low_link);
+	free(ws.scc_stack);
+	free(ws.dfs_stack);
+	free(ws.dfs_iter);
 
 	return n_scc;
 }
@@ -22,7 +22,43 @@
 
 #include <graph.h>
 
+// the coloring continues on the subgraph induced by the active vertices when less than
+// 1/COMPACTION_THRESHOLD of the vertices are left. a value of 0 disables the compaction
+#ifndef COMPACTION_THRESHOLD
+#define COMPACTION_THRESHOLD 4
+#endif
+
+/* tarjan_workspace holds the arrays used by tarjan_sccs.
+ *
+ * index and low_link have an entry for every vertex of the graph, and index must be 0
+ * for the vertices that have not been searched yet. scc_stack, dfs_stack and dfs_iter
+ * need an entry for every vertex that a single call may reach.
+ * the vertices searched by different threads must not be connected, so that the
+ * threads can share index and low_link. every call adds the edges it scanned to n_edges.
+ */
+typedef struct tarjan_workspace {
+	vert_t *index;
+	vert_t *low_link;
+
+	vert_t *scc_stack;
+	vert_t *dfs_stack;
+	adj_iter *dfs_iter;
+
+	size_t n_edges;
+
+} tarjan_workspace;
+
+// Finds the SCCs of the active vertices of G reachable from roots (every vertex if NULL) using Tarjan's algorithm
+ssize_t tarjan_sccs(const graph *G, const vertex_set *is_vertex, const vert_t *roots, size_t n_roots,
+		tarjan_workspace *ws, vert_t *scc_id);
+
 // Implements the graph coloring algorithm to find the SCCs of G
 ssize_t scc_coloring(const graph *G, vert_t **vertex_scc_id);
 
+// Implements the forward-backward (FW-BW) algorithm to find the SCCs of G
+ssize_t scc_fwbw(const graph *G, vert_t **vertex_scc_id);
+
+// Implements Tarjan's algorithm to find the SCCs of G in linear time
+ssize_t scc_tarjan(const graph *G, vert_t **vertex_scc_id);
+
 #endif
@@ -0,0 +1,410 @@
+/* run statistics of the scc implementations
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+const char *phase_names[N_PHASES] = {
+	"trim", "components", "coloring", "colors", "bfs", "tarjan"
+};
+
+const char *counter_names[N_COUNTERS] = {
+	"iterations", "sweeps", "trimmed", "edges"
+};
+
+const char *event_names[N_EVENTS] = {
+	"cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"
+};
+
+scc_stats *run_stats = NULL;
+
+void stats_begin(scc_stats *st) {
+	memset(st, 0, sizeof(scc_stats));
+	run_stats = st;
+}
+
+// Frees the memory allocated to the hardware counters, their fds must be closed
+static void free_hw_counters(hw_counters *hw) {
+	free(hw->leader);
+	free(hw->fd);
+	free(hw->mark);
+	free(hw->counts);
+
+	free(hw);
+}
+
+// the counts of the events are kept, only the fds of the counters are closed
+void stats_end(void) {
+	hw_counters *hw = run_stats->hw;
+	if(hw != NULL) {
+		for(int i = 0 ; i < hw->n_threads * N_EVENTS ; ++i) {
+			if(hw->fd[i] != -1) close(hw->fd[i]);
+			hw->fd[i] = -1;
+		}
+
+		for(int t = 0 ; t < hw->n_threads ; ++t) hw->leader[t] = -1;
+	}
+
+	run_stats = NULL;
+}
+
+void stats_free(scc_stats *st) {
+	free(st->colors);
+	if(st->hw != NULL) free_hw_counters(st->hw);
+
+	st->colors = NULL;
+	st->colors_capacity = 0;
+	st->hw = NULL;
+}
+
+#ifdef __linux__
+// the type and config of the perf events of each hw_event
+static const struct {
+	uint32_t type;
+	uint64_t config;
+} perf_events[N_EVENTS] = {
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+#endif
+
+/* Opens the events of hw_event as a group that counts the calling thread
+ *
+ * fd is set to the fds of the events, -1 for the ones that could not be opened.
+ * the first event opened is the leader of the group, and its fd reads all of them.
+ * only the user space part of the thread is counted.
+ * returns the fd of the leader or -1 with errno set if no event could be opened.
+ */
+static int open_event_group(int *fd) {
+	int leader = -1;
+
+#ifdef __linux__
+	for(int e = 0 ; e < N_EVENTS ; ++e) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+
+		attr.size = sizeof(attr);
+		attr.type = perf_events[e].type;
+		attr.config = perf_events[e].config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// pid 0 and cpu -1 count the calling thread on any cpu
+		fd[e] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+		if(fd[e] != -1 && leader == -1) leader = fd[e];
+	}
+#else
+	for(int e = 0 ; e < N_EVENTS ; ++e) fd[e] = -1;
+	errno = ENOSYS;
+#endif
+
+	return leader;
+}
+
+/* Reads the events of the group of thread t in values
+ *
+ * the events that are not counted are 0. when the group shared the counters with other
+ * events the values are scaled from the time it was running to the time it was enabled.
+ */
+static void read_event_group(const hw_counters *hw, int t, uint64_t *values) {
+	for(int e = 0 ; e < N_EVENTS ; ++e) values[e] = 0;
+
+	// the thread may still be opening its group
+	int leader = __atomic_load_n(&hw->leader[t], __ATOMIC_ACQUIRE);
+	if(leader == -1) return;
+
+	// the group is read as the number of events, the time enabled
+	// and the time running, followed by the value of each event
+	uint64_t buffer[3 + N_EVENTS];
+	if(read(leader, buffer, sizeof(buffer)) < (ssize_t) (3 * sizeof(uint64_t))) return;
+
+	uint64_t time_enabled = buffer[1];
+	uint64_t time_running = buffer[2];
+
+	size_t i = 3;
+	for(int e = 0 ; e < N_EVENTS ; ++e) {
+		if(hw->fd[t * N_EVENTS + e] == -1) continue;
+
+		uint64_t value = buffer[i++];
+		if(time_running > 0 && time_running < time_enabled) {
+			value = (uint64_t) ((double) value * time_enabled / time_running);
+		}
+
+		values[e] = value;
+	}
+}
+
+/* Enables counters mode for the current run
+ *
+ * if the counters can not be opened for the calling thread a warning is printed and
+ * the run continues without them. returns 0 on success or -1 on failure.
+ */
+int stats_enable_counters(int n_threads) {
+	if(run_stats == NULL) return 0;
+
+	hw_counters *hw = (hw_counters *) malloc(sizeof(hw_counters));
+	if(hw == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return -1;
+	}
+
+	hw->n_threads = n_threads;
+
+	hw->leader = (int *) malloc(n_threads * sizeof(int));
+	hw->fd = (int *) malloc(n_threads * N_EVENTS * sizeof(int));
+	hw->mark = (uint64_t *) calloc(n_threads * N_EVENTS, sizeof(uint64_t));
+	hw->counts = (uint64_t *) calloc(N_PHASES * n_threads * N_EVENTS, sizeof(uint64_t));
+	if(hw->leader == NULL || hw->fd == NULL || hw->mark == NULL || hw->counts == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+		free_hw_counters(hw);
+		return -1;
+	}
+
+	for(int t = 0 ; t < n_threads ; ++t) hw->leader[t] = -1;
+	for(int i = 0 ; i < n_threads * N_EVENTS ; ++i) hw->fd[i] = -1;
+
+	// the warnings are printed once, not for every run
+	static bool warned = false;
+
+	hw->leader[0] = open_event_group(hw->fd);
+	if(hw->leader[0] == -1) {
+		if(!warned) fprintf(stderr, "Warning: hardware counters are unavailable:\n%s\n", strerror(errno));
+		warned = true;
+
+		free_hw_counters(hw);
+		return 0;
+	}
+
+	for(int e = 0 ; e < N_EVENTS ; ++e) {
+		hw->available[e] = (hw->fd[e] != -1);
+		if(!hw->available[e] && !warned) fprintf(stderr, "Warning: hardware event %s is unavailable\n", event_names[e]);
+	}
+	warned = true;
+
+	run_stats->hw = hw;
+
+	return 0;
+}
+
+/* Opens the hardware counters of the calling thread
+ *
+ * the thread is counted from this point on, so it should be called when the thread starts.
+ * the group is published through leader[thread_id] after all of its fds are set, since
+ * the thread that runs the algorithm may be reading the groups at the same time.
+ */
+void stats_attach_thread(int thread_id) {
+	if(run_stats == NULL || run_stats->hw == NULL) return;
+
+	hw_counters *hw = run_stats->hw;
+	if(thread_id < 0 || thread_id >= hw->n_threads || hw->leader[thread_id] != -1) return;
+
+	int leader = open_event_group(&hw->fd[thread_id * N_EVENTS]);
+	__atomic_store_n(&hw->leader[thread_id], leader, __ATOMIC_RELEASE);
+}
+
+// the groups that are not open yet are marked with 0, which is what they start counting from
+void stats_mark_counters(void) {
+	hw_counters *hw = run_stats->hw;
+
+	for(int t = 0 ; t < hw->n_threads ; ++t) read_event_group(hw, t, &hw->mark[t * N_EVENTS]);
+}
+
+void stats_add_counters(scc_phase phase) {
+	hw_counters *hw = run_stats->hw;
+
+	for(int t = 0 ; t < hw->n_threads ; ++t) {
+		uint64_t values[N_EVENTS];
+		read_event_group(hw, t, values);
+
+		uint64_t *mark = &hw->mark[t * N_EVENTS];
+		uint64_t *counts = &hw->counts[(phase * hw->n_threads + t) * N_EVENTS];
+		for(int e = 0 ; e < N_EVENTS ; ++e) {
+			if(values[e] > mark[e]) counts[e] += values[e] - mark[e];
+		}
+	}
+}
+
+double stats_clock(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
+/* Records an iteration of the coloring algorithm that found n_colors colors
+ *
+ * the colors of the iteration are not kept if their array can not grow,
+ * the statistics are not worth failing the run for.
+ */
+void stats_iteration(size_t n_colors) {
+	if(run_stats == NULL) return;
+
+	size_t n_iters = run_stats->counters[STAT_ITERATIONS]++;
+	if(n_iters == run_stats->colors_capacity) {
+		size_t capacity = 2 * run_stats->colors_capacity + 16;
+		size_t *colors = (size_t *) realloc(run_stats->colors, capacity * sizeof(size_t));
+		if(colors == NULL) {
+			run_stats->counters[STAT_ITERATIONS]--;
+			return;
+		}
+
+		run_stats->colors = colors;
+		run_stats->colors_capacity = capacity;
+	}
+
+	run_stats->colors[n_iters] = n_colors;
+}
+
+void print_stats(const scc_stats *st, double total_time) {
+	double phases_time = 0;
+	for(int p = 0 ; p < N_PHASES ; ++p) {
+		if(st->phase_time[p] == 0) continue;
+
+		printf("  %-10s %0.6f sec\n", phase_names[p], st->phase_time[p]);
+		phases_time += st->phase_time[p];
+	}
+	printf("  %-10s %0.6f sec\n", "other", (total_time > phases_time)? total_time - phases_time : 0);
+
+	printf("coloring iterations = %zu\n", st->counters[STAT_ITERATIONS]);
+	printf("coloring sweeps = %zu\n", st->counters[STAT_SWEEPS]);
+	printf("vertices trimmed = %zu\n", st->counters[STAT_TRIMMED]);
+	printf("edges traversed = %zu\n", st->counters[STAT_EDGES]);
+
+	if(st->counters[STAT_ITERATIONS] > 0) {
+		printf("colors per iteration =");
+		for(size_t i = 0 ; i < st->counters[STAT_ITERATIONS] ; ++i) printf(" %zu", st->colors[i]);
+		printf("\n");
+	}
+}
+
+/* Prints the hardware events of each phase and thread of a run
+ *
+ * the threads that did not run in a phase are skipped, and the
+ * events that could not be counted are printed as n/a.
+ */
+void print_counters(const scc_stats *st) {
+	const hw_counters *hw = st->hw;
+	if(hw == NULL) return;
+
+	printf("hardware counters:\n");
+	printf("  %-10s %6s", "phase", "thread");
+	for(int e = 0 ; e < N_EVENTS ; ++e) printf(" %14s", event_names[e]);
+	printf(" %6s\n", "ipc");
+
+	for(int p = 0 ; p < N_PHASES ; ++p) {
+		if(st->phase_time[p] == 0) continue;
+
+		for(int t = 0 ; t < hw->n_threads ; ++t) {
+			const uint64_t *counts = &hw->counts[(p * hw->n_threads + t) * N_EVENTS];
+
+			bool ran = false;
+			for(int e = 0 ; e < N_EVENTS ; ++e) ran = ran || (counts[e] > 0);
+			if(!ran) continue;
+
+			printf("  %-10s %6d", phase_names[p], t);
+			for(int e = 0 ; e < N_EVENTS ; ++e) {
+				if(hw->available[e]) printf(" %14llu", (unsigned long long) counts[e]);
+				else printf(" %14s", "n/a");
+			}
+
+			if(hw->available[EVENT_CYCLES] && hw->available[EVENT_INSTRUCTIONS] && counts[EVENT_CYCLES] > 0) {
+				printf(" %6.2f\n", (double) counts[EVENT_INSTRUCTIONS] / counts[EVENT_CYCLES]);
+			} else {
+				printf(" %6s\n", "n/a");
+			}
+		}
+	}
+}
+
+void write_stats_json(FILE *f, const scc_stats *st) {
+	fprintf(f, "\"phases\": {");
+	for(int p = 0 ; p < N_PHASES ; ++p) {
+		fprintf(f, "%s\"%s\": %0.6f", (p > 0)? ", " : "", phase_names[p], st->phase_time[p]);
+	}
+	fprintf(f, "}");
+
+	for(int c = 0 ; c < N_COUNTERS ; ++c) {
+		fprintf(f, ", \"%s\": %zu", counter_names[c], st->counters[c]);
+	}
+
+	fprintf(f, ", \"colors\": [");
+	for(size_t i = 0 ; i < st->counters[STAT_ITERATIONS] ; ++i) {
+		fprintf(f, "%s%zu", (i > 0)? ", " : "", st->colors[i]);
+	}
+	fprintf(f, "]");
+
+	// the events of each phase are an array with an object for each thread
+	const hw_counters *hw = st->hw;
+	if(hw == NULL) return;
+
+	fprintf(f, ", \"counters\": {");
+	for(int p = 0 ; p < N_PHASES ; ++p) {
+		fprintf(f, "%s\"%s\": [", (p > 0)? ", " : "", phase_names[p]);
+
+		for(int t = 0 ; t < hw->n_threads ; ++t) {
+			const uint64_t *counts = &hw->counts[(p * hw->n_threads + t) * N_EVENTS];
+
+			fprintf(f, "%s{", (t > 0)? ", " : "");
+			for(int e = 0 ; e < N_EVENTS ; ++e) {
+				fprintf(f, "%s\"%s\": ", (e > 0)? ", " : "", event_names[e]);
+				if(hw->available[e]) fprintf(f, "%llu", (unsigned long long) counts[e]);
+				else fprintf(f, "null");
+			}
+			fprintf(f, "}");
+		}
+
+		fprintf(f, "]");
+	}
+	fprintf(f, "}");
+}
+
+void write_stats_csv_header(FILE *f) {
+	for(int p = 0 ; p < N_PHASES ; ++p) fprintf(f, "%s%s_time", (p > 0)? "," : "", phase_names[p]);
+	for(int c = 0 ; c < N_COUNTERS ; ++c) fprintf(f, ",%s", counter_names[c]);
+
+	fprintf(f, ",colors");
+}
+
+// the colors of the iterations are written in a single column separated by spaces
+void write_stats_csv(FILE *f, const scc_stats *st) {
+	for(int p = 0 ; p < N_PHASES ; ++p) fprintf(f, "%s%0.6f", (p > 0)? "," : "", st->phase_time[p]);
+	for(int c = 0 ; c < N_COUNTERS ; ++c) fprintf(f, ",%zu", st->counters[c]);
+
+	fprintf(f, ",");
+	for(size_t i = 0 ; i < st->counters[STAT_ITERATIONS] ; ++i) {
+		fprintf(f, "%s%zu", (i > 0)? " " : "", st->colors[i]);
+	}
+}
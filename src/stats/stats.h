@@ -0,0 +1,171 @@
+/* run statistics of the scc implementations
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <trace.h>
+
+// the phases of the scc algorithms that are timed separately
+typedef enum {
+	PHASE_TRIM,       // removal of the trivial SCCs
+	PHASE_COMPONENTS, // decomposition of the small weakly connected components
+	PHASE_COLORING,   // propagation of the colors until they converge
+	PHASE_COLORS,     // extraction of the unique colors
+	PHASE_BFS,        // searches that find the SCCs of the colors and of the pivots
+	PHASE_TARJAN,     // Tarjan's algorithm on the whole graph
+	N_PHASES
+} scc_phase;
+
+// the events that are counted during a run
+typedef enum {
+	STAT_ITERATIONS, // iterations of the coloring algorithm
+	STAT_SWEEPS,     // rounds of color propagation, over all the iterations
+	STAT_TRIMMED,    // vertices removed by trimming
+	STAT_EDGES,      // edges scanned by the color propagation and the searches
+	N_COUNTERS
+} scc_counter;
+
+// the hardware events counted by each thread in counters mode
+typedef enum {
+	EVENT_CYCLES,
+	EVENT_INSTRUCTIONS,
+	EVENT_LLC_MISSES,
+	EVENT_DTLB_MISSES,
+	EVENT_BRANCH_MISSES,
+	N_EVENTS
+} hw_event;
+
+extern const char *phase_names[N_PHASES];
+extern const char *counter_names[N_COUNTERS];
+extern const char *event_names[N_EVENTS];
+
+/* hw_counters holds the hardware counters of the threads of a run.
+ *
+ * every thread opens a group with the events through perf_event_open for itself, leader[t]
+ * is the fd of the group of thread t and fd[t * N_EVENTS + e] the fd of event e, or -1
+ * when they could not be opened. the groups are read at the start and at the end of every
+ * phase, mark holds the values at the start of the current phase and the difference is
+ * added to counts[(phase * n_threads + t) * N_EVENTS + e].
+ * available[e] is true if event e could be opened by the first thread.
+ */
+typedef struct hw_counters {
+	int n_threads;
+
+	int *leader;
+	int *fd;
+
+	uint64_t *mark;
+	uint64_t *counts;
+
+	bool available[N_EVENTS];
+
+} hw_counters;
+
+/* scc_stats holds the statistics of one run of an scc implementation.
+ *
+ * phase_time is the wall time of each phase in seconds, and colors holds the number
+ * of colors found by each of the counters[STAT_ITERATIONS] iterations of the coloring.
+ */
+typedef struct scc_stats {
+	double phase_time[N_PHASES];
+	size_t counters[N_COUNTERS];
+
+	size_t *colors;
+	size_t colors_capacity;
+
+	// the hardware counters, NULL unless counters mode is enabled
+	hw_counters *hw;
+
+} scc_stats;
+
+// the statistics of the current run, or NULL when they are not collected
+extern scc_stats *run_stats;
+
+// Starts collecting the statistics of a run in st
+void stats_begin(scc_stats *st);
+
+// Stops collecting statistics
+void stats_end(void);
+
+// Enables counters mode for a run of up to n_threads threads, and opens the counters of the calling thread as thread 0
+int stats_enable_counters(int n_threads);
+
+// Opens the hardware counters of the calling thread as thread thread_id, if counters mode is enabled
+void stats_attach_thread(int thread_id);
+
+// Frees the memory allocated to the statistics of a run
+void stats_free(scc_stats *st);
+
+// Returns the time of a monotonic clock in seconds
+double stats_clock(void);
+
+// Reads the hardware counters of the threads at the start of a phase
+void stats_mark_counters(void);
+
+// Reads the hardware counters of the threads at the end of phase and adds the events since the start
+void stats_add_counters(scc_phase phase);
+
+// Marks the start of a phase, returns the start time for stats_phase
+static inline double stats_phase_begin(void) {
+	if(run_stats != NULL && run_stats->hw != NULL) stats_mark_counters();
+
+	return stats_clock();
+}
+
+// Adds the time and the hardware events since start (from stats_phase_begin) to phase
+static inline void stats_phase(scc_phase phase, double start) {
+	if(run_stats == NULL) return;
+
+	double end = stats_clock();
+	run_stats->phase_time[phase] += end - start;
+	trace_complete(phase_names[phase], start, end);
+
+	if(run_stats->hw != NULL) stats_add_counters(phase);
+}
+
+// Adds n to a counter. it can be called from any thread
+static inline void stats_count(scc_counter counter, size_t n) {
+	if(run_stats != NULL) __atomic_fetch_add(&run_stats->counters[counter], n, __ATOMIC_RELAXED);
+}
+
+// Records an iteration of the coloring algorithm that found n_colors colors
+void stats_iteration(size_t n_colors);
+
+// Prints the statistics of a run that took total_time seconds in human readable form
+void print_stats(const scc_stats *st, double total_time);
+
+// Prints the hardware events of each phase and thread of a run, if they were counted
+void print_counters(const scc_stats *st);
+
+// Writes the statistics of a run as the members of a JSON object
+void write_stats_json(FILE *f, const scc_stats *st);
+
+// Writes the names of the columns written by write_stats_csv
+void write_stats_csv_header(FILE *f);
+
+// Writes the statistics of a run as CSV columns
+void write_stats_csv(FILE *f, const scc_stats *st);
+
+#endif
@@ -0,0 +1,227 @@
+/* per-thread timeline tracing of the scc implementations
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#ifdef TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+// the most processes that can be started in a trace
+#define TRACE_MAX_PROCESSES 8
+
+/* trace_event is a begin ('B'), end ('E') or complete ('X') event of a task.
+ * time is in nanoseconds of the monotonic clock, and duration is only used by
+ * the complete events, which are recorded after the task has ended.
+ */
+typedef struct trace_event {
+	uint64_t time;
+	uint64_t duration;
+	const char *name;
+	int process;
+	char type;
+
+} trace_event;
+
+/* trace_buffer is the ring buffer of the events of a thread.
+ *
+ * n_events is the number of events the thread has recorded, the buffer
+ * holds the last TRACE_BUFFER_EVENTS of them. only the thread itself writes
+ * to its buffer, and each buffer is on its own cache line.
+ */
+typedef struct trace_buffer {
+	trace_event *events;
+	size_t n_events;
+
+} __attribute__((aligned(64))) trace_buffer;
+
+static trace_buffer *buffers = NULL;
+static int n_buffers = 0;
+
+// the time tracing started, the events are written relative to it
+static uint64_t start_time;
+
+static const char *process_names[TRACE_MAX_PROCESSES];
+static int n_processes = 0;
+
+// the id of the calling thread in the timeline, -1 for the threads that are not traced
+static __thread int current_thread = -1;
+
+// Returns the time of the monotonic clock in nanoseconds
+static inline uint64_t trace_clock(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// Appends an event to the buffer of the calling thread, overwriting its oldest event if it is full
+static inline void trace_record(char type, const char *name, uint64_t time, uint64_t duration) {
+	if(buffers == NULL || current_thread < 0 || current_thread >= n_buffers) return;
+
+	trace_buffer *buf = &buffers[current_thread];
+	trace_event *ev = &buf->events[buf->n_events++ % TRACE_BUFFER_EVENTS];
+
+	ev->time = time;
+	ev->duration = duration;
+	ev->name = name;
+	ev->process = n_processes - 1;
+	ev->type = type;
+}
+
+int trace_start(int n_threads) {
+	buffers = (trace_buffer *) aligned_alloc(64, n_threads * sizeof(trace_buffer));
+	if(buffers == NULL) {
+		fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+		return -1;
+	}
+
+	for(int t = 0 ; t < n_threads ; ++t) {
+		buffers[t].n_events = 0;
+		buffers[t].events = (trace_event *) malloc(TRACE_BUFFER_EVENTS * sizeof(trace_event));
+		if(buffers[t].events == NULL) {
+			fprintf(stderr, "Error allocating memory:\n%s\n", strerror(ENOMEM));
+
+			for(int i = 0 ; i < t ; ++i) free(buffers[i].events);
+			free(buffers);
+			buffers = NULL;
+			return -1;
+		}
+	}
+	n_buffers = n_threads;
+
+	// the events recorded before the first process belong to a process without a name
+	process_names[0] = NULL;
+	n_processes = 1;
+
+	current_thread = 0;
+	start_time = trace_clock();
+
+	return 0;
+}
+
+void trace_process(const char *name) {
+	if(buffers == NULL) return;
+
+	// if there are too many processes the rest of the events go to the last one
+	if(process_names[n_processes - 1] != NULL && n_processes < TRACE_MAX_PROCESSES) n_processes++;
+	process_names[n_processes - 1] = name;
+}
+
+void trace_thread(int thread_id) {
+	current_thread = thread_id;
+}
+
+void trace_begin(const char *name) {
+	trace_record('B', name, trace_clock(), 0);
+}
+
+void trace_end(const char *name) {
+	trace_record('E', name, trace_clock(), 0);
+}
+
+void trace_complete(const char *name, double start, double end) {
+	uint64_t begin_time = (uint64_t) (start * 1000000000);
+	uint64_t end_time = (uint64_t) (end * 1000000000);
+
+	trace_record('X', name, begin_time, (end_time > begin_time)? end_time - begin_time : 0);
+}
+
+// Writes a timestamp or duration in nanoseconds as microseconds
+static void write_time(FILE *f, uint64_t time) {
+	fprintf(f, "%llu.%03llu", (unsigned long long) (time / 1000), (unsigned long long) (time % 1000));
+}
+
+/* the events are written in a JSON object with the traceEvents array of the Chrome
+ * trace format. the processes and the threads are named with metadata events,
+ * and the timestamps are in microseconds since tracing started.
+ */
+int trace_dump(const char *fname) {
+	if(buffers == NULL) return 0;
+
+	int status = 0;
+
+	FILE *f = fopen(fname, "w");
+	if(f == NULL) {
+		fprintf(stderr, "Error opening trace file %s:\n%s\n", fname, strerror(errno));
+		status = -1;
+	} else {
+		fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+		bool first = true;
+		for(int p = 0 ; p < n_processes ; ++p) {
+			fprintf(f, "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"args\": {\"name\": \"%s\"}}",
+					first? "" : ",", p, (process_names[p] != NULL)? process_names[p] : "scc");
+			first = false;
+
+			for(int t = 0 ; t < n_buffers ; ++t) {
+				fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+						p, t, t);
+			}
+		}
+
+		for(int t = 0 ; t < n_buffers ; ++t) {
+			trace_buffer *buf = &buffers[t];
+
+			size_t first_event = 0;
+			if(buf->n_events > TRACE_BUFFER_EVENTS) {
+				fprintf(stderr, "Warning: the trace of thread %d overflowed, only its last %d events are written\n",
+						t, TRACE_BUFFER_EVENTS);
+				first_event = buf->n_events - TRACE_BUFFER_EVENTS;
+			}
+
+			for(size_t i = first_event ; i < buf->n_events ; ++i) {
+				const trace_event *ev = &buf->events[i % TRACE_BUFFER_EVENTS];
+
+				fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": %d, \"tid\": %d, \"ts\": ",
+						ev->name, ev->type, ev->process, t);
+				write_time(f, (ev->time > start_time)? ev->time - start_time : 0);
+				if(ev->type == 'X') {
+					fprintf(f, ", \"dur\": ");
+					write_time(f, ev->duration);
+				}
+				fprintf(f, "}");
+			}
+		}
+
+		fprintf(f, "\n]}\n");
+
+		if(fclose(f) == EOF) {
+			fprintf(stderr, "Error writing trace file %s:\n%s\n", fname, strerror(errno));
+			status = -1;
+		}
+	}
+
+	for(int t = 0 ; t < n_buffers ; ++t) free(buffers[t].events);
+	free(buffers);
+
+	buffers = NULL;
+	n_buffers = 0;
+
+	return status;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/* per-thread timeline tracing of the scc implementations
+ * Copyright (C) 2022  Alexandros Athanasiadis
+ *
+ * This file is part of scc
+ *
+ * scc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * scc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/* the tracing records when every thread begins and ends each of its tasks, and writes
+ * the timeline in the Chrome trace format, which can be opened in chrome://tracing or
+ * https://ui.perfetto.dev. it is only compiled in when TRACE is defined, otherwise
+ * the functions below do nothing and cost nothing.
+ *
+ * every thread writes its events in a ring buffer of its own, so recording an event
+ * takes no locks. a buffer keeps the last TRACE_BUFFER_EVENTS events of its thread.
+ */
+
+// the number of events kept for each thread
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 65536
+#endif
+
+#ifdef TRACE
+
+// Starts tracing threads 0 to n_threads - 1. returns 0 on success or -1 on failure
+int trace_start(int n_threads);
+
+// Starts a new process in the timeline, the events that follow are shown under name
+void trace_process(const char *name);
+
+// Sets the id of the calling thread in the timeline, the thread that starts tracing is thread 0
+void trace_thread(int thread_id);
+
+// Records that the calling thread begins the task name. name must be a string literal
+void trace_begin(const char *name);
+
+// Records that the calling thread ends the task name
+void trace_end(const char *name);
+
+// Records a task of the calling thread that started and ended at the given times of stats_clock
+void trace_complete(const char *name, double start, double end);
+
+// Writes the events of all the threads to fname and stops tracing. returns 0 on success or -1 on failure
+int trace_dump(const char *fname);
+
+#else
+
+#define trace_start(n_threads) (0)
+#define trace_process(name) ((void) 0)
+#define trace_thread(thread_id) ((void) 0)
+#define trace_begin(name) ((void) 0)
+#define trace_end(name) ((void) 0)
+#define trace_complete(name, start, end) ((void) 0)
+#define trace_dump(fname) (0)
+
+#endif
+
+#endif